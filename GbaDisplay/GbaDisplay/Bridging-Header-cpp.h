@@ -17,6 +17,8 @@ typedef void *CpuRunnerHandle;
 CpuRunnerHandle CpuRunner_Create();
 int CpuRunner_Init(CpuRunnerHandle handle, int argc, char *argv[]);
 void CpuRunner_Run(CpuRunnerHandle handle);
+int CpuRunner_RunCycles(CpuRunnerHandle handle, unsigned long long cycles);
+int CpuRunner_RunFrame(CpuRunnerHandle handle);
 void CpuRunner_Destroy(CpuRunnerHandle handle);
 void *CpuRunner_GetMemory(CpuRunnerHandle handle);
 
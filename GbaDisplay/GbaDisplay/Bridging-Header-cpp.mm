@@ -20,6 +20,14 @@ void CpuRunner_Run(CpuRunnerHandle handle) {
   static_cast<CpuRunner::CpuRunner *>(handle)->Run();
 }
 
+int CpuRunner_RunCycles(CpuRunnerHandle handle, unsigned long long cycles) {
+  return int(static_cast<CpuRunner::CpuRunner *>(handle)->RunCycles(cycles));
+}
+
+int CpuRunner_RunFrame(CpuRunnerHandle handle) {
+  return int(static_cast<CpuRunner::CpuRunner *>(handle)->RunFrame());
+}
+
 void CpuRunner_Destroy(CpuRunnerHandle handle) {
   delete static_cast<CpuRunner::CpuRunner *>(handle);
 }
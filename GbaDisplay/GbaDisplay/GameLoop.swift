@@ -10,7 +10,6 @@ import AppKit
 import UniformTypeIdentifiers
 
 
-let VBLANK_TIME_MS : UInt32 = 5
 let kMaxRawBytes : Int = 1024 * 1024;
 
 class GameLoop {
@@ -46,16 +45,34 @@ class GameLoop {
     
     public func start()
     {
-        timer = Timer.scheduledTimer(withTimeInterval: 0.016, repeats: true) { [weak self] _ in
-            self?.dispatch()
-        }
-        DispatchQueue.global(qos: .background).async {
-            CpuRunner_Run(self.CpuRunnerHandle)
+        // One emulated frame per display refresh. A frame that is still
+        // running when the timer fires again is not queued twice.
+        timer = Timer.scheduledTimer(withTimeInterval: 1.0 / 60.0, repeats: true) { [weak self] _ in
+            self?.runFrame()
         }
     }
 
     private var timer: Timer?
-        
+    private var frame_running = false
+    private let emulator_queue = DispatchQueue(label: "GbaDisplay.emulator", qos: .userInitiated)
+
+    private func runFrame()
+    {
+        if frame_running {
+            return
+        }
+        frame_running = true
+        emulator_queue.async {
+            let running = CpuRunner_RunFrame(self.CpuRunnerHandle) != 0
+            DispatchQueue.main.async {
+                self.frame_running = false
+                if !running {
+                    self.timer?.invalidate()
+                }
+            }
+        }
+    }
+
     // From CPU
     private var in_DISPCNT : UInt16 = 0b1 << 6
     private var in_background_registers_0 : Background = Background(ctr: 0, x: 0, y: 0)
@@ -64,33 +81,5 @@ class GameLoop {
     private var in_background_registers_3 : Background = Background(ctr: 0, x: 0, y: 0)
     
     public let CpuRunnerHandle : CpuRunnerHandle = CpuRunner_Create()
-   
-    private func SignalUpdateBuffersReady()
-    {
-        let IO_MEMORY = GetHalfWordMemoryPtr(memory_ptr: CpuRunner_GetMemory(CpuRunnerHandle)!, address: 0x04000000)
-        let VCOUNT = IO_MEMORY.advanced(by: 0x6 / 2)
-        VCOUNT.pointee = 159
-        let INTERRUPT = IO_MEMORY.advanced(by: 0x202 / 2)
-        INTERRUPT.pointee = 1
-    }
 
-    private func SignalDoNotUpdateBuffers()
-    {
-        let IO_MEMORY = GetHalfWordMemoryPtr(memory_ptr: CpuRunner_GetMemory(CpuRunnerHandle)!, address: 0x04000000)
-        let VCOUNT = IO_MEMORY.advanced(by: 0x6 / 2)
-        VCOUNT.pointee = 0
-    }
-    
-    private func dispatch()
-    {
-        // Set scanline to indicate to CPU that VRAM can be updated.
-        SignalUpdateBuffersReady()
-        
-        // Wait for time for CPU to update buffers.
-        usleep(VBLANK_TIME_MS * 1000);
-        
-        // Set scanline to indicate to CPU to not update buffers until the next dispatch.
-        SignalDoNotUpdateBuffers()
-    }
-    
 }
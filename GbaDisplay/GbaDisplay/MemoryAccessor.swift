@@ -18,7 +18,22 @@ let GAMEPAK_WS_SIZE = 0x2000000
 let GAMEPAK_SRAM_SIZE = 0x10000
 let MYSTERY_ADDR_SIZE = 1
 
-let TOTAL_MEMORY_SIZE = BIOS_SIZE + WRAM_ONBOARD_SIZE + WRAM_ONCHIP_SIZE + IO_REGISTERS_SIZE + PALETTE_RAM_SIZE + VRAM_SIZE + OAM_SIZE + 3 * GAMEPAK_WS_SIZE + GAMEPAK_SRAM_SIZE
+let TOTAL_MEMORY_SIZE = BIOS_SIZE + WRAM_ONBOARD_SIZE + WRAM_ONCHIP_SIZE + IO_REGISTERS_SIZE + PALETTE_RAM_SIZE + VRAM_SIZE + OAM_SIZE + GAMEPAK_SRAM_SIZE + MYSTERY_ADDR_SIZE
+
+// The Game Pak ROM is mapped separately, Memory holds a pointer to it and its
+// size after the mystery address.
+let GAMEPAK_PTR_OFFSET = (TOTAL_MEMORY_SIZE + 7) & ~7
+let GAMEPAK_SIZE_OFFSET = GAMEPAK_PTR_OFFSET + 8
+
+func GetGamePakPtr(memory_ptr: UnsafeMutableRawPointer, offset: UInt32) -> UnsafeMutablePointer<UInt8> {
+    let rom = memory_ptr.load(fromByteOffset: GAMEPAK_PTR_OFFSET, as: UnsafeMutablePointer<UInt8>?.self)
+    let rom_size = memory_ptr.load(fromByteOffset: GAMEPAK_SIZE_OFFSET, as: UInt32.self)
+    guard let rom = rom, offset < rom_size else {
+        print(String(format: "Game Pak offset: 0x%08X (%u)", offset, offset))
+        fatalError("Bad Access")
+    }
+    return rom.advanced(by: Int(offset))
+}
 
 func GetHalfWordMemoryPtr(memory_ptr: UnsafeMutableRawPointer, address: UInt32) -> UnsafeMutablePointer<UInt16> {
     return UnsafeMutableRawPointer(GetByteMemoryPtr(memory_ptr: memory_ptr, address: address)).bindMemory(to: UInt16.self, capacity: TOTAL_MEMORY_SIZE / 2)
@@ -60,25 +75,17 @@ func GetByteMemoryPtr(memory_ptr: UnsafeMutableRawPointer, address: UInt32) -> U
         // OAM
         return memPtr.advanced(by: BIOS_SIZE + WRAM_ONBOARD_SIZE + WRAM_ONCHIP_SIZE + IO_REGISTERS_SIZE + PALETTE_RAM_SIZE + VRAM_SIZE + Int(address - 0x07000000))
 
-    case 0x08000000...0x09FFFFFF:
-        // GamePak WS0
-        return memPtr.advanced(by: BIOS_SIZE + WRAM_ONBOARD_SIZE + WRAM_ONCHIP_SIZE + IO_REGISTERS_SIZE + PALETTE_RAM_SIZE + VRAM_SIZE + OAM_SIZE + Int(address - 0x08000000))
-
-    case 0x0A000000...0x0BFFFFFF:
-        // GamePak WS1
-        return memPtr.advanced(by: BIOS_SIZE + WRAM_ONBOARD_SIZE + WRAM_ONCHIP_SIZE + IO_REGISTERS_SIZE + PALETTE_RAM_SIZE + VRAM_SIZE + OAM_SIZE + GAMEPAK_WS_SIZE + Int(address - 0x0A000000))
-
-    case 0x0C000000...0x0DFFFFFF:
-        // GamePak WS2
-        return memPtr.advanced(by: BIOS_SIZE + WRAM_ONBOARD_SIZE + WRAM_ONCHIP_SIZE + IO_REGISTERS_SIZE + PALETTE_RAM_SIZE + VRAM_SIZE + OAM_SIZE + 2 * GAMEPAK_WS_SIZE + Int(address - 0x0C000000))
+    case 0x08000000...0x0DFFFFFF:
+        // GamePak WS0, WS1 and WS2 all view the same ROM
+        return GetGamePakPtr(memory_ptr: memory_ptr, offset: (address - 0x08000000) % UInt32(GAMEPAK_WS_SIZE))
 
     case 0x0E000000...0x0E00FFFF:
         // GamePak SRAM
-        return memPtr.advanced(by: BIOS_SIZE + WRAM_ONBOARD_SIZE + WRAM_ONCHIP_SIZE + IO_REGISTERS_SIZE + PALETTE_RAM_SIZE + VRAM_SIZE + OAM_SIZE + 3 * GAMEPAK_WS_SIZE + Int(address - 0x0E000000))
+        return memPtr.advanced(by: BIOS_SIZE + WRAM_ONBOARD_SIZE + WRAM_ONCHIP_SIZE + IO_REGISTERS_SIZE + PALETTE_RAM_SIZE + VRAM_SIZE + OAM_SIZE + Int(address - 0x0E000000))
 
     case 0x04000410:
         // Mystery address maps after all above
-        return memPtr.advanced(by: BIOS_SIZE + WRAM_ONBOARD_SIZE + WRAM_ONCHIP_SIZE + IO_REGISTERS_SIZE + PALETTE_RAM_SIZE + VRAM_SIZE + OAM_SIZE + 3 * GAMEPAK_WS_SIZE + GAMEPAK_SRAM_SIZE)
+        return memPtr.advanced(by: BIOS_SIZE + WRAM_ONBOARD_SIZE + WRAM_ONCHIP_SIZE + IO_REGISTERS_SIZE + PALETTE_RAM_SIZE + VRAM_SIZE + OAM_SIZE + GAMEPAK_SRAM_SIZE)
 
     default:
         print(String(format: "Address: 0x%08X (%u)", address, address))
@@ -1,13 +1,44 @@
 #pragma once
 
+#include <cstdint>
+
 namespace CpuRunner {
 
+/// Limits and outputs of Run, for batch runs without a display. Limits of 0
+/// mean no limit.
+struct RunOptions {
+  uint64_t max_frames = 0;
+  uint64_t max_cycles = 0;
+  /// Keys to press, see src/input_script.h.
+  const char *input_script = nullptr;
+  /// Directory a snapshot of the final state is written to, ending in '/'.
+  const char *dump_dir = nullptr;
+  /// Print a hash of the display memory at exit.
+  bool display_hash = false;
+};
+
 struct CpuRunner {
+  ~CpuRunner();
   bool Init(int argc, char *argv[]);
-  void Run();
-  void *Memory_;
-  void *Cpu_;
+  /// Runs frames as fast as possible until the CPU stops or a limit in
+  /// `options` is reached, then prints how fast it ran. Returns false if the
+  /// CPU stopped before a limit was reached.
+  bool Run();
+  /// Runs at least `cycles` emulated cycles. Returns false once the CPU
+  /// stopped.
+  bool RunCycles(uint64_t cycles);
+  /// Runs until the next VBlank starts, so a host can draw the finished
+  /// frame. Returns false once the CPU stopped.
+  bool RunFrame();
+  RunOptions options;
+  void *Memory_ = nullptr;
+  void *Cpu_ = nullptr;
+  void *Input_ = nullptr;
   bool initialized = false;
+
+private:
+  /// Runs until the cycle count reaches `end`.
+  bool RunUntil(uint64_t end);
 };
 
 } // namespace CpuRunner
\ No newline at end of file
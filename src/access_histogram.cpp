@@ -0,0 +1,30 @@
+#include "access_histogram.h"
+
+#ifdef ENABLE_ACCESS_HISTOGRAM
+
+#include <fstream>
+
+namespace Emulator::AccessHistogram {
+
+Histogram Counts;
+
+void Dump() {
+  std::ofstream outFile(kDumpPath, std::ios::binary);
+  if (!outFile)
+    return;
+  outFile.write(reinterpret_cast<const char *>(&Counts), sizeof(Histogram));
+  outFile.close();
+}
+
+namespace {
+
+/// Dumps the counts on a normal exit. ABORT dumps them itself.
+struct DumpAtExit {
+  ~DumpAtExit() { Dump(); }
+} dump_at_exit;
+
+} // namespace
+
+} // namespace Emulator::AccessHistogram
+
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "datatypes.h"
+
+namespace Emulator::AccessHistogram {
+
+enum class AccessType : U8 { LOAD = 0, STORE = 1, FETCH = 2 };
+
+constexpr U32 kNumAccessTypes = 3;
+/// Access widths 1, 2 and 4 bytes.
+constexpr U32 kNumWidths = 3;
+/// 16 MB regions, 00000000-0FFFFFFF.
+constexpr U32 kNumRegions = 16;
+constexpr U32 kPageShift = 12;
+/// 4 KB pages over the same range.
+constexpr U32 kNumPages = (kNumRegions << 24) >> kPageShift;
+
+static constexpr char kDumpPath[] = "/tmp/gba_access_histogram";
+
+/// Number of guest memory accesses, by type and width. Written to kDumpPath
+/// as is when the emulator exits or aborts.
+struct Histogram {
+  U64 regions[kNumAccessTypes][kNumWidths][kNumRegions];
+  U64 pages[kNumAccessTypes][kNumWidths][kNumPages];
+};
+
+/// Counting is compiled in. Fast paths that skip accesses are off then.
+#ifdef ENABLE_ACCESS_HISTOGRAM
+constexpr bool kEnabled = true;
+#else
+constexpr bool kEnabled = false;
+#endif
+
+#ifdef ENABLE_ACCESS_HISTOGRAM
+
+extern Histogram Counts;
+
+inline void Count(AccessType type, U32 address, U32 size) noexcept {
+  U32 width = size >> 1;
+  // Addresses above 0FFFFFFF are unmapped, count them with the last page.
+  constexpr U32 kEnd = kNumRegions << 24;
+  U32 clamped = address < kEnd ? address : kEnd - 1;
+  Counts.regions[U32(type)][width][clamped >> 24]++;
+  Counts.pages[U32(type)][width][clamped >> kPageShift]++;
+}
+
+void Dump();
+
+#endif
+
+} // namespace Emulator::AccessHistogram
+
+#ifdef ENABLE_ACCESS_HISTOGRAM
+#define COUNT_ACCESS(type, address, size)                                      \
+  Emulator::AccessHistogram::Count(                                            \
+      Emulator::AccessHistogram::AccessType::type, address, size)
+#define DUMP_ACCESS_HISTOGRAM() Emulator::AccessHistogram::Dump()
+#else
+#define COUNT_ACCESS(type, address, size) ((void)0)
+#define DUMP_ACCESS_HISTOGRAM() ((void)0)
+#endif
@@ -1,8 +1,13 @@
+#include <array>
+#include <bit>
 #include <cassert>
 #include <cstring>
 #include <stdio.h>
+#include <type_traits>
+#include <utility>
 
 #include "arm7tdmi.h"
+#include "arm_decoder.h"
 #include "arm_extended_instructions.h"
 #include "arm_instructions.h"
 #include "bitutils.h"
@@ -11,6 +16,10 @@
 #include "snapshot.h"
 #include "thumb_instructions.h"
 
+#if defined(THREADED_DISPATCH) && !defined(__GNUC__)
+#error "THREADED_DISPATCH needs labels as values (GCC or Clang)"
+#endif
+
 namespace Emulator::Arm {
 
 using namespace BitUtils;
@@ -19,6 +28,7 @@ inline U32 LoadWordWithLogging(const Memory::Memory &memory,
                                U32 address) noexcept {
   U32 value = Emulator::Memory::ReadWordFromGBAMemory(memory, address);
   Emulator::DispatchLogger::LOG_LOAD(address, value);
+  COUNT_ACCESS(LOAD, address, 4);
   return value;
 }
 
@@ -26,6 +36,7 @@ inline U16 LoadHalfWordWithLogging(const Memory::Memory &memory,
                                    U32 address) noexcept {
   U16 value = Emulator::Memory::ReadHalfWordFromGBAMemory(memory, address);
   Emulator::DispatchLogger::LOG_LOAD(address, value);
+  COUNT_ACCESS(LOAD, address, 2);
   return value;
 }
 
@@ -33,6 +44,7 @@ inline U8 LoadByteWithLogging(const Memory::Memory &memory,
                               U32 address) noexcept {
   U8 value = Emulator::Memory::ReadByteFromGBAMemory(memory, address);
   Emulator::DispatchLogger::LOG_LOAD(address, value);
+  COUNT_ACCESS(LOAD, address, 1);
   return value;
 }
 
@@ -45,93 +57,170 @@ inline U8 LoadByteWithLogging(const Memory::Memory &memory,
 
 #define STORE_WORD(memory, address, value)                                     \
   Emulator::DispatchLogger::LOG_STORE(address, value);                         \
-  WriteWordToGBAMemory(memory, address, value);
+  CountAccess(memory, address, 4);                                             \
+  COUNT_ACCESS(STORE, address, 4);                                             \
+  WriteWordToGBAMemory(memory, address, value);                                \
+  block_cache.InvalidateWrite(address, 4);
 
 #define STORE_HALFWORD(memory, address, value)                                 \
   Emulator::DispatchLogger::LOG_STORE(address, value);                         \
-  WriteHalfWordToGBAMemory(memory, address, value);
+  CountAccess(memory, address, 2);                                             \
+  COUNT_ACCESS(STORE, address, 2);                                             \
+  WriteHalfWordToGBAMemory(memory, address, value);                            \
+  block_cache.InvalidateWrite(address, 2);
 
 #define STORE_BYTE(memory, address, value)                                     \
   Emulator::DispatchLogger::LOG_STORE(address, value);                         \
-  WriteByteToGBAMemory(memory, address, value);
+  CountAccess(memory, address, 1);                                             \
+  COUNT_ACCESS(STORE, address, 1);                                             \
+  WriteByteToGBAMemory(memory, address, value);                                \
+  block_cache.InvalidateWrite(address, 1);
 
-#define LOAD_WORD(memory, address) LoadWordWithLogging(memory, address)
+#define LOAD_WORD(memory, address)                                             \
+  (CountAccess(memory, address, 4), LoadWordWithLogging(memory, address))
 
-#define LOAD_HALFWORD(memory, address) LoadHalfWordWithLogging(memory, address)
+#define LOAD_HALFWORD(memory, address)                                         \
+  (CountAccess(memory, address, 2), LoadHalfWordWithLogging(memory, address))
 
-#define LOAD_BYTE(memory, address) LoadByteWithLogging(memory, address)
+#define LOAD_BYTE(memory, address)                                             \
+  (CountAccess(memory, address, 1), LoadByteWithLogging(memory, address))
 
-void CPU::DMATransfer(Memory::Memory &memory) noexcept {
+namespace {
 
-  U8 NEW_VCOUNT = Emulator::Memory::ReadByteFromGBAMemory(memory, 0x04000006);
-  bool vcount_signal =
-      DMATransfer_PREV_VCOUNT != NEW_VCOUNT && NEW_VCOUNT == 160;
-  DMATransfer_PREV_VCOUNT = NEW_VCOUNT;
-
-  for (U32 dma_num = 0; dma_num < 4; ++dma_num) {
-    U32 offset = dma_num * 12;
-    U32 DMA0SAD =
-        Emulator::Memory::ReadWordFromGBAMemory(memory, 0x40000b0 + offset);
-    U32 DMA0DAD =
-        Emulator::Memory::ReadWordFromGBAMemory(memory, 0x40000b4 + offset);
-    Memory::DMA_CNT_L DMA0CNT_L =
-        Emulator::Memory::ReadHalfWordFromGBAMemory(memory, 0x40000b8 + offset);
-    Memory::DMA_CNT_H DMA0CNT_H =
-        Emulator::Memory::ReadHalfWordFromGBAMemory(memory, 0x40000ba + offset);
-
-    if (DMA0CNT_H.fields.en == 1) {
-      if (DMA0CNT_H.fields.tm == 0b11) {
-        if (dma_num != 3) {
-          // Sound mode, not implemented. TODO.
-          continue;
-        } else {
-          LOG("Video Capture Mode. Ought to implement");
-        }
-      } else if (DMA0CNT_H.fields.tm == 0b01) {
-        if (!vcount_signal) {
-          continue;
-        }
-      } else if (DMA0CNT_H.fields.tm == 0b10) {
-        ABORT("Unimplemented");
-      }
+template <typename T> void FillUnits(U8 *dst, const U8 *src, U32 count) {
+  T value;
+  memcpy(&value, src, sizeof(value));
+  for (U32 i = 0; i < count; ++i) {
+    memcpy(dst + i * sizeof(value), &value, sizeof(value));
+  }
+}
 
-      U32 src_addr = DMA0SAD;
-      U32 dst_addr = DMA0DAD;
-      U32 chunk_size = DMA0CNT_H.fields.cs == 0 ? 2 : 4;
-      for (U32 i = 0; i < DMA0CNT_L.fields.n; ++i) {
-        if (chunk_size == 2) {
-          U16 val = LOAD_HALFWORD(memory, src_addr);
-          STORE_HALFWORD(memory, dst_addr, val);
-        } else {
-          U32 val = LOAD_WORD(memory, src_addr);
-          STORE_WORD(memory, dst_addr, val);
-        }
+} // namespace
 
-        if (DMA0CNT_H.fields.da == 0b00) {
-          dst_addr += chunk_size;
-        } else if (DMA0CNT_H.fields.da == 0b01) {
-          dst_addr -= chunk_size;
-        } else if (DMA0CNT_H.fields.da == 0b10) {
-          // Fixed
-        } else {
-          ABORT("Invalid DMA direction");
-        }
+bool CPU::DMABulkTransfer(Memory::Memory &memory, U32 src_addr, U32 dst_addr,
+                          U32 count, U32 chunk_size, bool fixed_src) noexcept {
+  U32 bytes = count * chunk_size;
+  U32 src_bytes = fixed_src ? chunk_size : bytes;
+  // A gap between the ranges keeps the unit by unit copy order from
+  // mattering and means no load follows a store to the address before it, so
+  // every access but the first load is non-sequential.
+  if (!(U64(src_addr) + src_bytes < dst_addr ||
+        U64(dst_addr) + bytes < src_addr)) {
+    return false;
+  }
+  const U8 *src = Memory::GetPhysicalRangeReadOnly(memory, src_addr, src_bytes);
+  U8 *dst = Memory::GetPhysicalRangeReadWrite(memory, dst_addr, bytes);
+  if (src == nullptr || dst == nullptr) {
+    return false;
+  }
+  // Mirrors of the same memory.
+  if (src < dst + bytes && dst < src + src_bytes) {
+    return false;
+  }
 
-        if (DMA0CNT_H.fields.sa == 0b00) {
-          src_addr += chunk_size;
-        } else if (DMA0CNT_H.fields.sa == 0b01) {
-          src_addr -= chunk_size;
-        } else if (DMA0CNT_H.fields.sa == 0b10) {
-          // Fixed
-        } else {
-          ABORT("Invalid DMA direction");
-        }
+  if (!fixed_src) {
+    memcpy(dst, src, bytes);
+  } else if (chunk_size == 2) {
+    FillUnits<U16>(dst, src, count);
+  } else {
+    FillUnits<U32>(dst, src, count);
+  }
+
+  const Memory::WaitStates &wait = memory.Wait_States;
+  cycles += wait.Cycles(src_addr, chunk_size, src_addr == next_access_addr) +
+            (count - 1) * wait.Cycles(src_addr, chunk_size, false) +
+            count * wait.Cycles(dst_addr, chunk_size, false);
+  next_access_addr = dst_addr + bytes;
+
+  if (Memory::IsDisplayAddress(dst_addr)) {
+    Memory::MarkDisplayDirty(memory, dst_addr, bytes);
+  }
+  block_cache.InvalidateRange(dst_addr, bytes);
+  return true;
+}
+
+void CPU::DMATransfer(Memory::Memory &memory) noexcept {
+  // Channel 0 has the highest priority.
+  while (memory.Dma_Pending != 0) {
+    U32 dma_num = std::countr_zero(memory.Dma_Pending);
+    memory.Dma_Pending &= ~(1 << dma_num);
+
+    Memory::DmaChannel &channel = memory.Io.DMA[dma_num];
+    Memory::DmaInternal &internal = memory.Dma_Internal[dma_num];
+    Memory::DMA_CNT_H DMA0CNT_H = channel.CNT_H;
+
+    if (DMA0CNT_H.fields.tm == U16(Memory::DmaTiming::SPECIAL)) {
+      if (dma_num != 3) {
+        // Sound mode, not implemented. TODO.
+        continue;
+      } else {
+        LOG("Video Capture Mode. Ought to implement");
+      }
+    }
+
+    U32 src_addr = internal.src;
+    U32 dst_addr = internal.dst;
+    U32 chunk_size = DMA0CNT_H.fields.cs == 0 ? 2 : 4;
+    U32 count = internal.count;
+    // 0b11 increments like 0b00 and reloads DAD when the channel repeats.
+    bool dst_increments =
+        DMA0CNT_H.fields.da == 0b00 || DMA0CNT_H.fields.da == 0b11;
+    // Units are not logged or counted in the histogram on the bulk path.
+    bool bulk = !AccessHistogram::kEnabled && count != 0 && dst_increments &&
+                (DMA0CNT_H.fields.sa == 0b00 || DMA0CNT_H.fields.sa == 0b10) &&
+                DMABulkTransfer(memory, src_addr, dst_addr, count, chunk_size,
+                                DMA0CNT_H.fields.sa == 0b10);
+    if (bulk) {
+      dst_addr += count * chunk_size;
+      if (DMA0CNT_H.fields.sa == 0b00) {
+        src_addr += count * chunk_size;
       }
     }
+    for (U32 i = 0; i < count && !bulk; ++i) {
+      if (chunk_size == 2) {
+        U16 val = LOAD_HALFWORD(memory, src_addr);
+        STORE_HALFWORD(memory, dst_addr, val);
+      } else {
+        U32 val = LOAD_WORD(memory, src_addr);
+        STORE_WORD(memory, dst_addr, val);
+      }
 
-    if (DMA0CNT_H.fields.r == 0) {
+      if (dst_increments) {
+        dst_addr += chunk_size;
+      } else if (DMA0CNT_H.fields.da == 0b01) {
+        dst_addr -= chunk_size;
+      } else {
+        // Fixed
+      }
+
+      if (DMA0CNT_H.fields.sa == 0b00) {
+        src_addr += chunk_size;
+      } else if (DMA0CNT_H.fields.sa == 0b01) {
+        src_addr -= chunk_size;
+      } else if (DMA0CNT_H.fields.sa == 0b10) {
+        // Fixed
+      } else {
+        ABORT("Invalid DMA direction");
+      }
+    }
+    internal.src = src_addr;
+    internal.dst = dst_addr;
+
+    // Repeating channels stay enabled for their next VBlank or HBlank and
+    // carry on from where this transfer stopped, with the count and, for
+    // 0b11, the destination reloaded.
+    if (DMA0CNT_H.fields.r == 0 ||
+        DMA0CNT_H.fields.tm == U16(Memory::DmaTiming::IMMEDIATE)) {
       DMA0CNT_H.fields.en = 0;
-      WriteHalfWordToGBAMemory(memory, 0x40000ba + offset, DMA0CNT_H.value);
+      channel.CNT_H = DMA0CNT_H.value;
+    } else {
+      internal.count = channel.CNT_L;
+      if (DMA0CNT_H.fields.da == 0b11) {
+        internal.dst = channel.DAD;
+      }
+    }
+    if (DMA0CNT_H.fields.i) {
+      Memory::RequestInterrupt(memory, Memory::kIrqDma0 << dma_num);
     }
   }
 }
@@ -167,11 +256,10 @@ ShifterOperandResult CPU::ShifterOperand(DataProcessingInstr instr) noexcept {
 ShifterOperandResult
 CPU::ShifterOperandImmediate(DataProcessingInstrImmediate operand_2) noexcept {
   ShifterOperandResult result{};
-  CPSR_Register cpsr(registers->CPSR);
   result.shifter_operand =
       RotateRight(operand_2.fields.immed_8, operand_2.fields.rotate_imm * 2);
   if (operand_2.fields.rotate_imm == 0) {
-    result.shifter_carry_out = cpsr.bits.C;
+    result.shifter_carry_out = CarryFlag();
   } else {
     result.shifter_carry_out = GetBit(result.shifter_operand, 31);
   }
@@ -181,14 +269,13 @@ CPU::ShifterOperandImmediate(DataProcessingInstrImmediate operand_2) noexcept {
 ShifterOperandResult CPU::ShifterOperandLogicalShiftLeftByImm(
     DataProcessingInstrShiftByImm operand_2) noexcept {
   ShifterOperandResult result{};
-  CPSR_Register cpsr(registers->CPSR);
   if (operand_2.fields.shift_imm == 0) {
-    result.shifter_carry_out = cpsr.bits.C;
+    result.shifter_carry_out = CarryFlag();
   } else {
-    result.shifter_carry_out = GetBit(registers->r[operand_2.fields.rm],
+    result.shifter_carry_out = GetBit(registers.r[operand_2.fields.rm],
                                       32 - operand_2.fields.shift_imm);
   }
-  result.shifter_operand = LogicalShiftLeft(registers->r[operand_2.fields.rm],
+  result.shifter_operand = LogicalShiftLeft(registers.r[operand_2.fields.rm],
                                             operand_2.fields.shift_imm);
   return result;
 }
@@ -196,11 +283,11 @@ ShifterOperandResult CPU::ShifterOperandLogicalShiftLeftByImm(
 ShifterOperandResult CPU::ShifterOperandLogicalShiftLeftByRegister(
     DataProcessingInstrShiftByRegister operand_2) noexcept {
   ShifterOperandResult result{};
-  U8 rs(registers->r[operand_2.fields.rs]);
-  U32 rm(registers->r[operand_2.fields.rm]);
+  U8 rs(registers.r[operand_2.fields.rs]);
+  U32 rm(registers.r[operand_2.fields.rm]);
   if (rs == 0) {
     result.shifter_operand = rm;
-    result.shifter_carry_out = CPSR_Register(registers->CPSR).bits.C;
+    result.shifter_carry_out = CarryFlag();
   } else if (rs < 32) {
     result.shifter_operand = LogicalShiftLeft(rm, rs);
     result.shifter_carry_out = GetBit(rm, 32 - rs);
@@ -217,14 +304,13 @@ ShifterOperandResult CPU::ShifterOperandLogicalShiftLeftByRegister(
 ShifterOperandResult CPU::ShifterOperandLogicalShiftRightByImm(
     DataProcessingInstrShiftByImm operand_2) noexcept {
   ShifterOperandResult result{};
-  CPSR_Register cpsr(registers->CPSR);
   if (operand_2.fields.shift_imm == 0) {
     result.shifter_operand = 0;
-    result.shifter_carry_out = GetBit(registers->r[operand_2.fields.rm], 31);
+    result.shifter_carry_out = GetBit(registers.r[operand_2.fields.rm], 31);
   } else {
     result.shifter_operand = LogicalShiftRight(
-        registers->r[operand_2.fields.rm], operand_2.fields.shift_imm);
-    result.shifter_carry_out = GetBit(registers->r[operand_2.fields.rm],
+        registers.r[operand_2.fields.rm], operand_2.fields.shift_imm);
+    result.shifter_carry_out = GetBit(registers.r[operand_2.fields.rm],
                                       operand_2.fields.shift_imm - 1);
   }
   return result;
@@ -233,11 +319,11 @@ ShifterOperandResult CPU::ShifterOperandLogicalShiftRightByImm(
 ShifterOperandResult CPU::ShifterOperandLogicalShiftRightByRegister(
     DataProcessingInstrShiftByRegister operand_2) noexcept {
   ShifterOperandResult result{};
-  U8 rs(registers->r[operand_2.fields.rs]);
-  U32 rm(registers->r[operand_2.fields.rm]);
+  U8 rs(registers.r[operand_2.fields.rs]);
+  U32 rm(registers.r[operand_2.fields.rm]);
   if (rs == 0) {
     result.shifter_operand = rm;
-    result.shifter_carry_out = CPSR_Register(registers->CPSR).bits.C;
+    result.shifter_carry_out = CarryFlag();
   } else if (rs < 32) {
     result.shifter_operand = LogicalShiftRight(rm, rs);
     result.shifter_carry_out = GetBit(rm, rs - 1);
@@ -254,8 +340,7 @@ ShifterOperandResult CPU::ShifterOperandLogicalShiftRightByRegister(
 ShifterOperandResult CPU::ShifterOperandArithmeticShiftRightByImm(
     DataProcessingInstrShiftByImm operand_2) noexcept {
   ShifterOperandResult result{};
-  CPSR_Register cpsr(registers->CPSR);
-  U32 rm(registers->r[operand_2.fields.rm]);
+  U32 rm(registers.r[operand_2.fields.rm]);
   if (operand_2.fields.shift_imm == 0) {
     if (GetBit(rm, 31) == 0) {
       result.shifter_operand = 0;
@@ -275,11 +360,11 @@ ShifterOperandResult CPU::ShifterOperandArithmeticShiftRightByImm(
 ShifterOperandResult CPU::ShifterOperandArithmeticShiftRightByRegister(
     DataProcessingInstrShiftByRegister operand_2) noexcept {
   ShifterOperandResult result{};
-  U8 rs(registers->r[operand_2.fields.rs]);
-  U32 rm(registers->r[operand_2.fields.rm]);
+  U8 rs(registers.r[operand_2.fields.rs]);
+  U32 rm(registers.r[operand_2.fields.rm]);
   if (rs == 0) {
     result.shifter_operand = rm;
-    result.shifter_carry_out = CPSR_Register(registers->CPSR).bits.C;
+    result.shifter_carry_out = CarryFlag();
   } else if (rs < 32) {
     result.shifter_operand = ArithmeticShiftRight((I32)rm, rs);
     result.shifter_carry_out = GetBit(rm, rs - 1);
@@ -298,11 +383,10 @@ ShifterOperandResult CPU::ShifterOperandArithmeticShiftRightByRegister(
 ShifterOperandResult CPU::ShifterOperandRotateRightByImm(
     DataProcessingInstrShiftByImm operand_2) noexcept {
   ShifterOperandResult result{};
-  CPSR_Register cpsr(registers->CPSR);
-  U32 rm(registers->r[operand_2.fields.rm]);
+  U32 rm(registers.r[operand_2.fields.rm]);
   if (operand_2.fields.shift_imm == 0) {
     result.shifter_operand =
-        LogicalShiftLeft(cpsr.bits.C, 31) | LogicalShiftRight(rm, 1);
+        LogicalShiftLeft(CarryFlag(), 31) | LogicalShiftRight(rm, 1);
     result.shifter_carry_out = GetBit(rm, 0);
   } else {
     result.shifter_operand = RotateRight(rm, operand_2.fields.shift_imm);
@@ -314,11 +398,11 @@ ShifterOperandResult CPU::ShifterOperandRotateRightByImm(
 ShifterOperandResult CPU::ShifterOperandRotateRightByRegister(
     DataProcessingInstrShiftByRegister operand_2) noexcept {
   ShifterOperandResult result{};
-  U8 rs(registers->r[operand_2.fields.rs]);
-  U32 rm(registers->r[operand_2.fields.rm]);
+  U8 rs(registers.r[operand_2.fields.rs]);
+  U32 rm(registers.r[operand_2.fields.rm]);
   if (rs == 0) {
     result.shifter_operand = rm;
-    result.shifter_carry_out = CPSR_Register(registers->CPSR).bits.C;
+    result.shifter_carry_out = CarryFlag();
   } else if (GetBitsInRange(rs, 0, 5) == 0) {
     result.shifter_operand = rm;
     result.shifter_carry_out = GetBit(rm, 31);
@@ -329,7 +413,11 @@ ShifterOperandResult CPU::ShifterOperandRotateRightByRegister(
   return result;
 }
 
-bool CPU::AdvancePipeline(U32 instr, U32 addr) noexcept {
+bool CPU::AdvancePipeline(U32 instr, U32 addr, U16 opcode) noexcept {
+  pipeline_opcodes.execute = pipeline_opcodes.decode;
+  pipeline_opcodes.decode = pipeline_opcodes.fetch;
+  pipeline_opcodes.fetch = opcode;
+
   pipeline.execute = pipeline.decode;
   pipeline.decode = pipeline.fetch;
   pipeline.fetch = instr;
@@ -353,7 +441,7 @@ void CPU::ClearPipeline() noexcept {
 void CPU::EnterException_IRQ() noexcept {
   LOG_VERBOSE("Entering exception IRQ");
 
-  U32 old_cpsr = registers->CPSR;
+  U32 old_cpsr = ReadCPSR();
   CPSR_SetM(0b10010);
   CPSR_SetI(true);
   CPSR_SetT(false);
@@ -364,36 +452,97 @@ void CPU::EnterException_IRQ() noexcept {
   // step.
   MOV(registers, LR, pipeline.execute_addr + 4);
   MOV(registers, PC, 0x18);
-  registers->SPRS = old_cpsr;
+  registers.SPRS = old_cpsr;
+  ClearPipeline();
+}
+
+void CPU::EnterException_UND() noexcept {
+  LOG_VERBOSE("Entering exception UND");
+
+  U32 old_cpsr = ReadCPSR();
+  U32 next_instr_addr =
+      pipeline.execute_addr + (CPSR_Register(old_cpsr).bits.T ? 2 : 4);
+  CPSR_SetM(0b11011);
+  CPSR_SetI(true);
+  CPSR_SetT(false);
+  ChangeRegistersOnMode();
+  // The handler returns with movs pc, r14_und so point LR at the instruction
+  // after the undefined one.
+  MOV(registers, LR, next_instr_addr);
+  MOV(registers, PC, 0x04);
+  registers.SPRS = old_cpsr;
   ClearPipeline();
 }
 
-[[nodiscard]] bool ProcessInstruction(U32 instr, Memory::Memory &memory,
-                                      CPU &cpu) {
+std::array<U32 *, 8> CPU::BankedRegisters(Mode mode) noexcept {
+  AllRegisters &all = all_registers;
+  switch (mode) {
+  case Mode::USER:
+  case Mode::SYSTEM:
+    return {&all.r[8],  &all.r[9],  &all.r[10], &all.r[11],
+            &all.r[12], &all.r[13], &all.r[14], nullptr};
+  case Mode::FAST_INTERRUPT:
+    return {&all.r8_fiq,  &all.r9_fiq,  &all.r10_fiq, &all.r11_fiq,
+            &all.r12_fiq, &all.r13_fiq, &all.r14_fiq, &all.SPRS_fiq};
+  case Mode::INTERRUPT:
+    return {&all.r[8],  &all.r[9],    &all.r[10],   &all.r[11],
+            &all.r[12], &all.r13_irq, &all.r14_irq, &all.SPRS_irq};
+  case Mode::SUPERVISOR:
+    return {&all.r[8],  &all.r[9],    &all.r[10],   &all.r[11],
+            &all.r[12], &all.r13_svc, &all.r14_svc, &all.SPRS_svc};
+  case Mode::ABORT:
+    return {&all.r[8],  &all.r[9],    &all.r[10],   &all.r[11],
+            &all.r[12], &all.r13_abt, &all.r14_abt, &all.SPRS_abt};
+  case Mode::UNDEFINED:
+    return {&all.r[8],  &all.r[9],    &all.r[10],   &all.r[11],
+            &all.r[12], &all.r13_und, &all.r14_und, &all.SPRS_und};
+  }
+  ABORT("Undefined Mode %u", mode);
+}
+
+void CPU::SaveRegisters() noexcept {
+  for (U32 i = 0; i < 8; ++i) {
+    all_registers.r[i] = registers.r[i];
+  }
+  all_registers.r[PC] = registers.r[PC];
+  std::array<U32 *, 8> banked = BankedRegisters(registers_mode);
+  for (U32 i = 0; i < 7; ++i) {
+    *banked[i] = registers.r[8 + i];
+  }
+  if (banked[7] != nullptr) {
+    *banked[7] = registers.SPRS;
+  }
+  all_registers.CPSR = registers.CPSR;
+}
+
+void CPU::SwitchRegisters(Mode mode) noexcept {
+  // Save all of them first, the modes share r8-r12 unless one is FIQ.
+  SaveRegisters();
+  std::array<U32 *, 8> banked = BankedRegisters(mode);
+  for (U32 i = 0; i < 7; ++i) {
+    registers.r[8 + i] = *banked[i];
+  }
+  registers.SPRS = banked[7] != nullptr ? *banked[7] : 0;
+  registers_mode = mode;
+}
+
+[[nodiscard]] bool ProcessInstruction(U32 instr, U16 decoded_opcode,
+                                      Memory::Memory &memory, CPU &cpu) {
 
   if ((cpu.pipeline.execute_addr & 0b11) != 0) {
     ABORT("Pipeline execute address is not aligned to 4 bytes: 0x%04X",
           cpu.pipeline.execute_addr);
   }
 
-  ExtendedInstr extended_instr_opcode = GetExtendedArmOpcode(instr);
-  assert(extended_instr_opcode != ExtendedInstr::UNDEFINED1 ||
-         extended_instr_opcode != ExtendedInstr::UNDEFINED2 ||
-         extended_instr_opcode != ExtendedInstr::NUM_OPCODES);
-
-  Instr instr_opcode;
-  if (extended_instr_opcode == ExtendedInstr::NONE) {
-    instr_opcode = GetArmOpcode(instr);
-    LOG_VERBOSE("Dispatch %u - Instr: %s, Raw Instr: 0x%08X, PC: 0x%04X",
-                cpu.dispatch_num, ToString(instr_opcode), instr,
-                cpu.pipeline.execute_addr);
-  } else {
-    instr_opcode = ExtendedInstrToArmInstr[U32(extended_instr_opcode)];
-    LOG_VERBOSE(
-        "Dispatch %u - Extended Instr: %s, Raw Instr: 0x%08X, PC: 0x%04X",
-        cpu.dispatch_num, ToString(instr_opcode), instr,
-        cpu.pipeline.execute_addr);
-  }
+  Instr instr_opcode = decoded_opcode == kOpcodeNotDecoded
+                           ? DecodeArmInstr(instr)
+                           : Instr(decoded_opcode);
+#ifdef VERIFY_DECODER
+  assert(instr_opcode == DecodeArmInstr(instr));
+#endif
+  LOG_VERBOSE("Dispatch %u - Instr: %s, Raw Instr: 0x%08X, PC: 0x%04X",
+              cpu.dispatch_num, ToString(instr_opcode), instr,
+              cpu.pipeline.execute_addr);
   DispatchLogger::SET_CONTEXT(cpu.pipeline.execute, cpu.pipeline.execute_addr,
                               0, U32(instr_opcode));
 
@@ -493,6 +642,7 @@ void CPU::EnterException_IRQ() noexcept {
     LOG("Dispatch Failed on %u - Instr: %s, Raw Instr: 0x%08X, PC: 0x%04X",
         cpu.dispatch_num, ToString(instr_opcode), instr,
         cpu.pipeline.execute_addr);
+    cpu.PrepareSnapshot(memory);
     Debug::debug_snapshot(cpu.all_registers, memory, cpu.pipeline,
                           "tools/visual/data/");
   }
@@ -506,14 +656,116 @@ void CPU::EnterException_IRQ() noexcept {
   return true;
 }
 
-[[nodiscard]] bool ProcessThumbInstruction(U16 instr, Memory::Memory &memory,
+using ThumbHandlerFn = void (*)(CPU &cpu, U16 instr, Memory::Memory &memory);
+
+template <auto Dispatch>
+void ThumbHandler(CPU &cpu, U16 instr, Memory::Memory &memory) noexcept {
+  if constexpr (std::is_invocable_v<decltype(Dispatch), CPU &, U16,
+                                    Memory::Memory &>) {
+    (cpu.*Dispatch)(instr, memory);
+  } else {
+    (cpu.*Dispatch)(instr);
+  }
+}
+
+void ThumbHandler_Unimplemented(CPU &cpu, U16 instr,
+                                Memory::Memory &memory) noexcept {
+  LOG("Dispatch Failed on %u - Raw Thumb Instr: 0x%04X, Opcode: %s, PC: "
+      "0x%04X",
+      cpu.dispatch_num, instr, Thumb::ToString(Thumb::GetThumbOpcode(instr)),
+      cpu.pipeline.execute_addr);
+  cpu.PrepareSnapshot(memory);
+  Debug::debug_snapshot(cpu.all_registers, memory, cpu.pipeline,
+                        "tools/visual/data/");
+}
+
+void ThumbHandler_Undefined(CPU &cpu, U16 instr,
+                            Memory::Memory &memory) noexcept {
+  cpu.EnterException_UND();
+}
+
+/// Handler per thumb opcode, indexed by the result of GetThumbOpcode.
+constexpr std::array<ThumbHandlerFn, Thumb::UNDEFINED + 1>
+BuildThumbHandlers() {
+  std::array<ThumbHandlerFn, Thumb::UNDEFINED + 1> handlers{};
+  handlers.fill(ThumbHandler_Unimplemented);
+  handlers[Thumb::CMP1] = ThumbHandler<&CPU::Dispatch_Thumb_CMP1>;
+  handlers[Thumb::CMP2] = ThumbHandler<&CPU::Dispatch_Thumb_CMP2>;
+  handlers[Thumb::CMP3] = ThumbHandler<&CPU::Dispatch_Thumb_CMP3>;
+  handlers[Thumb::MOV1] = ThumbHandler<&CPU::Dispatch_Thumb_MOV1>;
+  handlers[Thumb::MOV2] = ThumbHandler<&CPU::Dispatch_Thumb_MOV2>;
+  handlers[Thumb::MOV3] = ThumbHandler<&CPU::Dispatch_Thumb_MOV3>;
+  handlers[Thumb::MVN] = ThumbHandler<&CPU::Dispatch_Thumb_MVN>;
+  handlers[Thumb::LDR1] = ThumbHandler<&CPU::Dispatch_Thumb_LDR1>;
+  handlers[Thumb::LDR2] = ThumbHandler<&CPU::Dispatch_Thumb_LDR2>;
+  handlers[Thumb::LDR3] = ThumbHandler<&CPU::Dispatch_Thumb_LDR3>;
+  handlers[Thumb::LDR4] = ThumbHandler<&CPU::Dispatch_Thumb_LDR4>;
+  handlers[Thumb::LDRB1] = ThumbHandler<&CPU::Dispatch_Thumb_LDRB1>;
+  handlers[Thumb::LDRB2] = ThumbHandler<&CPU::Dispatch_Thumb_LDRB2>;
+  handlers[Thumb::LDRSB] = ThumbHandler<&CPU::Dispatch_Thumb_LDRSB>;
+  handlers[Thumb::LDRH1] = ThumbHandler<&CPU::Dispatch_Thumb_LDRH1>;
+  handlers[Thumb::LDRH2] = ThumbHandler<&CPU::Dispatch_Thumb_LDRH2>;
+  handlers[Thumb::LDRSH] = ThumbHandler<&CPU::Dispatch_Thumb_LDRSH>;
+  handlers[Thumb::LDMIA] = ThumbHandler<&CPU::Dispatch_Thumb_LDMIA>;
+  handlers[Thumb::STRB1] = ThumbHandler<&CPU::Dispatch_Thumb_STRB1>;
+  handlers[Thumb::STR1] = ThumbHandler<&CPU::Dispatch_Thumb_STR1>;
+  handlers[Thumb::STR2] = ThumbHandler<&CPU::Dispatch_Thumb_STR2>;
+  handlers[Thumb::STR3] = ThumbHandler<&CPU::Dispatch_Thumb_STR3>;
+  handlers[Thumb::STMIA] = ThumbHandler<&CPU::Dispatch_Thumb_STMIA>;
+  handlers[Thumb::STRH1] = ThumbHandler<&CPU::Dispatch_Thumb_STRH1>;
+  handlers[Thumb::STRH2] = ThumbHandler<&CPU::Dispatch_Thumb_STRH2>;
+  handlers[Thumb::ORR] = ThumbHandler<&CPU::Dispatch_Thumb_ORR>;
+  handlers[Thumb::EOR] = ThumbHandler<&CPU::Dispatch_Thumb_EOR>;
+  handlers[Thumb::AND] = ThumbHandler<&CPU::Dispatch_Thumb_AND>;
+  handlers[Thumb::CMN] = ThumbHandler<&CPU::Dispatch_Thumb_CMN>;
+  handlers[Thumb::ADD1] = ThumbHandler<&CPU::Dispatch_Thumb_ADD1>;
+  handlers[Thumb::ADD2] = ThumbHandler<&CPU::Dispatch_Thumb_ADD2>;
+  handlers[Thumb::ADD3] = ThumbHandler<&CPU::Dispatch_Thumb_ADD3>;
+  handlers[Thumb::ADD5] = ThumbHandler<&CPU::Dispatch_Thumb_ADD5>;
+  handlers[Thumb::ADD6] = ThumbHandler<&CPU::Dispatch_Thumb_ADD6>;
+  handlers[Thumb::ADD7] = ThumbHandler<&CPU::Dispatch_Thumb_ADD7>;
+  handlers[Thumb::NEG] = ThumbHandler<&CPU::Dispatch_Thumb_NEG>;
+  handlers[Thumb::LSL1] = ThumbHandler<&CPU::Dispatch_Thumb_LSL1>;
+  handlers[Thumb::LSL2] = ThumbHandler<&CPU::Dispatch_Thumb_LSL2>;
+  handlers[Thumb::LSR1] = ThumbHandler<&CPU::Dispatch_Thumb_LSR1>;
+  handlers[Thumb::LSR2] = ThumbHandler<&CPU::Dispatch_Thumb_LSR2>;
+  handlers[Thumb::ROR] = ThumbHandler<&CPU::Dispatch_Thumb_ROR>;
+  handlers[Thumb::ASR1] = ThumbHandler<&CPU::Dispatch_Thumb_ASR1>;
+  handlers[Thumb::B1] = ThumbHandler<&CPU::Dispatch_Thumb_B1>;
+  handlers[Thumb::B2] = ThumbHandler<&CPU::Dispatch_Thumb_B2>;
+  handlers[Thumb::BIC] = ThumbHandler<&CPU::Dispatch_Thumb_BIC>;
+  handlers[Thumb::BL] = ThumbHandler<&CPU::Dispatch_Thumb_BL>;
+  handlers[Thumb::BX] = ThumbHandler<&CPU::Dispatch_Thumb_BX>;
+  handlers[Thumb::PUSH] = ThumbHandler<&CPU::Dispatch_Thumb_PUSH>;
+  handlers[Thumb::POP] = ThumbHandler<&CPU::Dispatch_Thumb_POP>;
+  handlers[Thumb::SUB1] = ThumbHandler<&CPU::Dispatch_Thumb_SUB1>;
+  handlers[Thumb::SUB2] = ThumbHandler<&CPU::Dispatch_Thumb_SUB2>;
+  handlers[Thumb::SUB3] = ThumbHandler<&CPU::Dispatch_Thumb_SUB3>;
+  handlers[Thumb::SUB4] = ThumbHandler<&CPU::Dispatch_Thumb_SUB4>;
+  handlers[Thumb::TST] = ThumbHandler<&CPU::Dispatch_Thumb_TST>;
+  handlers[Thumb::MUL] = ThumbHandler<&CPU::Dispatch_Thumb_MUL>;
+  handlers[Thumb::UNDEFINED] = ThumbHandler_Undefined;
+  return handlers;
+}
+
+constexpr std::array<ThumbHandlerFn, Thumb::UNDEFINED + 1> ThumbHandlers =
+    BuildThumbHandlers();
+
+[[nodiscard]] bool ProcessThumbInstruction(U16 instr, U16 decoded_opcode,
+                                           Memory::Memory &memory,
                                            CPU &cpu) noexcept {
   if ((cpu.pipeline.execute_addr & 0b1) != 0) {
     ABORT("Pipeline execute address is not aligned to 2 bytes: 0x%04X",
           cpu.pipeline.execute_addr);
   }
 
-  const Thumb::ThumbOpcode opcode = Thumb::GetThumbOpcode(instr);
+  const Thumb::ThumbOpcode opcode =
+      decoded_opcode == kOpcodeNotDecoded
+          ? Thumb::GetThumbOpcode(instr)
+          : Thumb::ThumbOpcode(decoded_opcode);
+#ifdef VERIFY_DECODER
+  assert(opcode == Thumb::GetThumbOpcode(instr));
+#endif
   LOG_VERBOSE("Dispatch %u - Raw Thumb Instr: 0x%04X, Opcode: %s, PC: 0x%04X",
               cpu.dispatch_num, instr, Thumb::ToString(opcode),
               cpu.pipeline.execute_addr);
@@ -521,181 +773,7 @@ void CPU::EnterException_IRQ() noexcept {
                               1, U32(opcode));
 
   cpu.Branched = false;
-  switch (opcode) {
-  case Thumb::ThumbOpcode::CMP1:
-    cpu.Dispatch_Thumb_CMP1(instr);
-    break;
-  case Thumb::ThumbOpcode::CMP2:
-    cpu.Dispatch_Thumb_CMP2(instr);
-    break;
-  case Thumb::ThumbOpcode::CMP3:
-    cpu.Dispatch_Thumb_CMP3(instr);
-    break;
-  case Thumb::ThumbOpcode::MOV1:
-    cpu.Dispatch_Thumb_MOV1(instr);
-    break;
-  case Thumb::ThumbOpcode::MOV2:
-    cpu.Dispatch_Thumb_MOV2(instr);
-    break;
-  case Thumb::ThumbOpcode::MOV3:
-    cpu.Dispatch_Thumb_MOV3(instr);
-    break;
-  case Thumb::ThumbOpcode::MVN:
-    cpu.Dispatch_Thumb_MVN(instr);
-    break;
-  case Thumb::ThumbOpcode::LDR1:
-    cpu.Dispatch_Thumb_LDR1(instr, memory);
-    break;
-  case Thumb::ThumbOpcode::LDR2:
-    cpu.Dispatch_Thumb_LDR2(instr, memory);
-    break;
-  case Thumb::ThumbOpcode::LDR3:
-    cpu.Dispatch_Thumb_LDR3(instr, memory);
-    break;
-  case Thumb::ThumbOpcode::LDR4:
-    cpu.Dispatch_Thumb_LDR4(instr, memory);
-    break;
-  case Thumb::ThumbOpcode::LDRB1:
-    cpu.Dispatch_Thumb_LDRB1(instr, memory);
-    break;
-  case Thumb::ThumbOpcode::LDRB2:
-    cpu.Dispatch_Thumb_LDRB2(instr, memory);
-    break;
-  case Thumb::ThumbOpcode::LDRSB:
-    cpu.Dispatch_Thumb_LDRSB(instr, memory);
-    break;
-  case Thumb::ThumbOpcode::LDRH1:
-    cpu.Dispatch_Thumb_LDRH1(instr, memory);
-    break;
-  case Thumb::ThumbOpcode::LDRH2:
-    cpu.Dispatch_Thumb_LDRH2(instr, memory);
-    break;
-  case Thumb::ThumbOpcode::LDRSH:
-    cpu.Dispatch_Thumb_LDRSH(instr, memory);
-    break;
-  case Thumb::ThumbOpcode::LDMIA:
-    cpu.Dispatch_Thumb_LDMIA(instr, memory);
-    break;
-  case Thumb::ThumbOpcode::STRB1:
-    cpu.Dispatch_Thumb_STRB1(instr, memory);
-    break;
-  case Thumb::ThumbOpcode::STR1:
-    cpu.Dispatch_Thumb_STR1(instr, memory);
-    break;
-  case Thumb::ThumbOpcode::STR2:
-    cpu.Dispatch_Thumb_STR2(instr, memory);
-    break;
-  case Thumb::ThumbOpcode::STR3:
-    cpu.Dispatch_Thumb_STR3(instr, memory);
-    break;
-  case Thumb::ThumbOpcode::STMIA:
-    cpu.Dispatch_Thumb_STMIA(instr, memory);
-    break;
-  case Thumb::ThumbOpcode::STRH1:
-    cpu.Dispatch_Thumb_STRH1(instr, memory);
-    break;
-  case Thumb::ThumbOpcode::STRH2:
-    cpu.Dispatch_Thumb_STRH2(instr, memory);
-    break;
-  case Thumb::ThumbOpcode::ORR:
-    cpu.Dispatch_Thumb_ORR(instr);
-    break;
-  case Thumb::ThumbOpcode::EOR:
-    cpu.Dispatch_Thumb_EOR(instr);
-    break;
-  case Thumb::ThumbOpcode::AND:
-    cpu.Dispatch_Thumb_AND(instr);
-    break;
-  case Thumb::ThumbOpcode::CMN:
-    cpu.Dispatch_Thumb_CMN(instr);
-    break;
-  case Thumb::ThumbOpcode::ADD1:
-    cpu.Dispatch_Thumb_ADD1(instr);
-    break;
-  case Thumb::ThumbOpcode::ADD2:
-    cpu.Dispatch_Thumb_ADD2(instr);
-    break;
-  case Thumb::ThumbOpcode::ADD3:
-    cpu.Dispatch_Thumb_ADD3(instr);
-    break;
-  case Thumb::ThumbOpcode::ADD5:
-    cpu.Dispatch_Thumb_ADD5(instr);
-    break;
-  case Thumb::ThumbOpcode::ADD6:
-    cpu.Dispatch_Thumb_ADD6(instr);
-    break;
-  case Thumb::ThumbOpcode::ADD7:
-    cpu.Dispatch_Thumb_ADD7(instr);
-    break;
-  case Thumb::ThumbOpcode::NEG:
-    cpu.Dispatch_Thumb_NEG(instr);
-    break;
-  case Thumb::ThumbOpcode::LSL1:
-    cpu.Dispatch_Thumb_LSL1(instr);
-    break;
-  case Thumb::ThumbOpcode::LSL2:
-    cpu.Dispatch_Thumb_LSL2(instr);
-    break;
-  case Thumb::ThumbOpcode::LSR1:
-    cpu.Dispatch_Thumb_LSR1(instr);
-    break;
-  case Thumb::ThumbOpcode::LSR2:
-    cpu.Dispatch_Thumb_LSR2(instr);
-    break;
-  case Thumb::ThumbOpcode::ROR:
-    cpu.Dispatch_Thumb_ROR(instr);
-    break;
-  case Thumb::ThumbOpcode::ASR1:
-    cpu.Dispatch_Thumb_ASR1(instr);
-    break;
-  case Thumb::ThumbOpcode::B1:
-    cpu.Dispatch_Thumb_B1(instr);
-    break;
-  case Thumb::ThumbOpcode::B2:
-    cpu.Dispatch_Thumb_B2(instr);
-    break;
-  case Thumb::ThumbOpcode::BIC:
-    cpu.Dispatch_Thumb_BIC(instr);
-    break;
-  case Thumb::ThumbOpcode::BL:
-    cpu.Dispatch_Thumb_BL(instr);
-    break;
-  case Thumb::ThumbOpcode::BX:
-    cpu.Dispatch_Thumb_BX(instr);
-    break;
-  case Thumb::ThumbOpcode::PUSH:
-    cpu.Dispatch_Thumb_PUSH(instr, memory);
-    break;
-  case Thumb::ThumbOpcode::POP:
-    cpu.Dispatch_Thumb_POP(instr, memory);
-    break;
-  case Thumb::ThumbOpcode::SUB1:
-    cpu.Dispatch_Thumb_SUB1(instr);
-    break;
-  case Thumb::ThumbOpcode::SUB2:
-    cpu.Dispatch_Thumb_SUB2(instr);
-    break;
-  case Thumb::ThumbOpcode::SUB3:
-    cpu.Dispatch_Thumb_SUB3(instr);
-    break;
-  case Thumb::ThumbOpcode::SUB4:
-    cpu.Dispatch_Thumb_SUB4(instr);
-    break;
-  case Thumb::ThumbOpcode::TST:
-    cpu.Dispatch_Thumb_TST(instr);
-    break;
-  case Thumb::ThumbOpcode::MUL:
-    cpu.Dispatch_Thumb_MUL(instr);
-    break;
-  default:
-    LOG("Dispatch Failed on %u - Raw Thumb Instr: 0x%04X, Opcode: %s, PC: "
-        "0x%04X",
-        cpu.dispatch_num, instr, Thumb::ToString(opcode),
-        cpu.pipeline.execute_addr);
-    Debug::debug_snapshot(cpu.all_registers, memory, cpu.pipeline,
-                          "tools/visual/data/");
-    break;
-  }
+  ThumbHandlers[opcode](cpu, instr, memory);
 
   if (!cpu.Branched) {
     cpu.IncrementThumbPC();
@@ -706,40 +784,11 @@ void CPU::EnterException_IRQ() noexcept {
   return true;
 }
 
-bool EvaluateCondition(ConditionCode cond, U32 cpsr_) {
-  CPSR_Register cpsr(cpsr_);
-  switch (cond) {
-  case ConditionCode::EQ:
-    return cpsr.bits.Z;
-  case ConditionCode::NE:
-    return !cpsr.bits.Z;
-  case ConditionCode::CS:
-    return cpsr.bits.C;
-  case ConditionCode::CC:
-    return !cpsr.bits.C;
-  case ConditionCode::MI:
-    return cpsr.bits.N;
-  case ConditionCode::PL:
-    return !cpsr.bits.N;
-  case ConditionCode::VS:
-    return cpsr.bits.V;
-  case ConditionCode::VC:
-    return !cpsr.bits.V;
-  case ConditionCode::HI:
-    return cpsr.bits.C && !cpsr.bits.Z;
-  case ConditionCode::LS:
-    return !cpsr.bits.C || cpsr.bits.Z;
-  case ConditionCode::GE:
-    return cpsr.bits.N == cpsr.bits.V;
-  case ConditionCode::LT:
-    return cpsr.bits.N != cpsr.bits.V;
-  case ConditionCode::GT:
-    return !cpsr.bits.Z && cpsr.bits.N == cpsr.bits.V;
-  case ConditionCode::LE:
-    return cpsr.bits.Z || cpsr.bits.N != cpsr.bits.V;
-  case ConditionCode::AL:
+bool CPU::ConditionPassed(ConditionCode cond) noexcept {
+  if (cond == ConditionCode::AL) {
     return true;
   }
+  return EvaluateCondition(cond, ReadCPSR());
 }
 
 U32 CPU::LoadAndStoreMiscImmAddr(U32 instr_) noexcept {
@@ -750,23 +799,23 @@ U32 CPU::LoadAndStoreMiscImmAddr(U32 instr_) noexcept {
   U32 offset_8 = (encoding.fields.immedh << 4) | encoding.fields.immedl;
   if (instr.fields.p == 1 && instr.fields.w == 0) {
     if (instr.fields.u == 1) {
-      address = registers->r[instr.fields.rn] + offset_8;
+      address = registers.r[instr.fields.rn] + offset_8;
     } else {
-      address = registers->r[instr.fields.rn] - offset_8;
+      address = registers.r[instr.fields.rn] - offset_8;
     }
   } else if (instr.fields.p == 1 && instr.fields.w == 1) {
     if (instr.fields.u == 1) {
-      address = registers->r[instr.fields.rn] + offset_8;
+      address = registers.r[instr.fields.rn] + offset_8;
     } else {
-      address = registers->r[instr.fields.rn] - offset_8;
+      address = registers.r[instr.fields.rn] - offset_8;
     }
     MOV(registers, instr.fields.rn, address);
   } else if (instr.fields.p == 0 && instr.fields.w == 0) {
-    address = registers->r[instr.fields.rn];
+    address = registers.r[instr.fields.rn];
     if (instr.fields.u == 1) {
-      MOV(registers, instr.fields.rn, registers->r[instr.fields.rn] + offset_8);
+      MOV(registers, instr.fields.rn, registers.r[instr.fields.rn] + offset_8);
     } else {
-      MOV(registers, instr.fields.rn, registers->r[instr.fields.rn] - offset_8);
+      MOV(registers, instr.fields.rn, registers.r[instr.fields.rn] - offset_8);
     }
   } else {
     ABORT("Bad Load And Store Halfword Address");
@@ -782,29 +831,29 @@ U32 CPU::LoadAndStoreMiscRegAddr(U32 instr_) noexcept {
   if (instr.fields.p == 1 && instr.fields.w == 0) {
     if (instr.fields.u == 1) {
       address =
-          registers->r[instr.fields.rn] + registers->r[encoding.fields.rm];
+          registers.r[instr.fields.rn] + registers.r[encoding.fields.rm];
     } else {
-      address = U32(registers->r[instr.fields.rn]) -
-                U32(registers->r[encoding.fields.rm]);
+      address = U32(registers.r[instr.fields.rn]) -
+                U32(registers.r[encoding.fields.rm]);
     }
   } else if (instr.fields.p == 1 && instr.fields.w == 1) {
     if (instr.fields.u == 1) {
       address =
-          registers->r[instr.fields.rn] + registers->r[encoding.fields.rm];
+          registers.r[instr.fields.rn] + registers.r[encoding.fields.rm];
     } else {
-      address = U32(registers->r[instr.fields.rn]) -
-                U32(registers->r[encoding.fields.rm]);
+      address = U32(registers.r[instr.fields.rn]) -
+                U32(registers.r[encoding.fields.rm]);
     }
     MOV(registers, instr.fields.rn, address);
   } else if (instr.fields.p == 0 && instr.fields.w == 0) {
-    address = registers->r[instr.fields.rn];
+    address = registers.r[instr.fields.rn];
     if (instr.fields.u == 1) {
       MOV(registers, instr.fields.rn,
-          registers->r[instr.fields.rn] + registers->r[encoding.fields.rm]);
+          registers.r[instr.fields.rn] + registers.r[encoding.fields.rm]);
     } else {
       MOV(registers, instr.fields.rn,
-          U32(registers->r[instr.fields.rn]) -
-              U32(registers->r[encoding.fields.rm]));
+          U32(registers.r[instr.fields.rn]) -
+              U32(registers.r[encoding.fields.rm]));
     }
   } else {
     ABORT("Bad Load And Store Halfword Address");
@@ -816,7 +865,7 @@ U32 CPU::LoadAndStoreWordOrByteImmAddr(U32 instr_) noexcept {
   const SingleDataTransferInstr instr{instr_};
   const LoadAndStoreWordOrByteImm encoding{instr.fields.offset};
 
-  if (!EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
+  if (!ConditionPassed(ConditionCode(instr.fields.cond))) {
     // Does not matter. The instruction will be skipped anyways.
     return 0;
   }
@@ -825,28 +874,28 @@ U32 CPU::LoadAndStoreWordOrByteImmAddr(U32 instr_) noexcept {
     if (instr.fields.w == 1) {
       if (instr.fields.u == 1) {
         MOV(registers, instr.fields.rn,
-            registers->r[instr.fields.rn] + encoding.fields.offset);
+            registers.r[instr.fields.rn] + encoding.fields.offset);
       } else {
         MOV(registers, instr.fields.rn,
-            registers->r[instr.fields.rn] - encoding.fields.offset);
+            registers.r[instr.fields.rn] - encoding.fields.offset);
       }
-      address = registers->r[instr.fields.rn];
+      address = registers.r[instr.fields.rn];
     } else {
       if (instr.fields.u == 1) {
-        address = registers->r[instr.fields.rn] + encoding.fields.offset;
+        address = registers.r[instr.fields.rn] + encoding.fields.offset;
       } else {
-        address = registers->r[instr.fields.rn] - encoding.fields.offset;
+        address = registers.r[instr.fields.rn] - encoding.fields.offset;
       }
     }
   }
   if (instr.fields.p == 0) {
-    address = registers->r[instr.fields.rn];
+    address = registers.r[instr.fields.rn];
     if (instr.fields.u == 1) {
       MOV(registers, instr.fields.rn,
-          registers->r[instr.fields.rn] + encoding.fields.offset);
+          registers.r[instr.fields.rn] + encoding.fields.offset);
     } else {
       MOV(registers, instr.fields.rn,
-          registers->r[instr.fields.rn] - encoding.fields.offset);
+          registers.r[instr.fields.rn] - encoding.fields.offset);
     }
   }
   return address;
@@ -856,7 +905,7 @@ U32 CPU::LoadAndStoreWordOrByteRegAddr(U32 instr_) noexcept {
   const SingleDataTransferInstr instr{instr_};
   const LoadAndStoreWordOrByteReg encoding{instr.fields.offset};
 
-  if (!EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
+  if (!ConditionPassed(ConditionCode(instr.fields.cond))) {
     // Does not matter. The instruction will be skipped anyways.
     return 0;
   }
@@ -864,36 +913,35 @@ U32 CPU::LoadAndStoreWordOrByteRegAddr(U32 instr_) noexcept {
   U32 index;
   switch (encoding.fields.shift) {
   case (0b00):
-    index = LogicalShiftLeft(registers->r[encoding.fields.rm],
+    index = LogicalShiftLeft(registers.r[encoding.fields.rm],
                              encoding.fields.shift_imm);
     break;
   case (0b01):
     if (encoding.fields.shift_imm == 0) {
       index = 0;
     } else {
-      index = LogicalShiftRight(registers->r[encoding.fields.rm],
+      index = LogicalShiftRight(registers.r[encoding.fields.rm],
                                 encoding.fields.shift_imm);
     }
     break;
   case (0b10):
     if (encoding.fields.shift_imm == 0) {
-      if (registers->r[encoding.fields.rm] == 1) {
+      if (registers.r[encoding.fields.rm] == 1) {
         index = 0xFFFFFFFF;
       } else {
         index = 0;
       }
     } else {
-      index = ArithmeticShiftRight(registers->r[encoding.fields.rm],
+      index = ArithmeticShiftRight(registers.r[encoding.fields.rm],
                                    encoding.fields.shift_imm);
     }
     break;
   case (0b11):
-    CPSR_Register cpsr(registers->CPSR);
     if (encoding.fields.shift_imm == 0) {
-      index = LogicalShiftLeft(cpsr.bits.C, 31) |
-              LogicalShiftRight(registers->r[encoding.fields.rm], 1);
+      index = LogicalShiftLeft(CarryFlag(), 31) |
+              LogicalShiftRight(registers.r[encoding.fields.rm], 1);
     } else {
-      index = RotateRight(registers->r[encoding.fields.rm],
+      index = RotateRight(registers.r[encoding.fields.rm],
                           encoding.fields.shift_imm);
     }
     break;
@@ -901,20 +949,20 @@ U32 CPU::LoadAndStoreWordOrByteRegAddr(U32 instr_) noexcept {
 
   if (instr.fields.p == 1 && instr.fields.w == 1) {
     if (instr.fields.u == 1) {
-      MOV(registers, instr.fields.rn, registers->r[instr.fields.rn] + index);
+      MOV(registers, instr.fields.rn, registers.r[instr.fields.rn] + index);
     } else {
-      MOV(registers, instr.fields.rn, registers->r[instr.fields.rn] - index);
+      MOV(registers, instr.fields.rn, registers.r[instr.fields.rn] - index);
     }
     // TODO: Add w == 0 case which determines access privilege.
   }
 
-  U32 address = registers->r[instr.fields.rn];
+  U32 address = registers.r[instr.fields.rn];
 
   if (instr.fields.p == 0) {
     if (instr.fields.u == 1) {
-      MOV(registers, instr.fields.rn, registers->r[instr.fields.rn] + index);
+      MOV(registers, instr.fields.rn, registers.r[instr.fields.rn] + index);
     } else {
-      MOV(registers, instr.fields.rn, registers->r[instr.fields.rn] - index);
+      MOV(registers, instr.fields.rn, registers.r[instr.fields.rn] - index);
     }
   }
   return address;
@@ -940,36 +988,36 @@ LoadAndStoreMultipleAddrResult
 CPU::LoadAndStoreMultipleAddr(U32 instr_) noexcept {
   LoadAndStoreMultiple instr(instr_);
 
-  if (!EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
+  if (!ConditionPassed(ConditionCode(instr.fields.cond))) {
     return {};
   }
 
   LoadAndStoreMultipleAddrResult result;
   if (instr.fields.p == 0 && instr.fields.u == 1) {
-    result.start_addr = registers->r[instr.fields.rn];
-    result.end_addr = registers->r[instr.fields.rn] +
+    result.start_addr = registers.r[instr.fields.rn];
+    result.end_addr = registers.r[instr.fields.rn] +
                       CountSetBits(instr.fields.register_list) * 4 - 4;
     if (instr.fields.w == 1) {
       MOV(registers, instr.fields.rn, result.end_addr + 4);
     }
   } else if (instr.fields.p == 1 && instr.fields.u == 1) {
-    result.start_addr = registers->r[instr.fields.rn] + 4;
-    result.end_addr = registers->r[instr.fields.rn] +
+    result.start_addr = registers.r[instr.fields.rn] + 4;
+    result.end_addr = registers.r[instr.fields.rn] +
                       CountSetBits(instr.fields.register_list) * 4;
     if (instr.fields.w == 1) {
       MOV(registers, instr.fields.rn, result.end_addr);
     }
   } else if (instr.fields.p == 0 && instr.fields.u == 0) {
-    result.start_addr = registers->r[instr.fields.rn] -
+    result.start_addr = registers.r[instr.fields.rn] -
                         CountSetBits(instr.fields.register_list) * 4 + 4;
-    result.end_addr = registers->r[instr.fields.rn];
+    result.end_addr = registers.r[instr.fields.rn];
     if (instr.fields.w == 1) {
       MOV(registers, instr.fields.rn, result.start_addr - 4);
     }
   } else {
-    result.start_addr = registers->r[instr.fields.rn] -
+    result.start_addr = registers.r[instr.fields.rn] -
                         CountSetBits(instr.fields.register_list) * 4;
-    result.end_addr = registers->r[instr.fields.rn] - 4;
+    result.end_addr = registers.r[instr.fields.rn] - 4;
     if (instr.fields.w == 1) {
       MOV(registers, instr.fields.rn, result.start_addr);
     }
@@ -977,141 +1025,684 @@ CPU::LoadAndStoreMultipleAddr(U32 instr_) noexcept {
   return result;
 }
 
-[[nodiscard]] bool CPU::Dispatch(Memory::Memory &memory) noexcept {
-  DMATransfer(memory);
-  ChangeRegistersOnMode();
-  CPSR_Register cpsr(registers->CPSR);
+[[nodiscard]] U32 CPU::Dispatch(Memory::Memory &memory) noexcept {
+  U64 start = cycles;
+#ifdef ENABLE_JIT
+  if (jit_enabled) {
+    return jit.Dispatch(*this, memory) ? U32(cycles - start) : 0;
+  }
+#endif
+#ifdef THREADED_DISPATCH
+  if (execution_model == ExecutionModel::PC_OFFSET) {
+    RunThreaded(memory);
+    return U32(cycles - start);
+  }
+#endif
+  return Step(memory, nullptr) != StepResult::STOPPED ? U32(cycles - start)
+                                                      : 0;
+}
+
+void CPU::CountAccess(const Memory::Memory &memory, U32 address,
+                      U32 size) noexcept {
+  cycles += memory.Wait_States.Cycles(address, size,
+                                      address == next_access_addr);
+  next_access_addr = address + size;
+}
+
+namespace {
+
+/// Multiplies end early when the top bits of the multiplier are all zeros or
+/// all ones.
+U32 MultiplyCycles(U32 rs) {
+  if ((rs >> 8) == 0 || (rs >> 8) == 0xFFFFFF) {
+    return 1;
+  } else if ((rs >> 16) == 0 || (rs >> 16) == 0xFFFF) {
+    return 2;
+  } else if ((rs >> 24) == 0 || (rs >> 24) == 0xFF) {
+    return 3;
+  }
+  return 4;
+}
+
+} // namespace
+
+U32 CPU::InternalCycles(U32 instr, U16 opcode, bool thumb) const noexcept {
+  if (thumb) {
+    switch (Thumb::ThumbOpcode(opcode)) {
+    case Thumb::LDR1:
+    case Thumb::LDR2:
+    case Thumb::LDR3:
+    case Thumb::LDR4:
+    case Thumb::LDRB1:
+    case Thumb::LDRB2:
+    case Thumb::LDRH1:
+    case Thumb::LDRH2:
+    case Thumb::LDRSB:
+    case Thumb::LDRSH:
+    case Thumb::LDMIA:
+    case Thumb::POP:
+    case Thumb::LSL2:
+    case Thumb::LSR2:
+    case Thumb::ASR2:
+    case Thumb::ROR:
+      return 1;
+    case Thumb::MUL:
+      return MultiplyCycles(registers.r[instr & 0x7]);
+    default:
+      return 0;
+    }
+  }
+  U32 rs = registers.r[(instr >> 8) & 0xF];
+  switch (Instr(opcode)) {
+  case Instr::LDR:
+  case Instr::LDRB:
+  case Instr::LDRBT:
+  case Instr::LDRH:
+  case Instr::LDRSB:
+  case Instr::LDRSH:
+  case Instr::LDRT:
+  case Instr::LDM:
+  case Instr::SWP:
+  case Instr::SWPB:
+    return 1;
+  case Instr::MUL:
+    return MultiplyCycles(rs);
+  case Instr::MLA:
+    return MultiplyCycles(rs) + 1;
+  case Instr::UMULL:
+  case Instr::SMULL:
+    return MultiplyCycles(rs) + 1;
+  case Instr::UMLAL:
+  case Instr::SMLAL:
+    return MultiplyCycles(rs) + 2;
+  case Instr::AND:
+  case Instr::EOR:
+  case Instr::SUB:
+  case Instr::RSB:
+  case Instr::ADD:
+  case Instr::ADC:
+  case Instr::SBC:
+  case Instr::RSC:
+  case Instr::TST:
+  case Instr::TEQ:
+  case Instr::CMP:
+  case Instr::CMN:
+  case Instr::ORR:
+  case Instr::MOV:
+  case Instr::BIC:
+  case Instr::MVN:
+    // Shift by register.
+    return ((instr >> 25) & 1) == 0 && ((instr >> 4) & 1) == 1;
+  default:
+    return 0;
+  }
+}
+
+const DecodedInstr *CPU::FetchDecoded(Memory::Memory &memory, U32 addr,
+                                      bool thumb,
+                                      const ExpectedFetch *expected,
+                                      DecodedInstr &storage,
+                                      bool &used_expected) noexcept {
+  COUNT_ACCESS(FETCH, addr, thumb ? 2 : 4);
+  used_expected = expected != nullptr && expected->addr == addr &&
+                  expected->thumb == thumb &&
+                  expected->generation == block_cache.generation();
+  if (used_expected) {
+    storage = {.instr = expected->instr, .opcode = expected->opcode};
+    return &storage;
+  }
+  const DecodedInstr *decoded = block_cache.Fetch(memory, addr, thumb);
+  if (decoded == nullptr) {
+    storage = {.instr = thumb ? ReadHalfWordFromGBAMemory(memory, addr)
+                              : ReadWordFromGBAMemory(memory, addr),
+               .opcode = kOpcodeNotDecoded};
+    return &storage;
+  }
+  return decoded;
+}
+
+StepResult CPU::Step(Memory::Memory &memory,
+                                   const ExpectedFetch *expected) noexcept {
+  if (execution_model == ExecutionModel::PC_OFFSET) {
+    return StepPcOffset(memory, expected);
+  }
+  idle = false;
+  if (memory.Dma_Pending != 0) [[unlikely]] {
+    DMATransfer(memory);
+  }
+  CPSR_Register cpsr(registers.CPSR);
+  DecodedInstr storage;
   if (cpsr.bits.T) {
-    U16 instr = ReadHalfWordFromGBAMemory(memory, registers->r[PC] & ~1);
+    U32 addr = registers.r[PC] & ~1;
+    bool used_expected;
+    const DecodedInstr *decoded =
+        FetchDecoded(memory, addr, true, expected, storage, used_expected);
+    CountAccess(memory, addr, 2);
+    bool sequential = expected == nullptr || used_expected;
     bool existsInstructionToExecute =
-        AdvancePipeline(instr, registers->r[PC] & ~1);
+        AdvancePipeline(decoded->instr, addr, decoded->opcode);
     if (existsInstructionToExecute) {
-      if ((!CPSR_Register(registers->CPSR).bits.I) &&
-          (ReadHalfWordFromGBAMemory(memory, Emulator::Memory::IME)) &&
-          (ReadHalfWordFromGBAMemory(memory, Emulator::Memory::IE) &
-           ReadHalfWordFromGBAMemory(memory, Emulator::Memory::IF))) {
+      if (memory.Irq_Pending && !cpsr.bits.I) {
         EnterException_IRQ();
-        return true;
+        return StepResult::NOT_SEQUENTIAL;
+      }
+      U32 execute_addr = pipeline.execute_addr;
+      cycles += InternalCycles(pipeline.execute, pipeline_opcodes.execute,
+                               true);
+      if (!ProcessThumbInstruction((U16)pipeline.execute,
+                                   pipeline_opcodes.execute, memory, *this)) {
+        return StepResult::STOPPED;
       }
-      if (!ProcessThumbInstruction((U16)pipeline.execute, memory, *this)) {
-        return false;
+      // A branch clears the pipeline.
+      if (pipeline.fetch_addr == U32(-1)) {
+        sequential = false;
+        idle = idle_loops.OnBranch(memory, execute_addr, registers.r[PC] & ~1,
+                                   true, block_cache.generation());
       }
     } else {
-      MOV(registers, PC, registers->r[PC] + 2);
+      MOV(registers, PC, registers.r[PC] + 2);
     }
+    dispatch_num++;
+    return sequential ? StepResult::SEQUENTIAL : StepResult::NOT_SEQUENTIAL;
   } else {
-    U32 instr = ReadWordFromGBAMemory(memory, registers->r[PC]);
-    bool existsInstructionToExecute = AdvancePipeline(instr, registers->r[PC]);
+    U32 addr = registers.r[PC];
+    bool used_expected;
+    const DecodedInstr *decoded =
+        FetchDecoded(memory, addr, false, expected, storage, used_expected);
+    CountAccess(memory, addr, 4);
+    bool sequential = expected == nullptr || used_expected;
+    bool existsInstructionToExecute =
+        AdvancePipeline(decoded->instr, addr, decoded->opcode);
     if (existsInstructionToExecute) {
-      if ((!CPSR_Register(registers->CPSR).bits.I) &&
-          (ReadHalfWordFromGBAMemory(memory, Emulator::Memory::IME)) &&
-          (ReadHalfWordFromGBAMemory(memory, Emulator::Memory::IE) &
-           ReadHalfWordFromGBAMemory(memory, Emulator::Memory::IF))) {
+      if (memory.Irq_Pending && !cpsr.bits.I) {
         EnterException_IRQ();
-        return true;
+        return StepResult::NOT_SEQUENTIAL;
       }
 
-      if (!ProcessInstruction(pipeline.execute, memory, *this)) {
-        return false;
+      U32 execute_addr = pipeline.execute_addr;
+      cycles += InternalCycles(pipeline.execute, pipeline_opcodes.execute,
+                               false);
+      if (!ProcessInstruction(pipeline.execute, pipeline_opcodes.execute,
+                              memory, *this)) {
+        return StepResult::STOPPED;
+      }
+      // A branch clears the pipeline.
+      if (pipeline.fetch_addr == U32(-1)) {
+        sequential = false;
+        idle = idle_loops.OnBranch(memory, execute_addr, registers.r[PC],
+                                   false, block_cache.generation());
       }
     } else {
-      MOV(registers, PC, registers->r[PC] + 4);
+      MOV(registers, PC, registers.r[PC] + 4);
     }
+    dispatch_num++;
+    return sequential ? StepResult::SEQUENTIAL : StepResult::NOT_SEQUENTIAL;
+  }
+}
+
+const DecodedInstr *CPU::PcOffsetFetch(Memory::Memory &memory,
+                                       const ExpectedFetch *expected,
+                                       DecodedInstr &storage,
+                                       bool &sequential) noexcept {
+  idle = false;
+  if (memory.Dma_Pending != 0) [[unlikely]] {
+    DMATransfer(memory);
+  }
+  CPSR_Register cpsr(registers.CPSR);
+  bool thumb = cpsr.bits.T;
+  U32 size = thumb ? 2 : 4;
+  // Between steps PC is the address of the next instruction to execute.
+  U32 addr = thumb ? registers.r[PC] & ~1 : U32(registers.r[PC]);
+  if (next_access_addr == U32(-1) && pipeline.execute_addr == U32(-1))
+      [[unlikely]] {
+    // First step after reset, the pipeline fills like after a branch.
+    CountAccess(memory, addr, size);
+    CountAccess(memory, addr + size, size);
+    next_access_addr = addr;
+  }
+  bool used_expected;
+  const DecodedInstr *decoded =
+      FetchDecoded(memory, addr, thumb, expected, storage, used_expected);
+  CountAccess(memory, addr, size);
+  sequential = expected == nullptr || used_expected;
+
+  pipeline.execute = decoded->instr;
+  pipeline.execute_addr = addr;
+  pipeline.decode = U32(-1);
+  pipeline.decode_addr = addr + size;
+  pipeline.fetch = U32(-1);
+  pipeline.fetch_addr = addr + 2 * size;
+  pipeline_opcodes.execute = decoded->opcode;
+
+  if (memory.Irq_Pending && !cpsr.bits.I) {
+    EnterException_IRQ();
+    CountAccess(memory, 0x18, 4);
+    CountAccess(memory, 0x1C, 4);
+    next_access_addr = 0x18;
+    return nullptr;
+  }
+
+  // What the instruction reads as PC.
+  registers.r[PC] = pipeline.fetch_addr;
+  cycles += InternalCycles(decoded->instr, decoded->opcode, thumb);
+  return decoded;
+}
+
+void CPU::PcOffsetRetire(Memory::Memory &memory, U32 addr, bool thumb,
+                         bool &sequential) noexcept {
+  U32 size = thumb ? 2 : 4;
+  // A branch clears the pipeline and leaves the target in PC.
+  if (pipeline.fetch_addr == U32(-1)) {
+    sequential = false;
+    U32 target = thumb ? registers.r[PC] & ~1 : U32(registers.r[PC]);
+    idle = idle_loops.OnBranch(memory, addr, target, thumb,
+                               block_cache.generation());
+    // The two fetches that refill the pipeline. The target's own fetch is
+    // then sequential, like the third fetch after a branch is.
+    CountAccess(memory, target, size);
+    CountAccess(memory, target + size, size);
+    next_access_addr = target;
+  } else {
+    registers.r[PC] = addr + size;
   }
   dispatch_num++;
-  return true;
+}
+
+StepResult CPU::StepPcOffset(Memory::Memory &memory,
+                             const ExpectedFetch *expected) noexcept {
+  DecodedInstr storage;
+  bool sequential;
+  const DecodedInstr *decoded =
+      PcOffsetFetch(memory, expected, storage, sequential);
+  if (decoded == nullptr) {
+    return StepResult::NOT_SEQUENTIAL;
+  }
+  U32 addr = pipeline.execute_addr;
+  bool thumb = CPSR_Register(registers.CPSR).bits.T;
+  bool processed =
+      thumb ? ProcessThumbInstruction(U16(decoded->instr), decoded->opcode,
+                                      memory, *this)
+            : ProcessInstruction(decoded->instr, decoded->opcode, memory,
+                                 *this);
+  if (!processed) {
+    return StepResult::STOPPED;
+  }
+  PcOffsetRetire(memory, addr, thumb, sequential);
+  return sequential ? StepResult::SEQUENTIAL : StepResult::NOT_SEQUENTIAL;
+}
+
+#ifdef THREADED_DISPATCH
+
+// Opcodes the threaded core has a label for. X takes handlers that run
+// without memory, X_MEM those that take it.
+#define THREADED_ARM_OPS(X, X_MEM)                                             \
+  X(B) X(BL) X(BIC) X(BX) X(MOV) X(MSR) X(CMP) X(TEQ) X(TST) X(MRS) X(ORR)     \
+  X(EOR) X(CMN) X(SUB) X(RSB) X(ADD) X(MUL) X(UMULL) X(ADC) X(AND)             \
+  X_MEM(LDR) X_MEM(LDRB) X_MEM(LDRSB) X_MEM(LDRH) X_MEM(LDRSH) X_MEM(STM)      \
+  X_MEM(LDM) X_MEM(STR) X_MEM(STRB) X_MEM(STRH)
+
+#define THREADED_THUMB_OPS(X, X_MEM)                                           \
+  X(CMP1) X(CMP2) X(CMP3) X(MOV1) X(MOV2) X(MOV3) X(MVN) X(ORR) X(EOR)         \
+  X(AND) X(CMN) X(ADD1) X(ADD2) X(ADD3) X(ADD5) X(ADD6) X(ADD7) X(NEG)         \
+  X(LSL1) X(LSL2) X(LSR1) X(LSR2) X(ROR) X(ASR1) X(B1) X(B2) X(BIC) X(BL)      \
+  X(BX) X(SUB1) X(SUB2) X(SUB3) X(SUB4) X(TST) X(MUL)                          \
+  X_MEM(LDR1) X_MEM(LDR2) X_MEM(LDR3) X_MEM(LDR4) X_MEM(LDRB1) X_MEM(LDRB2)    \
+  X_MEM(LDRSB) X_MEM(LDRH1) X_MEM(LDRH2) X_MEM(LDRSH) X_MEM(LDMIA)             \
+  X_MEM(STRB1) X_MEM(STR1) X_MEM(STR2) X_MEM(STR3) X_MEM(STMIA) X_MEM(STRH1)   \
+  X_MEM(STRH2) X_MEM(PUSH) X_MEM(POP)
+
+namespace {
+
+// Label slots: one per ARM opcode, then one per Thumb opcode, then the exit.
+constexpr U32 kThreadedThumbBase = U32(Instr::BAD_CODE) + 1;
+constexpr U32 kThreadedExit = kThreadedThumbBase + Thumb::UNDEFINED + 1;
+
+} // namespace
+
+void CPU::RunThreaded(Memory::Memory &memory) noexcept {
+  static void *labels[kThreadedExit + 1];
+  if (labels[kThreadedExit] == nullptr) {
+    for (U32 i = 0; i < kThreadedThumbBase; ++i) {
+      labels[i] = &&ARM_UNIMPLEMENTED;
+    }
+    for (U32 i = kThreadedThumbBase; i < kThreadedExit; ++i) {
+      labels[i] = &&THUMB_UNIMPLEMENTED;
+    }
+#define SET_ARM_LABEL(op) labels[U32(Instr::op)] = &&ARM_##op;
+#define SET_THUMB_LABEL(op)                                                    \
+  labels[kThreadedThumbBase + Thumb::op] = &&THUMB_##op;
+    THREADED_ARM_OPS(SET_ARM_LABEL, SET_ARM_LABEL)
+    THREADED_THUMB_OPS(SET_THUMB_LABEL, SET_THUMB_LABEL)
+#undef SET_ARM_LABEL
+#undef SET_THUMB_LABEL
+    labels[kThreadedThumbBase + Thumb::UNDEFINED] = &&THUMB_UNDEFINED;
+    labels[kThreadedExit] = &&EXIT;
+  }
+
+  DecodedInstr storage;
+  bool sequential;
+  U32 instr = 0;
+  U32 addr = 0;
+  U16 opcode = 0;
+  bool thumb = false;
+
+  // Fetches and decodes the instruction at PC like StepPcOffset and runs the
+  // prologue of ProcessInstruction. Returns its label, or the exit if an
+  // event came due while entering an IRQ.
+  auto fetch = [&]() -> U32 {
+    const DecodedInstr *decoded;
+    while ((decoded = PcOffsetFetch(memory, nullptr, storage, sequential)) ==
+           nullptr) {
+      // Entering the IRQ was the step.
+      if (cycles >= memory.Events.next_timestamp()) {
+        return kThreadedExit;
+      }
+    }
+    instr = decoded->instr;
+    addr = pipeline.execute_addr;
+    thumb = CPSR_Register(registers.CPSR).bits.T;
+    Branched = false;
+    if (thumb) {
+      if ((addr & 0b1) != 0) {
+        ABORT("Pipeline execute address is not aligned to 2 bytes: 0x%04X",
+              addr);
+      }
+      opcode = decoded->opcode == kOpcodeNotDecoded
+                   ? Thumb::GetThumbOpcode(U16(instr))
+                   : decoded->opcode;
+#ifdef VERIFY_DECODER
+      assert(opcode == Thumb::GetThumbOpcode(U16(instr)));
+#endif
+      LOG_VERBOSE(
+          "Dispatch %u - Raw Thumb Instr: 0x%04X, Opcode: %s, PC: 0x%04X",
+          dispatch_num, instr, Thumb::ToString(Thumb::ThumbOpcode(opcode)),
+          addr);
+      DispatchLogger::SET_CONTEXT(instr, addr, 1, opcode);
+      return kThreadedThumbBase + opcode;
+    }
+    if ((addr & 0b11) != 0) {
+      ABORT("Pipeline execute address is not aligned to 4 bytes: 0x%04X",
+            addr);
+    }
+    opcode = decoded->opcode == kOpcodeNotDecoded ? U16(DecodeArmInstr(instr))
+                                                  : decoded->opcode;
+#ifdef VERIFY_DECODER
+    assert(Instr(opcode) == DecodeArmInstr(instr));
+#endif
+    LOG_VERBOSE("Dispatch %u - Instr: %s, Raw Instr: 0x%08X, PC: 0x%04X",
+                dispatch_num, ToString(Instr(opcode)), instr, addr);
+    DispatchLogger::SET_CONTEXT(instr, addr, 0, opcode);
+    return opcode;
+  };
+
+  // The epilogue of ProcessInstruction and the rest of StepPcOffset, then
+  // the next fetch unless the runner has something to do.
+  auto retire = [&]() -> U32 {
+    if (!Branched) {
+      thumb ? IncrementThumbPC() : IncrementPC();
+    } else {
+      ClearPipeline();
+    }
+    PcOffsetRetire(memory, addr, thumb, sequential);
+    if (idle || cycles >= memory.Events.next_timestamp()) {
+      return kThreadedExit;
+    }
+    return fetch();
+  };
+
+  goto *labels[fetch()];
+
+#define ARM_LABEL(op)                                                          \
+  ARM_##op : Dispatch_##op(instr);                                             \
+  goto *labels[retire()];
+#define ARM_MEM_LABEL(op)                                                      \
+  ARM_##op : Dispatch_##op(instr, memory);                                     \
+  goto *labels[retire()];
+#define THUMB_LABEL(op)                                                        \
+  THUMB_##op : Dispatch_Thumb_##op(U16(instr));                                \
+  goto *labels[retire()];
+#define THUMB_MEM_LABEL(op)                                                    \
+  THUMB_##op : Dispatch_Thumb_##op(U16(instr), memory);                        \
+  goto *labels[retire()];
+  THREADED_ARM_OPS(ARM_LABEL, ARM_MEM_LABEL)
+  THREADED_THUMB_OPS(THUMB_LABEL, THUMB_MEM_LABEL)
+#undef ARM_LABEL
+#undef ARM_MEM_LABEL
+#undef THUMB_LABEL
+#undef THUMB_MEM_LABEL
+
+ARM_UNIMPLEMENTED:
+  LOG("Dispatch Failed on %u - Instr: %s, Raw Instr: 0x%08X, PC: 0x%04X",
+      dispatch_num, ToString(Instr(opcode)), instr, addr);
+  PrepareSnapshot(memory);
+  Debug::debug_snapshot(all_registers, memory, pipeline, "tools/visual/data/");
+  goto *labels[retire()];
+THUMB_UNIMPLEMENTED:
+  ThumbHandler_Unimplemented(*this, U16(instr), memory);
+  goto *labels[retire()];
+THUMB_UNDEFINED:
+  EnterException_UND();
+  goto *labels[retire()];
+EXIT:
+  return;
+}
+
+#undef THREADED_ARM_OPS
+#undef THREADED_THUMB_OPS
+
+#endif
+
+void CPU::PrepareSnapshot(const Memory::Memory &memory) noexcept {
+  SyncFlags();
+  SaveRegisters();
+  if (execution_model != ExecutionModel::PC_OFFSET ||
+      pipeline.execute_addr == U32(-1)) {
+    return;
+  }
+  // Fill in the stages PC_OFFSET does not fetch.
+  if (CPSR_Register(registers.CPSR).bits.T) {
+    pipeline.decode = ReadHalfWordFromGBAMemory(memory, pipeline.decode_addr);
+    pipeline.fetch = ReadHalfWordFromGBAMemory(memory, pipeline.fetch_addr);
+  } else {
+    pipeline.decode = ReadWordFromGBAMemory(memory, pipeline.decode_addr);
+    pipeline.fetch = ReadWordFromGBAMemory(memory, pipeline.fetch_addr);
+  }
+}
+
+template <U32 kOperand>
+ShifterOperandResult
+CPU::ShifterOperandFor(DataProcessingInstr instr) noexcept {
+  if constexpr (kOperand == kShifterOperandImmediate) {
+    return ShifterOperandImmediate(instr.fields.operand_2);
+  } else if constexpr (kOperand == 1) {
+    return ShifterOperandLogicalShiftLeftByImm(instr.fields.operand_2);
+  } else if constexpr (kOperand == 2) {
+    return ShifterOperandLogicalShiftLeftByRegister(instr.fields.operand_2);
+  } else if constexpr (kOperand == 3) {
+    return ShifterOperandLogicalShiftRightByImm(instr.fields.operand_2);
+  } else if constexpr (kOperand == 4) {
+    return ShifterOperandLogicalShiftRightByRegister(instr.fields.operand_2);
+  } else if constexpr (kOperand == 5) {
+    return ShifterOperandArithmeticShiftRightByImm(instr.fields.operand_2);
+  } else if constexpr (kOperand == 6) {
+    return ShifterOperandArithmeticShiftRightByRegister(instr.fields.operand_2);
+  } else if constexpr (kOperand == 7) {
+    return ShifterOperandRotateRightByImm(instr.fields.operand_2);
+  } else {
+    static_assert(kOperand == 8);
+    return ShifterOperandRotateRightByRegister(instr.fields.operand_2);
+  }
+}
+
+template <Instr kOp, U32 kVariant>
+void CPU::Dispatch_DataProcessing(U32 instr_) noexcept {
+  constexpr bool kCondAL = kVariant & 1;
+  constexpr bool kS = (kVariant >> 1) & 1;
+  constexpr U32 kOperand = kVariant >> 2;
+
+  const DataProcessingInstr instr(instr_);
+  if constexpr (!kCondAL) {
+    if (!ConditionPassed(ConditionCode(instr.fields.cond))) {
+      return;
+    }
+  }
+  ShifterOperandResult shifter = ShifterOperandFor<kOperand>(instr);
+  U32 carry_in = 0;
+  if constexpr (kOp == Instr::ADC) {
+    carry_in = CarryFlag();
+  }
+
+  if constexpr (kOp == Instr::CMP) {
+    SetNZ(registers.r[instr.fields.rn] - shifter.shifter_operand);
+    SetCV(FlagOp::SUB, registers.r[instr.fields.rn],
+          shifter.shifter_operand);
+  } else if constexpr (kOp == Instr::CMN) {
+    SetNZ(registers.r[instr.fields.rn] + shifter.shifter_operand);
+    SetCV(FlagOp::ADD, registers.r[instr.fields.rn],
+          shifter.shifter_operand);
+  } else if constexpr (kOp == Instr::TST || kOp == Instr::TEQ) {
+    U32 alu_out = kOp == Instr::TST
+                      ? registers.r[instr.fields.rn] & shifter.shifter_operand
+                      : registers.r[instr.fields.rn] ^ shifter.shifter_operand;
+    SetNZ(alu_out);
+    CPSR_SetC(shifter.shifter_carry_out);
+  } else {
+    U32 result;
+    if constexpr (kOp == Instr::MOV) {
+      result = shifter.shifter_operand;
+    } else if constexpr (kOp == Instr::AND) {
+      result = registers.r[instr.fields.rn] & shifter.shifter_operand;
+    } else if constexpr (kOp == Instr::EOR) {
+      result = registers.r[instr.fields.rn] ^ shifter.shifter_operand;
+    } else if constexpr (kOp == Instr::ORR) {
+      result = registers.r[instr.fields.rn] | shifter.shifter_operand;
+    } else if constexpr (kOp == Instr::BIC) {
+      result = registers.r[instr.fields.rn] & ~shifter.shifter_operand;
+    } else if constexpr (kOp == Instr::ADD) {
+      result = registers.r[instr.fields.rn] + shifter.shifter_operand;
+    } else if constexpr (kOp == Instr::ADC) {
+      result = registers.r[instr.fields.rn] + shifter.shifter_operand +
+               carry_in;
+    } else if constexpr (kOp == Instr::SUB) {
+      result = registers.r[instr.fields.rn] - shifter.shifter_operand;
+    } else {
+      static_assert(kOp == Instr::RSB);
+      result = shifter.shifter_operand - registers.r[instr.fields.rn];
+    }
+    MOV(registers, instr.fields.rd, result);
+
+    if constexpr (kS) {
+      if (instr.fields.rd == PC) {
+        SyncFlags();
+        registers.CPSR = U32(registers.SPRS);
+        ChangeRegistersOnMode();
+        return;
+      }
+      // Flags are computed from the registers after the write, so rn reads
+      // the result when rd == rn.
+      SetNZ(registers.r[instr.fields.rd]);
+      if constexpr (kOp == Instr::ADD) {
+        SetCV(FlagOp::ADD, registers.r[instr.fields.rn],
+              shifter.shifter_operand);
+      } else if constexpr (kOp == Instr::ADC) {
+        SetCV(FlagOp::ADC, registers.r[instr.fields.rn],
+              shifter.shifter_operand, carry_in);
+      } else if constexpr (kOp == Instr::SUB) {
+        SetCV(FlagOp::SUB, registers.r[instr.fields.rn],
+              shifter.shifter_operand);
+      } else if constexpr (kOp == Instr::RSB) {
+        SetCV(FlagOp::SUB, shifter.shifter_operand,
+              registers.r[instr.fields.rn]);
+      } else {
+        CPSR_SetC(shifter.shifter_carry_out);
+      }
+    }
+  }
+}
+
+using DataProcessingFn = void (CPU::*)(U32 instr) noexcept;
+
+template <Instr kOp, std::size_t... kVariants>
+constexpr std::array<DataProcessingFn, kNumDataProcessingVariants>
+MakeDataProcessingTable(std::index_sequence<kVariants...>) {
+  return {&CPU::Dispatch_DataProcessing<kOp, kVariants>...};
+}
+
+template <Instr kOp> void CPU::DispatchDataProcessing(U32 instr) noexcept {
+  static constexpr std::array<DataProcessingFn, kNumDataProcessingVariants>
+      kHandlers = MakeDataProcessingTable<kOp>(
+          std::make_index_sequence<kNumDataProcessingVariants>{});
+  (this->*kHandlers[DataProcessingVariant(instr)])(instr);
 }
 
 void CPU::Dispatch_B(U32 instr_) noexcept {
   const BranchInstr instr(instr_);
-  if (!EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
+  if (!ConditionPassed(ConditionCode(instr.fields.cond))) {
     return;
   }
   MOV(registers, PC,
-      static_cast<I32>(registers->r[PC]) +
+      static_cast<I32>(registers.r[PC]) +
           SignExtend(ConcatBits(instr.fields.offset, 0b00, 2), 26));
 }
 
 void CPU::Dispatch_BL(U32 instr_) noexcept {
   const BranchInstr instr(instr_);
-  if (!EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
+  if (!ConditionPassed(ConditionCode(instr.fields.cond))) {
     return;
   }
   MOV(registers, PC,
-      static_cast<I32>(registers->r[PC]) +
+      static_cast<I32>(registers.r[PC]) +
           SignExtend(ConcatBits(instr.fields.offset, 0b00, 2), 26));
   MOV(registers, 14, pipeline.execute_addr + 4);
 }
 
-void CPU::Dispatch_BIC(U32 instr_) noexcept {
-  DataProcessingInstr instr(instr_);
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
-    ShifterOperandResult shifter = ShifterOperand(instr);
-    MOV(registers, instr.fields.rd,
-        registers->r[instr.fields.rn] & ~shifter.shifter_operand);
-    if (instr.fields.s && instr.fields.rd == PC) {
-      registers->CPSR = U32(registers->SPRS);
-    } else if (instr.fields.s) {
-      CPSR_SetN(GetBit(registers->r[instr.fields.rd], 31));
-      CPSR_SetZ(registers->r[instr.fields.rd] == 0);
-      CPSR_SetC(shifter.shifter_carry_out);
-    }
-  }
+void CPU::Dispatch_BIC(U32 instr) noexcept {
+  DispatchDataProcessing<Instr::BIC>(instr);
 }
 
 void CPU::Dispatch_BX(U32 instr_) noexcept {
   const BranchAndExchangeInstr instr(instr_);
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
-    CPSR_SetT(GetBit(registers->r[instr.fields.rm], 0));
-    MOV(registers, PC, registers->r[instr.fields.rm] & 0xFFFFFFFE);
+  if (ConditionPassed(ConditionCode(instr.fields.cond))) {
+    CPSR_SetT(GetBit(registers.r[instr.fields.rm], 0));
+    MOV(registers, PC, registers.r[instr.fields.rm] & 0xFFFFFFFE);
   }
 }
 
-void CPU::Dispatch_MOV(U32 instr_) noexcept {
-  const DataProcessingInstr instr(instr_);
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
-    ShifterOperandResult shifter = ShifterOperand(instr);
-    MOV(registers, instr.fields.rd, shifter.shifter_operand);
-    if (instr.fields.s && instr.fields.rd == PC) {
-      registers->CPSR = U32(registers->SPRS);
-    } else if (instr.fields.s) {
-      CPSR_SetN(GetBit(registers->r[instr.fields.rd], 31));
-      CPSR_SetZ(registers->r[instr.fields.rd] == 0);
-      CPSR_SetC(shifter.shifter_carry_out);
-    }
-  }
+void CPU::Dispatch_MOV(U32 instr) noexcept {
+  DispatchDataProcessing<Instr::MOV>(instr);
 }
 
 void CPU::Dispatch_MSR(U32 instr_) noexcept {
   MSRImmInstr instr(instr_);
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
+  if (ConditionPassed(ConditionCode(instr.fields.cond))) {
     U32 operand = 0;
     if (GetBit(instr_, 25)) {
       MSRImmInstr instr(instr_);
       operand = RotateRight(instr.fields.imm, instr.fields.rotate_imm * 2);
     } else {
       MSRRegInstr instr(instr_);
-      operand = registers->r[instr.fields.rm];
+      operand = registers.r[instr.fields.rm];
     }
     if (instr.fields.r == 0) {
-      CPSR_Register cpsr(registers->CPSR);
+      CPSR_Register cpsr(ReadCPSR());
       if (GetMode() != Mode::USER) {
         if (GetBit(instr.fields.field_mask, 0)) {
-          registers->CPSR =
-              (registers->CPSR & 0xFFFFFF00) | (operand & 0x000000FF);
+          registers.CPSR =
+              (registers.CPSR & 0xFFFFFF00) | (operand & 0x000000FF);
+          ChangeRegistersOnMode();
         }
         if (GetBit(instr.fields.field_mask, 1)) {
-          registers->CPSR =
-              (registers->CPSR & 0xFFFF00FF) | (operand & 0x0000FF00);
+          registers.CPSR =
+              (registers.CPSR & 0xFFFF00FF) | (operand & 0x0000FF00);
         }
         if (GetBit(instr.fields.field_mask, 2)) {
-          registers->CPSR =
-              (registers->CPSR & 0xFF00FFFF) | (operand & 0x00FF0000);
+          registers.CPSR =
+              (registers.CPSR & 0xFF00FFFF) | (operand & 0x00FF0000);
         }
       }
       if (GetBit(instr.fields.field_mask, 3)) {
-        registers->CPSR =
-            (registers->CPSR & 0x00FFFFFF) | (operand & 0xFF000000);
+        registers.CPSR =
+            (registers.CPSR & 0x00FFFFFF) | (operand & 0xFF000000);
       }
     } else {
       Mode mode = GetMode();
@@ -1119,20 +1710,20 @@ void CPU::Dispatch_MSR(U32 instr_) noexcept {
           mode == Mode::UNDEFINED || mode == Mode::INTERRUPT ||
           mode == Mode::FAST_INTERRUPT) {
         if (GetBit(instr.fields.field_mask, 0)) {
-          registers->SPRS =
-              (registers->SPRS & 0xFFFFFF00) | (operand & 0x000000FF);
+          registers.SPRS =
+              (registers.SPRS & 0xFFFFFF00) | (operand & 0x000000FF);
         }
         if (GetBit(instr.fields.field_mask, 1)) {
-          registers->SPRS =
-              (registers->SPRS & 0xFFFF00FF) | (operand & 0x0000FF00);
+          registers.SPRS =
+              (registers.SPRS & 0xFFFF00FF) | (operand & 0x0000FF00);
         }
         if (GetBit(instr.fields.field_mask, 2)) {
-          registers->SPRS =
-              (registers->SPRS & 0xFF00FFFF) | (operand & 0x00FF0000);
+          registers.SPRS =
+              (registers.SPRS & 0xFF00FFFF) | (operand & 0x00FF0000);
         }
         if (GetBit(instr.fields.field_mask, 3)) {
-          registers->SPRS =
-              (registers->SPRS & 0x00FFFFFF) | (operand & 0xFF000000);
+          registers.SPRS =
+              (registers.SPRS & 0x00FFFFFF) | (operand & 0xFF000000);
         }
       }
     }
@@ -1141,50 +1732,26 @@ void CPU::Dispatch_MSR(U32 instr_) noexcept {
 
 void CPU::Dispatch_MRS(U32 instr_) noexcept {
   MRSRegInstr instr(instr_);
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
+  if (ConditionPassed(ConditionCode(instr.fields.cond))) {
     if (instr.fields.r == 1) {
-      MOV(registers, instr.fields.rd, U32(registers->SPRS));
+      MOV(registers, instr.fields.rd, U32(registers.SPRS));
     } else {
-      MOV(registers, instr.fields.rd, U32(registers->CPSR));
+      MOV(registers, instr.fields.rd, ReadCPSR());
     }
   }
 }
 
-void CPU::Dispatch_ORR(U32 instr_) noexcept {
-  DataProcessingInstr instr(instr_);
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
-    ShifterOperandResult shifter = ShifterOperand(instr);
-    MOV(registers, instr.fields.rd,
-        registers->r[instr.fields.rn] | shifter.shifter_operand);
-    if (instr.fields.s == 1 && instr.fields.rd == PC) {
-      registers->CPSR = U32(registers->SPRS);
-    } else if (instr.fields.s == 1) {
-      CPSR_SetN(GetBit(registers->r[instr.fields.rd], 31));
-      CPSR_SetZ(registers->r[instr.fields.rd] == 0);
-      CPSR_SetC(shifter.shifter_carry_out);
-    }
-  }
+void CPU::Dispatch_ORR(U32 instr) noexcept {
+  DispatchDataProcessing<Instr::ORR>(instr);
 }
 
-void CPU::Dispatch_EOR(U32 instr_) noexcept {
-  DataProcessingInstr instr(instr_);
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
-    ShifterOperandResult shifter = ShifterOperand(instr);
-    MOV(registers, instr.fields.rd,
-        registers->r[instr.fields.rn] ^ shifter.shifter_operand);
-    if (instr.fields.s == 1 && instr.fields.rd == PC) {
-      registers->CPSR = U32(registers->SPRS);
-    } else if (instr.fields.s == 1) {
-      CPSR_SetN(GetBit(registers->r[instr.fields.rd], 31));
-      CPSR_SetZ(registers->r[instr.fields.rd] == 0);
-      CPSR_SetC(shifter.shifter_carry_out);
-    }
-  }
+void CPU::Dispatch_EOR(U32 instr) noexcept {
+  DispatchDataProcessing<Instr::EOR>(instr);
 }
 
 void CPU::Dispatch_LDRB(U32 instr_, const Memory::Memory &memory) noexcept {
   const SingleDataTransferInstr instr{instr_};
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
+  if (ConditionPassed(ConditionCode(instr.fields.cond))) {
     U32 address = LoadAndStoreWordOrByteAddr(instr);
     MOV(registers, instr.fields.rd, LOAD_BYTE(memory, address));
   }
@@ -1192,7 +1759,7 @@ void CPU::Dispatch_LDRB(U32 instr_, const Memory::Memory &memory) noexcept {
 
 void CPU::Dispatch_LDRSB(U32 instr_, const Memory::Memory &memory) noexcept {
   const SingleDataTransferInstr instr{instr_};
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
+  if (ConditionPassed(ConditionCode(instr.fields.cond))) {
     U32 address = LoadAndStoreMiscAddr(instr);
     MOV(registers, instr.fields.rd, SignExtend(LOAD_BYTE(memory, address), 8));
   }
@@ -1200,7 +1767,7 @@ void CPU::Dispatch_LDRSB(U32 instr_, const Memory::Memory &memory) noexcept {
 
 void CPU::Dispatch_LDRH(U32 instr_, const Memory::Memory &memory) noexcept {
   const SingleDataTransferInstr instr{instr_};
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
+  if (ConditionPassed(ConditionCode(instr.fields.cond))) {
     U32 address = LoadAndStoreMiscAddr(instr);
     if ((address & 0b1) == 0) {
       MOV(registers, instr.fields.rd, LOAD_HALFWORD(memory, address));
@@ -1212,7 +1779,7 @@ void CPU::Dispatch_LDRH(U32 instr_, const Memory::Memory &memory) noexcept {
 
 void CPU::Dispatch_LDRSH(U32 instr_, const Memory::Memory &memory) noexcept {
   const SingleDataTransferInstr instr{instr_};
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
+  if (ConditionPassed(ConditionCode(instr.fields.cond))) {
     U32 address = LoadAndStoreMiscAddr(instr);
     if ((address & 0b1) == 0) {
       MOV(registers, instr.fields.rd,
@@ -1225,7 +1792,7 @@ void CPU::Dispatch_LDRSH(U32 instr_, const Memory::Memory &memory) noexcept {
 
 void CPU::Dispatch_LDR(U32 instr_, const Memory::Memory &memory) noexcept {
   const SingleDataTransferInstr instr{instr_};
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
+  if (ConditionPassed(ConditionCode(instr.fields.cond))) {
 
     U32 address;
     if (instr.fields.i == 0) {
@@ -1260,78 +1827,52 @@ void CPU::Dispatch_LDR(U32 instr_, const Memory::Memory &memory) noexcept {
 
 void CPU::Dispatch_STR(U32 instr_, Memory::Memory &memory) noexcept {
   const SingleDataTransferInstr instr{instr_};
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
+  if (ConditionPassed(ConditionCode(instr.fields.cond))) {
     U32 address;
     if (instr.fields.i == 0) {
       address = LoadAndStoreWordOrByteImmAddr(instr_);
     } else {
       address = LoadAndStoreWordOrByteRegAddr(instr_);
     }
-    STORE_WORD(memory, address, registers->r[instr.fields.rd]);
+    STORE_WORD(memory, address, registers.r[instr.fields.rd]);
   }
 }
 
 void CPU::Dispatch_STRB(U32 instr_, Memory::Memory &memory) noexcept {
   const SingleDataTransferInstr instr{instr_};
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
+  if (ConditionPassed(ConditionCode(instr.fields.cond))) {
     U32 address = LoadAndStoreWordOrByteAddr(instr_);
-    STORE_BYTE(memory, address, U8(registers->r[instr.fields.rd]));
+    STORE_BYTE(memory, address, U8(registers.r[instr.fields.rd]));
   }
 }
 
 void CPU::Dispatch_STRH(U32 instr_, Memory::Memory &memory) noexcept {
   const SingleDataTransferInstr instr{instr_};
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
+  if (ConditionPassed(ConditionCode(instr.fields.cond))) {
     U32 address = LoadAndStoreMiscAddr(instr);
     if ((address & 0b1) == 0) {
-      STORE_HALFWORD(memory, address, U16(registers->r[instr.fields.rd]));
+      STORE_HALFWORD(memory, address, U16(registers.r[instr.fields.rd]));
     } else {
       ABORT("Bad address: 0x%04X", address);
     }
   }
 }
 
-void CPU::Dispatch_CMP(U32 instr_) noexcept {
-  const DataProcessingInstr instr(instr_);
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
-    ShifterOperandResult shifter = ShifterOperand(instr);
-    U32 alu_out = registers->r[instr.fields.rn] - shifter.shifter_operand;
-    CPSR_SetN(GetBit(alu_out, 31));
-    CPSR_SetZ(alu_out == 0);
-    CPSR_SetC(!UnsignedSubBorrow(registers->r[instr.fields.rn],
-                                 shifter.shifter_operand));
-    CPSR_SetV(SignedSubOverflow(registers->r[instr.fields.rn],
-                                shifter.shifter_operand));
-  }
+void CPU::Dispatch_CMP(U32 instr) noexcept {
+  DispatchDataProcessing<Instr::CMP>(instr);
 }
 
-void CPU::Dispatch_TEQ(U32 instr_) noexcept {
-  const DataProcessingInstr instr(instr_);
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
-    ShifterOperandResult shifter = ShifterOperand(instr);
-    U32 alu_out = registers->r[instr.fields.rn] ^ shifter.shifter_operand;
-
-    CPSR_SetN(GetBit(alu_out, 31));
-    CPSR_SetZ(alu_out == 0);
-    CPSR_SetC(shifter.shifter_carry_out);
-  }
+void CPU::Dispatch_TEQ(U32 instr) noexcept {
+  DispatchDataProcessing<Instr::TEQ>(instr);
 }
 
-void CPU::Dispatch_TST(U32 instr_) noexcept {
-  const DataProcessingInstr instr(instr_);
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
-    ShifterOperandResult shifter = ShifterOperand(instr);
-    U32 alu_out = registers->r[instr.fields.rn] & shifter.shifter_operand;
-
-    CPSR_SetN(GetBit(alu_out, 31));
-    CPSR_SetZ(alu_out == 0);
-    CPSR_SetC(shifter.shifter_carry_out);
-  }
+void CPU::Dispatch_TST(U32 instr) noexcept {
+  DispatchDataProcessing<Instr::TST>(instr);
 }
 
 void CPU::Dispatch_STM(U32 instr_, Memory::Memory &memory) noexcept {
   LoadAndStoreMultiple instr(instr_);
-  if (!EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
+  if (!ConditionPassed(ConditionCode(instr.fields.cond))) {
     return;
   }
 
@@ -1339,7 +1880,7 @@ void CPU::Dispatch_STM(U32 instr_, Memory::Memory &memory) noexcept {
   U32 address = addr.start_addr;
   for (U32 i = 0; i < 16; ++i) {
     // If s == 0, then STM1, else STM2.
-    U32 val = instr.fields.s == 1 ? user_registers.r[i] : registers->r[i];
+    U32 val = instr.fields.s == 1 ? UserRegister(i) : registers.r[i];
     if (GetBit(instr.fields.register_list, i) == 1) {
       STORE_WORD(memory, address, val);
       address += 4;
@@ -1351,7 +1892,7 @@ void CPU::Dispatch_STM(U32 instr_, Memory::Memory &memory) noexcept {
 void CPU::Dispatch_LDM(U32 instr_, const Memory::Memory &memory) noexcept {
   LoadAndStoreMultiple instr(instr_);
   // LDM1
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
+  if (ConditionPassed(ConditionCode(instr.fields.cond))) {
     if (instr.fields.s == 0) {
       LoadAndStoreMultipleAddrResult addr = LoadAndStoreMultipleAddr(instr_);
       U32 address = addr.start_addr;
@@ -1374,7 +1915,9 @@ void CPU::Dispatch_LDM(U32 instr_, const Memory::Memory &memory) noexcept {
         U32 address = addr.start_addr;
         for (U32 i = 0; i < 15; ++i) {
           if (GetBit(instr.fields.register_list, i) == 1) {
-            MOV((&user_registers), i, LOAD_WORD(memory, address));
+            U32 value = LOAD_WORD(memory, address);
+            Emulator::DispatchLogger::LOG_MOV(i, value);
+            UserRegister(i) = value;
             address += 4;
           }
         }
@@ -1390,10 +1933,12 @@ void CPU::Dispatch_LDM(U32 instr_, const Memory::Memory &memory) noexcept {
             address += 4;
           }
         }
-        registers->CPSR = U32(registers->SPRS);
+        SyncFlags();
+        registers.CPSR = U32(registers.SPRS);
+        ChangeRegistersOnMode();
         U32 value = LOAD_WORD(memory, address);
 
-        CPSR_Register cpsr(registers->CPSR);
+        CPSR_Register cpsr(registers.CPSR);
         if (cpsr.bits.T == 1) {
           MOV(registers, PC, value & 0xFFFFFFFE);
         } else {
@@ -1408,108 +1953,49 @@ void CPU::Dispatch_LDM(U32 instr_, const Memory::Memory &memory) noexcept {
   }
 }
 
-void CPU::Dispatch_CMN(U32 instr_) noexcept {
-  DataProcessingInstr instr(instr_);
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
-    ShifterOperandResult shifter = ShifterOperand(instr);
-    U32 alu_out = registers->r[instr.fields.rn] + shifter.shifter_operand;
-
-    CPSR_SetN(GetBit(alu_out, 31));
-    CPSR_SetZ(alu_out == 0);
-    CPSR_SetC(UnsignedAddCarry(registers->r[instr.fields.rn],
-                               shifter.shifter_operand));
-    CPSR_SetV(SignedAddOverflow(registers->r[instr.fields.rn],
-                                shifter.shifter_operand));
-  }
+void CPU::Dispatch_CMN(U32 instr) noexcept {
+  DispatchDataProcessing<Instr::CMN>(instr);
 }
 
-void CPU::Dispatch_SUB(U32 instr_) noexcept {
-  DataProcessingInstr instr(instr_);
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
-    ShifterOperandResult shifter = ShifterOperand(instr);
-    MOV(registers, instr.fields.rd,
-        registers->r[instr.fields.rn] - shifter.shifter_operand);
-    if (instr.fields.s == 1 && instr.fields.rd == PC) {
-      registers->CPSR = U32(registers->SPRS);
-    } else if (instr.fields.s == 1) {
-      CPSR_SetN(GetBit(registers->r[instr.fields.rd], 31));
-      CPSR_SetZ(registers->r[instr.fields.rd] == 0);
-      CPSR_SetC(!UnsignedSubBorrow(registers->r[instr.fields.rn],
-                                   shifter.shifter_operand));
-      CPSR_SetV(SignedSubOverflow(registers->r[instr.fields.rn],
-                                  shifter.shifter_operand));
-    }
-  }
+void CPU::Dispatch_SUB(U32 instr) noexcept {
+  DispatchDataProcessing<Instr::SUB>(instr);
 }
 
-void CPU::Dispatch_RSB(U32 instr_) noexcept {
-  DataProcessingInstr instr(instr_);
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
-    ShifterOperandResult shifter = ShifterOperand(instr);
-    MOV(registers, instr.fields.rd,
-        shifter.shifter_operand - registers->r[instr.fields.rn]);
-    if (instr.fields.s == 1 && instr.fields.rd == PC) {
-      registers->CPSR = U32(registers->SPRS);
-    } else if (instr.fields.s == 1) {
-      CPSR_SetN(GetBit(registers->r[instr.fields.rd], 31));
-      CPSR_SetZ(registers->r[instr.fields.rd] == 0);
-      CPSR_SetC(!UnsignedSubBorrow(shifter.shifter_operand,
-                                   registers->r[instr.fields.rn]));
-      CPSR_SetV(SignedSubOverflow(shifter.shifter_operand,
-                                  registers->r[instr.fields.rn]));
-    }
-  }
+void CPU::Dispatch_RSB(U32 instr) noexcept {
+  DispatchDataProcessing<Instr::RSB>(instr);
 }
 
-void CPU::Dispatch_ADD(U32 instr_) noexcept {
-  DataProcessingInstr instr(instr_);
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
-    ShifterOperandResult shifter = ShifterOperand(instr);
-    MOV(registers, instr.fields.rd,
-        registers->r[instr.fields.rn] + shifter.shifter_operand);
-
-    if (instr.fields.s == 1 && instr.fields.rd == PC) {
-      registers->CPSR = U32(registers->SPRS);
-    } else if (instr.fields.s == 1) {
-
-      CPSR_SetN(GetBit(registers->r[instr.fields.rd], 31));
-      CPSR_SetZ(registers->r[instr.fields.rd] == 0);
-      CPSR_SetC(UnsignedAddCarry(registers->r[instr.fields.rn],
-                                 shifter.shifter_operand));
-      CPSR_SetV(SignedAddOverflow(registers->r[instr.fields.rn],
-                                  shifter.shifter_operand));
-    }
-  }
+void CPU::Dispatch_ADD(U32 instr) noexcept {
+  DispatchDataProcessing<Instr::ADD>(instr);
 }
 
 void CPU::Dispatch_MUL(U32 instr_) noexcept {
   MULInstr instr(instr_);
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
+  if (ConditionPassed(ConditionCode(instr.fields.cond))) {
     if (instr.fields.rd == PC) {
       ABORT("Cannot rd to R15");
     }
     MOV(registers, instr.fields.rd,
-        registers->r[instr.fields.rm] * registers->r[instr.fields.rs]);
+        registers.r[instr.fields.rm] * registers.r[instr.fields.rs]);
 
     if (instr.fields.s == 1) {
-      CPSR_SetN(GetBit(registers->r[instr.fields.rd], 31));
-      CPSR_SetZ(registers->r[instr.fields.rd] == 0);
+      SetNZ(registers.r[instr.fields.rd]);
     }
   }
 }
 
 void CPU::Dispatch_UMULL(U32 instr_) noexcept {
   UMULLInstr instr(instr_);
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
+  if (ConditionPassed(ConditionCode(instr.fields.cond))) {
     U64 result =
-        U64(registers->r[instr.fields.rm]) * registers->r[instr.fields.rs];
+        U64(registers.r[instr.fields.rm]) * registers.r[instr.fields.rs];
     MOV(registers, instr.fields.rdhi, U32(result >> 32));
     MOV(registers, instr.fields.rdlo, U32(result));
 
     if (instr.fields.s == 1) {
-      CPSR_SetN(GetBit(registers->r[instr.fields.rdhi], 31));
-      CPSR_SetZ(registers->r[instr.fields.rdhi] == 0 &&
-                registers->r[instr.fields.rdlo] == 0);
+      CPSR_SetN(GetBit(registers.r[instr.fields.rdhi], 31));
+      CPSR_SetZ(registers.r[instr.fields.rdhi] == 0 &&
+                registers.r[instr.fields.rdlo] == 0);
     }
 
     if (instr.fields.rm == 15 || instr.fields.rs == 15 ||
@@ -1519,62 +2005,30 @@ void CPU::Dispatch_UMULL(U32 instr_) noexcept {
   }
 }
 
-void CPU::Dispatch_ADC(U32 instr_) noexcept {
-  DataProcessingInstr instr(instr_);
-  CPSR_Register cpsr(registers->CPSR);
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
-    ShifterOperandResult shifter = ShifterOperand(instr);
-    MOV(registers, instr.fields.rd,
-        registers->r[instr.fields.rn] + shifter.shifter_operand + cpsr.bits.C);
-
-    if (instr.fields.s == 1 && instr.fields.rd == PC) {
-      registers->CPSR = U32(registers->SPRS);
-    } else if (instr.fields.s == 1) {
-
-      CPSR_SetN(GetBit(registers->r[instr.fields.rd], 31));
-      CPSR_SetZ(registers->r[instr.fields.rd] == 0);
-      CPSR_SetC(UnsignedAddCarry3(registers->r[instr.fields.rn],
-                                  shifter.shifter_operand, cpsr.bits.C));
-      CPSR_SetV(SignedAddOverflow3(registers->r[instr.fields.rn],
-                                   shifter.shifter_operand, cpsr.bits.C));
-    }
-  }
+void CPU::Dispatch_ADC(U32 instr) noexcept {
+  DispatchDataProcessing<Instr::ADC>(instr);
 }
 
-void CPU::Dispatch_AND(U32 instr_) noexcept {
-  DataProcessingInstr instr(instr_);
-  if (EvaluateCondition(ConditionCode(instr.fields.cond), registers->CPSR)) {
-    ShifterOperandResult shifter = ShifterOperand(instr);
-    MOV(registers, instr.fields.rd,
-        registers->r[instr.fields.rn] & shifter.shifter_operand);
-    if (instr.fields.s == 1 && instr.fields.rd == PC) {
-      registers->CPSR = U32(registers->SPRS);
-    } else if (instr.fields.s == 1) {
-      CPSR_SetN(GetBit(registers->r[instr.fields.rd], 31));
-      CPSR_SetZ(registers->r[instr.fields.rd] == 0);
-      CPSR_SetC(shifter.shifter_carry_out);
-    }
-  }
+void CPU::Dispatch_AND(U32 instr) noexcept {
+  DispatchDataProcessing<Instr::AND>(instr);
 }
 
 void CPU::Dispatch_Thumb_MOV1(U16 instr) noexcept {
   U32 immed_8 = GetBitsInRange(instr, 0, 8);
   U32 rd = GetBitsInRange(instr, 8, 11);
 
-  registers->r[rd] = immed_8;
+  registers.r[rd] = immed_8;
 
-  CPSR_SetN(GetBit(registers->r[rd], 31));
-  CPSR_SetZ(registers->r[rd] == 0);
+  SetNZ(registers.r[rd]);
 }
 
 void CPU::Dispatch_Thumb_MOV2(U16 instr) noexcept {
   U32 rd = GetBitsInRange(instr, 0, 3);
   U32 rn = GetBitsInRange(instr, 3, 6);
 
-  registers->r[rd] = U32(registers->r[rn]);
+  registers.r[rd] = U32(registers.r[rn]);
 
-  CPSR_SetN(GetBit(registers->r[rd], 31));
-  CPSR_SetZ(registers->r[rd] == 0);
+  SetNZ(registers.r[rd]);
   CPSR_SetC(0);
   CPSR_SetV(0);
 }
@@ -1582,82 +2036,71 @@ void CPU::Dispatch_Thumb_MOV2(U16 instr) noexcept {
 void CPU::Dispatch_Thumb_MOV3(U16 instr) noexcept {
   U32 rd = ConcatBits(GetBit(instr, 7), GetBitsInRange(instr, 0, 3), 3);
   U32 rm = ConcatBits(GetBit(instr, 6), GetBitsInRange(instr, 3, 6), 3);
-  MOV(registers, rd, U32(registers->r[rm]));
+  MOV(registers, rd, U32(registers.r[rm]));
 }
 
 void CPU::Dispatch_Thumb_CMP1(U16 instr) noexcept {
   U32 immed_8 = GetBitsInRange(instr, 0, 8);
   U32 rn = GetBitsInRange(instr, 8, 11);
-  U32 alu_out = registers->r[rn] - immed_8;
+  U32 alu_out = registers.r[rn] - immed_8;
 
-  CPSR_SetN(GetBit(alu_out, 31));
-  CPSR_SetZ(alu_out == 0);
-  CPSR_SetC(!UnsignedSubBorrow(registers->r[rn], immed_8));
-  CPSR_SetV(SignedSubOverflow(registers->r[rn], immed_8));
+  SetNZ(alu_out);
+  SetCV(FlagOp::SUB, registers.r[rn], immed_8);
 }
 
 void CPU::Dispatch_Thumb_CMN(U16 instr) noexcept {
   U32 rn = GetBitsInRange(instr, 0, 3);
   U32 rm = GetBitsInRange(instr, 3, 6);
 
-  U32 alu_out = registers->r[rn] + registers->r[rm];
+  U32 alu_out = registers.r[rn] + registers.r[rm];
 
-  CPSR_SetN(GetBit(alu_out, 31));
-  CPSR_SetZ(alu_out == 0);
-  CPSR_SetC(UnsignedAddCarry(registers->r[rn], registers->r[rm]));
-  CPSR_SetV(SignedAddOverflow(registers->r[rn], registers->r[rm]));
+  SetNZ(alu_out);
+  SetCV(FlagOp::ADD, registers.r[rn], registers.r[rm]);
 }
 
 void CPU::Dispatch_Thumb_CMP2(U16 instr) noexcept {
   U32 rn = GetBitsInRange(instr, 0, 3);
   U32 rm = GetBitsInRange(instr, 3, 6);
-  U32 alu_out = U32(registers->r[rn]) - U32(registers->r[rm]);
+  U32 alu_out = U32(registers.r[rn]) - U32(registers.r[rm]);
 
-  CPSR_SetN(GetBit(alu_out, 31));
-  CPSR_SetZ(alu_out == 0);
-  CPSR_SetC(!UnsignedSubBorrow(registers->r[rn], registers->r[rm]));
-  CPSR_SetV(SignedSubOverflow(registers->r[rn], registers->r[rm]));
+  SetNZ(alu_out);
+  SetCV(FlagOp::SUB, registers.r[rn], registers.r[rm]);
 }
 
 void CPU::Dispatch_Thumb_CMP3(U16 instr) noexcept {
   U32 rn = ConcatBits(GetBit(instr, 7), GetBitsInRange(instr, 0, 3), 3);
   U32 rm = ConcatBits(GetBit(instr, 6), GetBitsInRange(instr, 3, 6), 3);
-  U32 alu_out = U32(registers->r[rn]) - U32(registers->r[rm]);
+  U32 alu_out = U32(registers.r[rn]) - U32(registers.r[rm]);
 
-  CPSR_SetN(GetBit(alu_out, 31));
-  CPSR_SetZ(alu_out == 0);
-  CPSR_SetC(!UnsignedSubBorrow(registers->r[rn], registers->r[rm]));
-  CPSR_SetV(SignedSubOverflow(registers->r[rn], registers->r[rm]));
+  SetNZ(alu_out);
+  SetCV(FlagOp::SUB, registers.r[rn], registers.r[rm]);
 }
 
 void CPU::Dispatch_Thumb_MVN(U16 instr) noexcept {
   U32 rd = GetBitsInRange(instr, 0, 3);
   U32 rm = GetBitsInRange(instr, 3, 6);
 
-  MOV(registers, rd, ~(U32(registers->r[rm])));
+  MOV(registers, rd, ~(U32(registers.r[rm])));
 
-  CPSR_SetN(GetBit(registers->r[rd], 31));
-  CPSR_SetZ(registers->r[rd] == 0);
+  SetNZ(registers.r[rd]);
 }
 
 void CPU::Dispatch_Thumb_ORR(U16 instr) noexcept {
   U32 rd = GetBitsInRange(instr, 0, 3);
   U32 rm = GetBitsInRange(instr, 3, 6);
 
-  MOV(registers, rd, registers->r[rd] | registers->r[rm]);
+  MOV(registers, rd, registers.r[rd] | registers.r[rm]);
 
-  CPSR_SetN(GetBit(registers->r[rd], 31));
-  CPSR_SetZ(registers->r[rd] == 0);
+  SetNZ(registers.r[rd]);
 }
 
 void CPU::Dispatch_Thumb_EOR(U16 instr) noexcept {
   U32 rd = GetBitsInRange(instr, 0, 3);
   U32 rm = GetBitsInRange(instr, 3, 6);
 
-  MOV(registers, rd, registers->r[rd] ^ registers->r[rm]);
+  MOV(registers, rd, registers.r[rd] ^ registers.r[rm]);
 
-  CPSR_SetN(GetBit(registers->r[rd], 31));
-  CPSR_SetZ(registers->r[rd] == 0);
+  SetNZ(registers.r[rd]);
 }
 
 void CPU::Dispatch_Thumb_ADD1(U16 instr) noexcept {
@@ -1665,33 +2108,28 @@ void CPU::Dispatch_Thumb_ADD1(U16 instr) noexcept {
   U32 rn = GetBitsInRange(instr, 3, 6);
   U32 rd = GetBitsInRange(instr, 0, 3);
 
-  MOV(registers, rd, registers->r[rn] + immed_3);
+  MOV(registers, rd, registers.r[rn] + immed_3);
 
-  CPSR_SetN(GetBit(registers->r[rd], 31));
-  CPSR_SetZ(registers->r[rd] == 0);
-  CPSR_SetC(UnsignedAddCarry(registers->r[rn], immed_3));
-  CPSR_SetV(SignedAddOverflow(registers->r[rn], immed_3));
+  SetNZ(registers.r[rd]);
+  SetCV(FlagOp::ADD, registers.r[rn], immed_3);
 }
 
 void CPU::Dispatch_Thumb_AND(U16 instr) noexcept {
   U32 rm = GetBitsInRange(instr, 3, 6);
   U32 rd = GetBitsInRange(instr, 0, 3);
-  MOV(registers, rd, registers->r[rm] & registers->r[rd]);
-  CPSR_SetN(GetBit(registers->r[rd], 31));
-  CPSR_SetZ(registers->r[rd] == 0);
+  MOV(registers, rd, registers.r[rm] & registers.r[rd]);
+  SetNZ(registers.r[rd]);
 }
 
 void CPU::Dispatch_Thumb_ADD2(U16 instr) noexcept {
   U32 immed_8 = GetBitsInRange(instr, 0, 8);
   U32 rd = GetBitsInRange(instr, 8, 11);
 
-  U32 original_rd = registers->r[rd];
+  U32 original_rd = registers.r[rd];
   MOV(registers, rd, original_rd + immed_8);
 
-  CPSR_SetN(GetBit(registers->r[rd], 31));
-  CPSR_SetZ(registers->r[rd] == 0);
-  CPSR_SetC(UnsignedAddCarry(original_rd, immed_8));
-  CPSR_SetV(SignedAddOverflow(original_rd, immed_8));
+  SetNZ(registers.r[rd]);
+  SetCV(FlagOp::ADD, original_rd, immed_8);
 }
 
 void CPU::Dispatch_Thumb_ADD3(U16 instr) noexcept {
@@ -1699,39 +2137,35 @@ void CPU::Dispatch_Thumb_ADD3(U16 instr) noexcept {
   U32 rn = GetBitsInRange(instr, 3, 6);
   U32 rm = GetBitsInRange(instr, 6, 9);
 
-  MOV(registers, rd, registers->r[rn] + registers->r[rm]);
+  MOV(registers, rd, registers.r[rn] + registers.r[rm]);
 
-  CPSR_SetN(GetBit(registers->r[rd], 31));
-  CPSR_SetZ(registers->r[rd] == 0);
-  CPSR_SetC(UnsignedAddCarry(registers->r[rn], registers->r[rm]));
-  CPSR_SetV(SignedAddOverflow(registers->r[rn], registers->r[rm]));
+  SetNZ(registers.r[rd]);
+  SetCV(FlagOp::ADD, registers.r[rn], registers.r[rm]);
 }
 
 void CPU::Dispatch_Thumb_ADD5(U16 instr) noexcept {
   U32 immed_8 = GetBitsInRange(instr, 0, 8);
   U32 rd = GetBitsInRange(instr, 8, 11);
-  MOV(registers, rd, (registers->r[PC] & 0xFFFFFFFC) + (immed_8 << 2));
+  MOV(registers, rd, (registers.r[PC] & 0xFFFFFFFC) + (immed_8 << 2));
 }
 
 void CPU::Dispatch_Thumb_ADD6(U16 instr) noexcept {
   U32 immed_8 = GetBitsInRange(instr, 0, 8);
   U32 rd = GetBitsInRange(instr, 8, 11);
-  MOV(registers, rd, registers->r[SP] + (immed_8 << 2));
+  MOV(registers, rd, registers.r[SP] + (immed_8 << 2));
 }
 
 void CPU::Dispatch_Thumb_ADD7(U16 instr) noexcept {
   U32 immed_7 = GetBitsInRange(instr, 0, 7);
-  MOV(registers, SP, registers->r[SP] + (immed_7 << 2));
+  MOV(registers, SP, registers.r[SP] + (immed_7 << 2));
 }
 
 void CPU::Dispatch_Thumb_NEG(U16 instr) noexcept {
   U32 rd = GetBitsInRange(instr, 0, 3);
   U32 rm = GetBitsInRange(instr, 3, 6);
-  MOV(registers, rd, 0 - registers->r[rm]);
-  CPSR_SetN(GetBit(registers->r[rd], 31));
-  CPSR_SetZ(registers->r[rd] == 0);
-  CPSR_SetC(!UnsignedSubBorrow(0, registers->r[rm]));
-  CPSR_SetV(SignedSubOverflow(0, registers->r[rm]));
+  MOV(registers, rd, 0 - registers.r[rm]);
+  SetNZ(registers.r[rd]);
+  SetCV(FlagOp::SUB, 0, registers.r[rm]);
 }
 
 void CPU::Dispatch_Thumb_LSL1(U16 instr) noexcept {
@@ -1740,35 +2174,33 @@ void CPU::Dispatch_Thumb_LSL1(U16 instr) noexcept {
   U32 rd = GetBitsInRange(instr, 0, 3);
 
   if (immed_5 == 0) {
-    MOV(registers, rd, U32(registers->r[rm]));
+    MOV(registers, rd, U32(registers.r[rm]));
   } else {
-    CPSR_SetC(GetBit(registers->r[rm], 32 - immed_5));
-    MOV(registers, rd, LogicalShiftLeft(registers->r[rm], immed_5));
+    CPSR_SetC(GetBit(registers.r[rm], 32 - immed_5));
+    MOV(registers, rd, LogicalShiftLeft(registers.r[rm], immed_5));
   }
 
-  CPSR_SetN(GetBit(registers->r[rd], 31));
-  CPSR_SetZ(registers->r[rd] == 0);
+  SetNZ(registers.r[rd]);
 }
 
 void CPU::Dispatch_Thumb_LSL2(U16 instr) noexcept {
   U32 rs = GetBitsInRange(instr, 3, 6);
   U32 rd = GetBitsInRange(instr, 0, 3);
 
-  U32 rs_byte = GetBitsInRange(registers->r[rs], 0, 8);
+  U32 rs_byte = GetBitsInRange(registers.r[rs], 0, 8);
   if (rs_byte == 0) {
   } else if (rs_byte < 32) {
-    CPSR_SetC(GetBit(registers->r[rd], 32 - rs_byte));
-    MOV(registers, rd, LogicalShiftLeft(registers->r[rd], rs_byte));
+    CPSR_SetC(GetBit(registers.r[rd], 32 - rs_byte));
+    MOV(registers, rd, LogicalShiftLeft(registers.r[rd], rs_byte));
   } else if (rs_byte == 32) {
-    CPSR_SetC(GetBit(registers->r[rd], 0));
+    CPSR_SetC(GetBit(registers.r[rd], 0));
     MOV(registers, rd, 0);
   } else {
     CPSR_SetC(0);
     MOV(registers, rd, 0);
   }
 
-  CPSR_SetN(GetBit(registers->r[rd], 31));
-  CPSR_SetZ(registers->r[rd] == 0);
+  SetNZ(registers.r[rd]);
 }
 
 void CPU::Dispatch_Thumb_LSR1(U16 instr) noexcept {
@@ -1777,52 +2209,49 @@ void CPU::Dispatch_Thumb_LSR1(U16 instr) noexcept {
   U32 immed_5 = GetBitsInRange(instr, 6, 11);
 
   if (immed_5 == 0) {
-    CPSR_SetC(GetBit(registers->r[rd], 31));
+    CPSR_SetC(GetBit(registers.r[rd], 31));
     MOV(registers, rd, 0);
   } else {
-    CPSR_SetC(GetBit(registers->r[rd], immed_5 - 1));
-    MOV(registers, rd, LogicalShiftRight(registers->r[rm], immed_5));
+    CPSR_SetC(GetBit(registers.r[rd], immed_5 - 1));
+    MOV(registers, rd, LogicalShiftRight(registers.r[rm], immed_5));
   }
-  CPSR_SetN(GetBit(registers->r[rd], 31));
-  CPSR_SetZ(registers->r[rd] == 0);
+  SetNZ(registers.r[rd]);
 }
 
 void CPU::Dispatch_Thumb_LSR2(U16 instr) noexcept {
   U32 rd = GetBitsInRange(instr, 0, 3);
   U32 rs = GetBitsInRange(instr, 3, 6);
 
-  U8 shift_value = U8(registers->r[rs]);
+  U8 shift_value = U8(registers.r[rs]);
 
   if (shift_value == 0) {
   } else if (shift_value < 32) {
-    CPSR_SetC(GetBit(registers->r[rd], shift_value - 1));
-    MOV(registers, rd, LogicalShiftRight(registers->r[rd], shift_value));
+    CPSR_SetC(GetBit(registers.r[rd], shift_value - 1));
+    MOV(registers, rd, LogicalShiftRight(registers.r[rd], shift_value));
   } else if (shift_value == 32) {
-    CPSR_SetC(GetBit(registers->r[rd], 31));
+    CPSR_SetC(GetBit(registers.r[rd], 31));
     MOV(registers, rd, 0);
   } else {
     CPSR_SetC(0);
     MOV(registers, rd, 0);
   }
-  CPSR_SetN(GetBit(registers->r[rd], 31));
-  CPSR_SetZ(registers->r[rd] == 0);
+  SetNZ(registers.r[rd]);
 }
 
 void CPU::Dispatch_Thumb_ROR(U16 instr) noexcept {
   U32 rd = GetBitsInRange(instr, 0, 3);
   U32 rs = GetBitsInRange(instr, 3, 6);
 
-  if (GetBitsInRange(registers->r[rs], 0, 8) == 0) {
-  } else if (GetBitsInRange(registers->r[rs], 0, 5) == 0) {
-    CPSR_SetC(GetBit(registers->r[rd], 31));
+  if (GetBitsInRange(registers.r[rs], 0, 8) == 0) {
+  } else if (GetBitsInRange(registers.r[rs], 0, 5) == 0) {
+    CPSR_SetC(GetBit(registers.r[rd], 31));
   } else {
     CPSR_SetC(
-        GetBit(registers->r[rd], GetBitsInRange(registers->r[rs], 0, 5) - 1));
+        GetBit(registers.r[rd], GetBitsInRange(registers.r[rs], 0, 5) - 1));
     MOV(registers, rd,
-        RotateRight(registers->r[rd], GetBitsInRange(registers->r[rs], 0, 5)));
+        RotateRight(registers.r[rd], GetBitsInRange(registers.r[rs], 0, 5)));
   }
-  CPSR_SetN(GetBit(registers->r[rd], 31));
-  CPSR_SetZ(registers->r[rd] == 0);
+  SetNZ(registers.r[rd]);
 }
 
 void CPU::Dispatch_Thumb_ASR1(U16 instr) noexcept {
@@ -1831,19 +2260,18 @@ void CPU::Dispatch_Thumb_ASR1(U16 instr) noexcept {
   U32 immed_5 = GetBitsInRange(instr, 6, 11);
 
   if (immed_5 == 0) {
-    CPSR_SetC(GetBit(registers->r[rm], 31));
-    if (GetBit(registers->r[rm], 31) == 0) {
+    CPSR_SetC(GetBit(registers.r[rm], 31));
+    if (GetBit(registers.r[rm], 31) == 0) {
       MOV(registers, rd, 0);
     } else {
       MOV(registers, rd, 0xFFFFFFFF);
     }
   } else {
-    CPSR_SetC(GetBit(registers->r[rd], immed_5 - 1));
-    MOV(registers, rd, ArithmeticShiftRight(registers->r[rm], immed_5));
+    CPSR_SetC(GetBit(registers.r[rd], immed_5 - 1));
+    MOV(registers, rd, ArithmeticShiftRight(registers.r[rm], immed_5));
   }
 
-  CPSR_SetN(GetBit(registers->r[rd], 31));
-  CPSR_SetZ(registers->r[rd] == 0);
+  SetNZ(registers.r[rd]);
 }
 
 void CPU::Dispatch_Thumb_SUB1(U16 instr) noexcept {
@@ -1851,25 +2279,21 @@ void CPU::Dispatch_Thumb_SUB1(U16 instr) noexcept {
   U32 rn = GetBitsInRange(instr, 3, 6);
   U32 immed_3 = GetBitsInRange(instr, 6, 9);
 
-  MOV(registers, rd, registers->r[rn] - immed_3);
+  MOV(registers, rd, registers.r[rn] - immed_3);
 
-  CPSR_SetN(GetBit(registers->r[rd], 31));
-  CPSR_SetZ(registers->r[rd] == 0);
-  CPSR_SetC(!UnsignedSubBorrow(registers->r[rn], immed_3));
-  CPSR_SetV(SignedSubOverflow(registers->r[rn], immed_3));
+  SetNZ(registers.r[rd]);
+  SetCV(FlagOp::SUB, registers.r[rn], immed_3);
 }
 
 void CPU::Dispatch_Thumb_SUB2(U16 instr) noexcept {
   U32 immed_8 = GetBitsInRange(instr, 0, 8);
   U32 rd = GetBitsInRange(instr, 8, 11);
 
-  U32 original_rd = registers->r[rd];
+  U32 original_rd = registers.r[rd];
   MOV(registers, rd, original_rd - immed_8);
 
-  CPSR_SetN(GetBit(registers->r[rd], 31));
-  CPSR_SetZ(registers->r[rd] == 0);
-  CPSR_SetC(!UnsignedSubBorrow(original_rd, immed_8));
-  CPSR_SetV(SignedSubOverflow(original_rd, immed_8));
+  SetNZ(registers.r[rd]);
+  SetCV(FlagOp::SUB, original_rd, immed_8);
 }
 
 void CPU::Dispatch_Thumb_SUB3(U16 instr) noexcept {
@@ -1877,55 +2301,50 @@ void CPU::Dispatch_Thumb_SUB3(U16 instr) noexcept {
   U32 rn = GetBitsInRange(instr, 3, 6);
   U32 rm = GetBitsInRange(instr, 6, 9);
 
-  MOV(registers, rd, U32(registers->r[rn]) - U32(registers->r[rm]));
+  MOV(registers, rd, U32(registers.r[rn]) - U32(registers.r[rm]));
 
-  CPSR_SetN(GetBit(registers->r[rd], 31));
-  CPSR_SetZ(registers->r[rd] == 0);
-  CPSR_SetC(!UnsignedSubBorrow(registers->r[rn], registers->r[rm]));
-  CPSR_SetV(SignedSubOverflow(registers->r[rn], registers->r[rm]));
+  SetNZ(registers.r[rd]);
+  SetCV(FlagOp::SUB, registers.r[rn], registers.r[rm]);
 }
 
 void CPU::Dispatch_Thumb_SUB4(U16 instr) noexcept {
   U32 immed_7 = GetBitsInRange(instr, 0, 7);
-  MOV(registers, SP, registers->r[SP] - (immed_7 << 2));
+  MOV(registers, SP, registers.r[SP] - (immed_7 << 2));
 }
 
 void CPU::Dispatch_Thumb_TST(U16 instr) noexcept {
   U32 rn = GetBitsInRange(instr, 0, 3);
   U32 rm = GetBitsInRange(instr, 3, 6);
-  U32 alu_out = registers->r[rn] & registers->r[rm];
-  CPSR_SetN(GetBit(alu_out, 31));
-  CPSR_SetZ(alu_out == 0);
+  U32 alu_out = registers.r[rn] & registers.r[rm];
+  SetNZ(alu_out);
 }
 
 void CPU::Dispatch_Thumb_MUL(U16 instr) noexcept {
   U32 rd = GetBitsInRange(instr, 0, 3);
   U32 rm = GetBitsInRange(instr, 3, 6);
-  MOV(registers, rd, registers->r[rd] * registers->r[rm]);
-  CPSR_SetN(GetBit(registers->r[rd], 31));
-  CPSR_SetZ(registers->r[rd] == 0);
+  MOV(registers, rd, registers.r[rd] * registers.r[rm]);
+  SetNZ(registers.r[rd]);
 }
 
 void CPU::Dispatch_Thumb_B1(U16 instr) noexcept {
   I32 immed_8 = SignExtend(GetBitsInRange(instr, 0, 8), 8);
   U32 cond = GetBitsInRange(instr, 8, 12);
 
-  if (EvaluateCondition(ConditionCode(cond), registers->CPSR)) {
-    MOV(registers, PC, registers->r[PC] + (immed_8 << 1));
+  if (ConditionPassed(ConditionCode(cond))) {
+    MOV(registers, PC, registers.r[PC] + (immed_8 << 1));
   }
 }
 
 void CPU::Dispatch_Thumb_B2(U16 instr) noexcept {
   U32 immed_11 = GetBitsInRange(instr, 0, 11);
-  MOV(registers, PC, registers->r[PC] + (SignExtend(immed_11, 11) << 1));
+  MOV(registers, PC, registers.r[PC] + (SignExtend(immed_11, 11) << 1));
 }
 
 void CPU::Dispatch_Thumb_BIC(U16 instr) noexcept {
   U32 rd = GetBitsInRange(instr, 0, 3);
   U32 rm = GetBitsInRange(instr, 3, 6);
-  MOV(registers, rd, registers->r[rd] & ~registers->r[rm]);
-  CPSR_SetN(GetBit(registers->r[rd], 31));
-  CPSR_SetZ(registers->r[rd] == 0);
+  MOV(registers, rd, registers.r[rd] & ~registers.r[rm]);
+  SetNZ(registers.r[rd]);
 }
 
 void CPU::Dispatch_Thumb_BL(U16 instr) noexcept {
@@ -1933,9 +2352,9 @@ void CPU::Dispatch_Thumb_BL(U16 instr) noexcept {
   U32 offset_11 = GetBitsInRange(instr, 0, 11);
 
   if (h == 0b10) {
-    MOV(registers, LR, registers->r[PC] + (SignExtend(offset_11, 11) << 12));
+    MOV(registers, LR, registers.r[PC] + (SignExtend(offset_11, 11) << 12));
   } else if (h == 0b11) {
-    MOV(registers, PC, registers->r[LR] + (offset_11 << 1));
+    MOV(registers, PC, registers.r[LR] + (offset_11 << 1));
     MOV(registers, LR, (pipeline.execute_addr + 2) | 0b1);
   } else {
     ABORT("Invalid BL instruction: 0x%04X", instr);
@@ -1944,8 +2363,8 @@ void CPU::Dispatch_Thumb_BL(U16 instr) noexcept {
 
 void CPU::Dispatch_Thumb_BX(U16 instr) noexcept {
   U32 rm = ConcatBits(GetBit(instr, 6), GetBitsInRange(instr, 3, 6), 3);
-  CPSR_SetT(GetBit(registers->r[rm], 0));
-  MOV(registers, PC, GetBitsInRange(registers->r[rm], 1, 32) << 1);
+  CPSR_SetT(GetBit(registers.r[rm], 0));
+  MOV(registers, PC, GetBitsInRange(registers.r[rm], 1, 32) << 1);
 }
 
 void CPU::Dispatch_Thumb_LDR1(U16 instr,
@@ -1953,7 +2372,7 @@ void CPU::Dispatch_Thumb_LDR1(U16 instr,
   U32 rd = GetBitsInRange(instr, 0, 3);
   U32 rn = GetBitsInRange(instr, 3, 6);
   U32 immed_5 = GetBitsInRange(instr, 6, 11);
-  U32 address = registers->r[rn] + (immed_5 * 4);
+  U32 address = registers.r[rn] + (immed_5 * 4);
   if (GetBitsInRange(address, 0, 2) == 0b00) {
     MOV(registers, rd, LOAD_WORD(memory, address));
   } else {
@@ -1966,7 +2385,7 @@ void CPU::Dispatch_Thumb_LDR2(U16 instr,
   U32 rd = GetBitsInRange(instr, 0, 3);
   U32 rn = GetBitsInRange(instr, 3, 6);
   U32 rm = GetBitsInRange(instr, 6, 9);
-  U32 address = registers->r[rn] + registers->r[rm];
+  U32 address = registers.r[rn] + registers.r[rm];
   if (GetBitsInRange(address, 0, 2) == 0b00) {
     MOV(registers, rd, LOAD_WORD(memory, address));
   } else {
@@ -1978,7 +2397,7 @@ void CPU::Dispatch_Thumb_LDR3(U16 instr,
                               const Memory::Memory &memory) noexcept {
   U32 immed_8 = GetBitsInRange(instr, 0, 8);
   U32 rd = GetBitsInRange(instr, 8, 11);
-  U32 address = (GetBitsInRange(registers->r[PC], 2, 32) << 2) + immed_8 * 4;
+  U32 address = (GetBitsInRange(registers.r[PC], 2, 32) << 2) + immed_8 * 4;
   MOV(registers, rd, LOAD_WORD(memory, address));
 }
 
@@ -1986,7 +2405,7 @@ void CPU::Dispatch_Thumb_LDR4(U16 instr,
                               const Memory::Memory &memory) noexcept {
   U32 rd = GetBitsInRange(instr, 8, 11);
   U32 immed_8 = GetBitsInRange(instr, 0, 8);
-  U32 address = registers->r[SP] + (immed_8 * 4);
+  U32 address = registers.r[SP] + (immed_8 * 4);
   if (GetBitsInRange(address, 0, 2) == 0b00) {
     MOV(registers, rd, LOAD_WORD(memory, address));
   } else {
@@ -1999,7 +2418,7 @@ void CPU::Dispatch_Thumb_LDRB1(U16 instr,
   U32 rd = GetBitsInRange(instr, 0, 3);
   U32 rn = GetBitsInRange(instr, 3, 6);
   U32 immed_5 = GetBitsInRange(instr, 6, 11);
-  U32 address = registers->r[rn] + immed_5;
+  U32 address = registers.r[rn] + immed_5;
 
   MOV(registers, rd, LOAD_BYTE(memory, address));
 }
@@ -2009,7 +2428,7 @@ void CPU::Dispatch_Thumb_LDRB2(U16 instr,
   U32 rd = GetBitsInRange(instr, 0, 3);
   U32 rn = GetBitsInRange(instr, 3, 6);
   U32 rm = GetBitsInRange(instr, 6, 9);
-  U32 address = registers->r[rn] + registers->r[rm];
+  U32 address = registers.r[rn] + registers.r[rm];
 
   MOV(registers, rd, LOAD_BYTE(memory, address));
 }
@@ -2019,7 +2438,7 @@ void CPU::Dispatch_Thumb_LDRSB(U16 instr,
   U32 rd = GetBitsInRange(instr, 0, 3);
   U32 rn = GetBitsInRange(instr, 3, 6);
   U32 rm = GetBitsInRange(instr, 6, 9);
-  U32 address = registers->r[rn] + registers->r[rm];
+  U32 address = registers.r[rn] + registers.r[rm];
 
   MOV(registers, rd, SignExtend(LOAD_BYTE(memory, address), 8));
 }
@@ -2029,7 +2448,7 @@ void CPU::Dispatch_Thumb_LDRH1(U16 instr,
   U32 immed_5 = GetBitsInRange(instr, 6, 11);
   U32 rn = GetBitsInRange(instr, 3, 6);
   U32 rd = GetBitsInRange(instr, 0, 3);
-  U32 address = registers->r[rn] + immed_5 * 2;
+  U32 address = registers.r[rn] + immed_5 * 2;
   U16 data;
   if ((address & 0b1) == 0) {
     data = LOAD_HALFWORD(memory, address);
@@ -2044,7 +2463,7 @@ void CPU::Dispatch_Thumb_LDRH2(U16 instr,
   U32 rm = GetBitsInRange(instr, 6, 9);
   U32 rn = GetBitsInRange(instr, 3, 6);
   U32 rd = GetBitsInRange(instr, 0, 3);
-  U32 address = registers->r[rn] + registers->r[rm];
+  U32 address = registers.r[rn] + registers.r[rm];
   U16 data;
   if ((address & 0b1) == 0) {
     data = LOAD_HALFWORD(memory, address);
@@ -2059,7 +2478,7 @@ void CPU::Dispatch_Thumb_LDRSH(U16 instr,
   U32 rd = GetBitsInRange(instr, 0, 3);
   U32 rn = GetBitsInRange(instr, 3, 6);
   U32 rm = GetBitsInRange(instr, 6, 9);
-  U32 address = registers->r[rn] + registers->r[rm];
+  U32 address = registers.r[rn] + registers.r[rm];
   U16 data;
   if ((address & 0b1) == 0) {
     data = LOAD_HALFWORD(memory, address);
@@ -2074,18 +2493,18 @@ void CPU::Dispatch_Thumb_LDMIA(U16 instr,
   U32 rn = GetBitsInRange(instr, 8, 11);
   U32 register_list = GetBitsInRange(instr, 0, 8);
 
-  U32 start_address = registers->r[rn];
-  U32 end_address = registers->r[rn] + (CountSetBits(register_list) * 4) - 4;
+  U32 start_address = registers.r[rn];
+  U32 end_address = registers.r[rn] + (CountSetBits(register_list) * 4) - 4;
   U32 address = start_address;
 
   for (U32 i = 0; i < 8; ++i) {
     if (GetBit(register_list, i) == 1) {
-      registers->r[i] = LOAD_WORD(memory, address);
+      registers.r[i] = LOAD_WORD(memory, address);
       address += 4;
     }
   }
   assert(end_address == address - 4);
-  MOV(registers, rn, registers->r[rn] + (CountSetBits(register_list) * 4));
+  MOV(registers, rn, registers.r[rn] + (CountSetBits(register_list) * 4));
 }
 
 void CPU::Dispatch_Thumb_PUSH(U16 instr, Memory::Memory &memory) noexcept {
@@ -2093,32 +2512,32 @@ void CPU::Dispatch_Thumb_PUSH(U16 instr, Memory::Memory &memory) noexcept {
   U32 include_lr = GetBit(instr, 8);
 
   U32 start_address =
-      registers->r[SP] - 4 * (include_lr + CountSetBits(register_list));
-  U32 end_address = registers->r[SP] - 4;
+      registers.r[SP] - 4 * (include_lr + CountSetBits(register_list));
+  U32 end_address = registers.r[SP] - 4;
   U32 address = start_address;
   for (U32 i = 0; i < 8; ++i) {
     if (GetBit(register_list, i) == 1) {
-      STORE_WORD(memory, address, registers->r[i]);
+      STORE_WORD(memory, address, registers.r[i]);
       address += 4;
     }
   }
   if (include_lr == 1) {
-    STORE_WORD(memory, address, registers->r[LR]);
+    STORE_WORD(memory, address, registers.r[LR]);
     address += 4;
   }
 
   assert(end_address == address - 4);
   MOV(registers, SP,
-      registers->r[SP] - 4 * (include_lr + CountSetBits(register_list)));
+      registers.r[SP] - 4 * (include_lr + CountSetBits(register_list)));
 }
 
 void CPU::Dispatch_Thumb_POP(U16 instr, const Memory::Memory &memory) noexcept {
   U32 register_list = GetBitsInRange(instr, 0, 8);
   U32 include_pc = GetBit(instr, 8);
 
-  U32 start_address = registers->r[SP];
+  U32 start_address = registers.r[SP];
   U32 end_address =
-      registers->r[SP] + 4 * (include_pc + CountSetBits(register_list));
+      registers.r[SP] + 4 * (include_pc + CountSetBits(register_list));
   U32 address = start_address;
   for (U32 i = 0; i < 8; ++i) {
     if (GetBit(register_list, i) == 1) {
@@ -2140,17 +2559,17 @@ void CPU::Dispatch_Thumb_STRB1(U16 instr, Memory::Memory &memory) noexcept {
   U32 immed_5 = GetBitsInRange(instr, 6, 11);
   U32 rn = GetBitsInRange(instr, 3, 6);
   U32 rd = GetBitsInRange(instr, 0, 3);
-  U32 address = registers->r[rn] + immed_5;
-  STORE_BYTE(memory, address, U8(registers->r[rd]));
+  U32 address = registers.r[rn] + immed_5;
+  STORE_BYTE(memory, address, U8(registers.r[rd]));
 }
 
 void CPU::Dispatch_Thumb_STR1(U16 instr, Memory::Memory &memory) noexcept {
   U32 rd = GetBitsInRange(instr, 0, 3);
   U32 rn = GetBitsInRange(instr, 3, 6);
   U32 immed_5 = GetBitsInRange(instr, 6, 11);
-  U32 address = registers->r[rn] + immed_5 * 4;
+  U32 address = registers.r[rn] + immed_5 * 4;
   if (GetBitsInRange(address, 0, 2) == 0b00) {
-    STORE_WORD(memory, address, registers->r[rd]);
+    STORE_WORD(memory, address, registers.r[rd]);
   } else {
     ABORT("Unpredictable");
   }
@@ -2160,9 +2579,9 @@ void CPU::Dispatch_Thumb_STR2(U16 instr, Memory::Memory &memory) noexcept {
   U32 rd = GetBitsInRange(instr, 0, 3);
   U32 rn = GetBitsInRange(instr, 3, 6);
   U32 rm = GetBitsInRange(instr, 6, 9);
-  U32 address = registers->r[rn] + registers->r[rm];
+  U32 address = registers.r[rn] + registers.r[rm];
   if (GetBitsInRange(address, 0, 2) == 0b00) {
-    STORE_WORD(memory, address, registers->r[rd]);
+    STORE_WORD(memory, address, registers.r[rd]);
   } else {
     ABORT("Unpredictable");
   }
@@ -2171,9 +2590,9 @@ void CPU::Dispatch_Thumb_STR2(U16 instr, Memory::Memory &memory) noexcept {
 void CPU::Dispatch_Thumb_STR3(U16 instr, Memory::Memory &memory) noexcept {
   U32 immed_8 = GetBitsInRange(instr, 0, 8);
   U32 rd = GetBitsInRange(instr, 8, 11);
-  U32 address = registers->r[SP] + (immed_8 * 4);
+  U32 address = registers.r[SP] + (immed_8 * 4);
   if (GetBitsInRange(address, 0, 2) == 0b00) {
-    STORE_WORD(memory, address, registers->r[rd]);
+    STORE_WORD(memory, address, registers.r[rd]);
   } else {
     ABORT("Unpredicatable: Bad address");
   }
@@ -2182,17 +2601,17 @@ void CPU::Dispatch_Thumb_STR3(U16 instr, Memory::Memory &memory) noexcept {
 void CPU::Dispatch_Thumb_STMIA(U16 instr, Memory::Memory &memory) noexcept {
   U32 register_list = GetBitsInRange(instr, 0, 8);
   U32 rn = GetBitsInRange(instr, 8, 11);
-  U32 start_address = registers->r[rn];
-  U32 end_address = registers->r[rn] + (CountSetBits(register_list) * 4) - 4;
+  U32 start_address = registers.r[rn];
+  U32 end_address = registers.r[rn] + (CountSetBits(register_list) * 4) - 4;
   U32 address = start_address;
   for (U32 i = 0; i < 8; ++i) {
     if (GetBit(register_list, i) == 1) {
-      STORE_WORD(memory, address, registers->r[i]);
+      STORE_WORD(memory, address, registers.r[i]);
       address += 4;
     }
   }
   assert(end_address == address - 4);
-  MOV(registers, rn, registers->r[rn] + (CountSetBits(register_list) * 4));
+  MOV(registers, rn, registers.r[rn] + (CountSetBits(register_list) * 4));
 }
 
 void CPU::Dispatch_Thumb_STRH1(U16 instr, Memory::Memory &memory) noexcept {
@@ -2200,9 +2619,9 @@ void CPU::Dispatch_Thumb_STRH1(U16 instr, Memory::Memory &memory) noexcept {
   U32 rn = GetBitsInRange(instr, 3, 6);
   U32 immed_5 = GetBitsInRange(instr, 6, 11);
 
-  U32 address = registers->r[rn] + (immed_5 * 2);
+  U32 address = registers.r[rn] + (immed_5 * 2);
   if ((address & 0b1) == 0) {
-    STORE_HALFWORD(memory, address, U16(registers->r[rd]));
+    STORE_HALFWORD(memory, address, U16(registers.r[rd]));
   } else {
     ABORT("Unpredicatable: Bad address 0x%04X", address);
   }
@@ -2213,9 +2632,9 @@ void CPU::Dispatch_Thumb_STRH2(U16 instr, Memory::Memory &memory) noexcept {
   U32 rn = GetBitsInRange(instr, 3, 6);
   U32 rm = GetBitsInRange(instr, 6, 9);
 
-  U32 address = registers->r[rn] + registers->r[rm];
+  U32 address = registers.r[rn] + registers.r[rm];
   if ((address & 0b1) == 0) {
-    STORE_HALFWORD(memory, address, U16(registers->r[rd]));
+    STORE_HALFWORD(memory, address, U16(registers.r[rd]));
   } else {
     ABORT("Unpredicatable: Bad address 0x%04X", address);
   }
@@ -2223,12 +2642,20 @@ void CPU::Dispatch_Thumb_STRH2(U16 instr, Memory::Memory &memory) noexcept {
 
 void CPU::reset() noexcept {
   // On reset, start at SVC mode
-  registers = &supervisor_registers;
-  registers->CPSR = 0b10011;
+  SwitchRegisters(Mode::SUPERVISOR);
+  flags = LazyFlags{};
+  registers.CPSR = 0b10011;
 
   // link register is undefined at bootup. Hardcode to random value for
   // determinism.
   MOV(registers, 14, 9U);
+
+  pipeline_opcodes = PipelineOpcodes{};
+  block_cache.Clear();
+  idle_loops.Clear();
+  idle = false;
+  cycles = 0;
+  next_access_addr = U32(-1);
 }
 
 } // namespace Emulator::Arm
@@ -3,10 +3,14 @@
 #include "arm7tdmi_constants.h"
 #include "arm_instructions.h"
 #include "bitutils.h"
+#include "block_cache.h"
+#include "idle_loop.h"
+#include "jit.h"
 #include "datatypes.h"
 #include "logger.h"
 #include "logging.h"
 #include "memory.h"
+#include <array>
 #include <cstdlib>
 
 namespace Emulator::Arm
@@ -82,10 +86,12 @@ struct AllRegisters {
   U32 CPSR;
 };
 
+/// The registers of the current mode. The banked registers of the other
+/// modes wait in AllRegisters until CPU::ChangeRegistersOnMode swaps them in.
 struct Registers {
-  U32Ref r[16];
-  U32Ref SPRS;
-  U32Ref CPSR;
+  U32 r[16];
+  U32 SPRS;
+  U32 CPSR;
 };
 
 struct Pipeline {
@@ -98,14 +104,124 @@ struct Pipeline {
   U32 execute_addr = U32(-1);
 };
 
+/// Opcodes of the instructions in Pipeline. kOpcodeNotDecoded if the
+/// instruction did not come through the block cache.
+struct PipelineOpcodes {
+  U16 fetch = kOpcodeNotDecoded;
+  U16 decode = kOpcodeNotDecoded;
+  U16 execute = kOpcodeNotDecoded;
+};
+
+/// Shifter operand kind of a data processing instruction. 0 is an immediate,
+/// otherwise 1 + bits 6-4 of the instruction.
+constexpr U32 kShifterOperandImmediate = 0;
+
+constexpr U32 kNumDataProcessingVariants = 2 * 2 * 9;
+
+/// Picks the Dispatch_DataProcessing instantiation for an instruction from
+/// the condition being AL, the S bit and the shifter operand kind.
+constexpr U32 DataProcessingVariant(U32 instr) {
+  U32 cond_al = (instr >> 28) == U32(ConditionCode::AL);
+  U32 s = (instr >> 20) & 1;
+  U32 operand =
+      ((instr >> 25) & 1) ? kShifterOperandImmediate : 1 + ((instr >> 4) & 0b111);
+  return (operand << 2) | (s << 1) | cond_al;
+}
+
+/// Operation whose operands decide the pending C and V flags.
+enum class FlagOp : U8 { NONE, ADD, ADC, SUB };
+
+/// Flags that have not been written back to CPSR yet. Flag setting
+/// instructions record their result and operands here and NZCV is only
+/// computed when something reads it. See CPU::SyncFlags.
+struct LazyFlags {
+  /// N and Z come from nz_result.
+  bool nz_pending = false;
+  /// C and V come from cv_lhs and cv_rhs (and cv_carry for ADC).
+  FlagOp cv_op = FlagOp::NONE;
+  U32 nz_result = 0;
+  U32 cv_lhs = 0;
+  U32 cv_rhs = 0;
+  U32 cv_carry = 0;
+};
+
+/// An instruction the caller already fetched for CPU::Step. It is only used if
+/// PC, the Thumb bit and the block cache generation still match.
+struct ExpectedFetch {
+  U32 addr;
+  U32 instr;
+  U16 opcode;
+  bool thumb;
+  U32 generation;
+};
+
+enum class ExecutionModel {
+  /// Three stage fetch/decode/execute. A branch costs two steps that only
+  /// fetch.
+  PIPELINE,
+  /// Fetch and execute in one step. PC reads as the address of the
+  /// instruction + 8 (+ 4 in Thumb) like it would with the pipeline, and
+  /// Pipeline only holds the execute stage and the addresses of the others.
+  /// Set before running from reset.
+  PC_OFFSET,
+};
+
+enum class StepResult {
+  /// An instruction returned false, stop running.
+  STOPPED,
+  /// The next fetch is at the next sequential address and the expected fetch,
+  /// if any, was used.
+  SEQUENTIAL,
+  /// Branch, exception or the expected fetch was stale.
+  NOT_SEQUENTIAL,
+};
+
 /* Based on ARM DDI 0100E */
 struct CPU {
 
   void reset() noexcept;
 
-  [[nodiscard]] bool AdvancePipeline(U32 instr, U32 addr) noexcept;
-
-  [[nodiscard]] bool Dispatch(Memory::Memory &memory) noexcept;
+  [[nodiscard]] bool AdvancePipeline(U32 instr, U32 addr,
+                                     U16 opcode = kOpcodeNotDecoded) noexcept;
+
+  /// Returns the cycles it took, or 0 once the CPU stopped.
+  [[nodiscard]] U32 Dispatch(Memory::Memory &memory) noexcept;
+
+  /// One fetch/execute step, what Dispatch does in the interpreter.
+  [[nodiscard]] StepResult Step(Memory::Memory &memory,
+                                const ExpectedFetch *expected) noexcept;
+  [[nodiscard]] StepResult StepPcOffset(Memory::Memory &memory,
+                                        const ExpectedFetch *expected) noexcept;
+  /// The halves of StepPcOffset around the instruction. PcOffsetFetch
+  /// fetches the instruction at PC, or returns nullptr if it took an IRQ
+  /// instead. PcOffsetRetire moves PC past the instruction at `addr` or
+  /// refills after a branch.
+  const DecodedInstr *PcOffsetFetch(Memory::Memory &memory,
+                                    const ExpectedFetch *expected,
+                                    DecodedInstr &storage,
+                                    bool &sequential) noexcept;
+  void PcOffsetRetire(Memory::Memory &memory, U32 addr, bool thumb,
+                      bool &sequential) noexcept;
+#ifdef THREADED_DISPATCH
+  /// Runs PC_OFFSET steps until the CPU is idle or an event is due. Every
+  /// handler fetches and decodes the next instruction and jumps straight to
+  /// its label.
+  void RunThreaded(Memory::Memory &memory) noexcept;
+#endif
+
+  /// Writes back lazy state so all_registers and pipeline can be saved.
+  void PrepareSnapshot(const Memory::Memory &memory) noexcept;
+
+  /// Adds the cycles of a bus access to `cycles`.
+  void CountAccess(const Memory::Memory &memory, U32 address,
+                   U32 size) noexcept;
+  /// I cycles of the instruction about to execute.
+  U32 InternalCycles(U32 instr, U16 opcode, bool thumb) const noexcept;
+
+  const DecodedInstr *FetchDecoded(Memory::Memory &memory, U32 addr,
+                                   bool thumb, const ExpectedFetch *expected,
+                                   DecodedInstr &storage,
+                                   bool &used_expected) noexcept;
 
   void Dispatch_B(U32 instr) noexcept;
   void Dispatch_BL(U32 instr) noexcept;
@@ -195,8 +311,17 @@ struct CPU {
   void Dispatch_Thumb_POP(U16 instr, const Memory::Memory &memory) noexcept;
 
   void EnterException_IRQ() noexcept;
+  void EnterException_UND() noexcept;
 
   ShifterOperandResult ShifterOperand(DataProcessingInstr instr) noexcept;
+  template <U32 kOperand>
+  ShifterOperandResult ShifterOperandFor(DataProcessingInstr instr) noexcept;
+
+  /// Runs the Dispatch_DataProcessing instantiation picked by
+  /// DataProcessingVariant.
+  template <Instr kOp> void DispatchDataProcessing(U32 instr) noexcept;
+  template <Instr kOp, U32 kVariant>
+  void Dispatch_DataProcessing(U32 instr) noexcept;
 
   ShifterOperandResult
   ShifterOperandImmediate(DataProcessingInstrImmediate operand_2) noexcept;
@@ -227,87 +352,46 @@ struct CPU {
   U32 LoadAndStoreMiscRegAddr(U32 instr_) noexcept;
   U32 LoadAndStoreMiscAddr(SingleDataTransferInstr instr) noexcept;
 
+  /// Runs the channels in Memory::Dma_Pending.
   void DMATransfer(Memory::Memory &memory) noexcept;
-  U8 DMATransfer_PREV_VCOUNT = 0;
+  /// Copies `count` units with one memcpy or fill when both ranges are plain
+  /// memory. Returns false if the transfer has to go unit by unit.
+  bool DMABulkTransfer(Memory::Memory &memory, U32 src_addr, U32 dst_addr,
+                       U32 count, U32 chunk_size, bool fixed_src) noexcept;
 
   LoadAndStoreMultipleAddrResult LoadAndStoreMultipleAddr(U32 instr_) noexcept;
 
   void ClearPipeline() noexcept;
 
+  /// Saved state. Only up to date for the registers not in `registers`,
+  /// PrepareSnapshot writes back the rest.
   AllRegisters all_registers;
-  Registers user_registers{
-      .r = {&all_registers.r[0], &all_registers.r[1], &all_registers.r[2],
-            &all_registers.r[3], &all_registers.r[4], &all_registers.r[5],
-            &all_registers.r[6], &all_registers.r[7], &all_registers.r[8],
-            &all_registers.r[9], &all_registers.r[10], &all_registers.r[11],
-            &all_registers.r[12], &all_registers.r[13], &all_registers.r[14],
-            &all_registers.r[15]},
-      .CPSR = &all_registers.CPSR,
-      .SPRS = nullptr};
-  Registers system_registers{
-      .r = {&all_registers.r[0], &all_registers.r[1], &all_registers.r[2],
-            &all_registers.r[3], &all_registers.r[4], &all_registers.r[5],
-            &all_registers.r[6], &all_registers.r[7], &all_registers.r[8],
-            &all_registers.r[9], &all_registers.r[10], &all_registers.r[11],
-            &all_registers.r[12], &all_registers.r[13], &all_registers.r[14],
-            &all_registers.r[15]},
-      .CPSR = &all_registers.CPSR,
-      .SPRS = nullptr};
-  Registers supervisor_registers{
-      .r = {&all_registers.r[0], &all_registers.r[1], &all_registers.r[2],
-            &all_registers.r[3], &all_registers.r[4], &all_registers.r[5],
-            &all_registers.r[6], &all_registers.r[7], &all_registers.r[8],
-            &all_registers.r[9], &all_registers.r[10], &all_registers.r[11],
-            &all_registers.r[12], &all_registers.r13_svc,
-            &all_registers.r14_svc, &all_registers.r[15]},
-      .CPSR = &all_registers.CPSR,
-      .SPRS = &all_registers.SPRS_svc};
-  Registers abort_registers{
-      .r = {&all_registers.r[0], &all_registers.r[1], &all_registers.r[2],
-            &all_registers.r[3], &all_registers.r[4], &all_registers.r[5],
-            &all_registers.r[6], &all_registers.r[7], &all_registers.r[8],
-            &all_registers.r[9], &all_registers.r[10], &all_registers.r[11],
-            &all_registers.r[12], &all_registers.r13_abt,
-            &all_registers.r14_abt, &all_registers.r[15]},
-      .CPSR = &all_registers.CPSR,
-      .SPRS = &all_registers.SPRS_abt};
-  Registers undefined_registers{
-      .r = {&all_registers.r[0], &all_registers.r[1], &all_registers.r[2],
-            &all_registers.r[3], &all_registers.r[4], &all_registers.r[5],
-            &all_registers.r[6], &all_registers.r[7], &all_registers.r[8],
-            &all_registers.r[9], &all_registers.r[10], &all_registers.r[11],
-            &all_registers.r[12], &all_registers.r13_und,
-            &all_registers.r14_und, &all_registers.r[15]},
-      .CPSR = &all_registers.CPSR,
-      .SPRS = &all_registers.SPRS_und};
-  Registers interrupt_registers{
-      .r = {&all_registers.r[0], &all_registers.r[1], &all_registers.r[2],
-            &all_registers.r[3], &all_registers.r[4], &all_registers.r[5],
-            &all_registers.r[6], &all_registers.r[7], &all_registers.r[8],
-            &all_registers.r[9], &all_registers.r[10], &all_registers.r[11],
-            &all_registers.r[12], &all_registers.r13_irq,
-            &all_registers.r14_irq, &all_registers.r[15]},
-      .CPSR = &all_registers.CPSR,
-      .SPRS = &all_registers.SPRS_irq};
-  Registers fast_interrupt_registers{
-      .r = {&all_registers.r[0], &all_registers.r[1], &all_registers.r[2],
-            &all_registers.r[3], &all_registers.r[4], &all_registers.r[5],
-            &all_registers.r[6], &all_registers.r[7], &all_registers.r8_fiq,
-            &all_registers.r9_fiq, &all_registers.r10_fiq,
-            &all_registers.r11_fiq, &all_registers.r12_fiq,
-            &all_registers.r13_fiq, &all_registers.r13_fiq,
-            &all_registers.r[15]},
-      .CPSR = &all_registers.CPSR,
-      .SPRS = &all_registers.SPRS_fiq};
-
-  Registers *registers;
+  Registers registers{};
+  /// Mode whose banked registers are in `registers`.
+  Mode registers_mode = Mode::SUPERVISOR;
+  LazyFlags flags;
   bool Branched;
+  ExecutionModel execution_model = ExecutionModel::PIPELINE;
   Pipeline pipeline;
+  PipelineOpcodes pipeline_opcodes;
+  BlockCache block_cache;
+  IdleLoopDetector idle_loops;
+  /// The last Step took the back edge of an idle loop.
+  bool idle = false;
+#ifdef ENABLE_JIT
+  Jit jit;
+  bool jit_enabled = true;
+#endif
 
   U32 dispatch_num = 0;
+  /// Cycles run since reset.
+  U64 cycles = 0;
+  /// Address right after the last bus access. The next access is
+  /// sequential if it is to this address.
+  U32 next_access_addr = U32(-1);
 
   inline Mode GetMode() {
-    CPSR_Register cpsr(registers->CPSR);
+    CPSR_Register cpsr(registers.CPSR);
     switch (cpsr.bits.M) {
     case 0b10000:
       return Mode::USER;
@@ -328,62 +412,144 @@ struct CPU {
     }
   }
 
+  /// Where `mode` keeps r8-r14 and its SPSR while it is not the current mode.
+  /// The SPSR slot is nullptr for modes without one.
+  std::array<U32 *, 8> BankedRegisters(Mode mode) noexcept;
+
+  /// Writes the current registers back to all_registers.
+  void SaveRegisters() noexcept;
+
+  /// Swaps the banked registers of registers_mode out and those of `mode` in.
+  void SwitchRegisters(Mode mode) noexcept;
+
+  /// Has to be called after every write to CPSR.M.
   inline void ChangeRegistersOnMode() {
-    switch (GetMode()) {
-    case Mode::USER:
-      registers = &user_registers;
-      break;
-    case Mode::FAST_INTERRUPT:
-      registers = &fast_interrupt_registers;
-      break;
-    case Mode::INTERRUPT:
-      registers = &interrupt_registers;
-      break;
-    case Mode::SUPERVISOR:
-      registers = &supervisor_registers;
-      break;
-    case Mode::ABORT:
-      registers = &abort_registers;
+    Mode mode = GetMode();
+    if (mode != registers_mode) {
+      SwitchRegisters(mode);
+    }
+  }
+
+  /// Where the User mode copy of r[i] currently is, for the LDM and STM forms
+  /// that transfer User mode registers.
+  inline U32 &UserRegister(U32 i) noexcept {
+    bool banked = registers_mode == Mode::FAST_INTERRUPT
+                      ? i >= 8 && i < 15
+                      : (i == 13 || i == 14) && registers_mode != Mode::USER &&
+                            registers_mode != Mode::SYSTEM;
+    return banked ? all_registers.r[i] : registers.r[i];
+  }
+
+  /// N and Z from result, written back on the next SyncFlags.
+  inline void SetNZ(U32 result) noexcept {
+    flags.nz_pending = true;
+    flags.nz_result = result;
+  }
+
+  /// C and V from lhs op rhs, written back on the next SyncFlags. SUB is
+  /// lhs - rhs.
+  inline void SetCV(FlagOp op, U32 lhs, U32 rhs, U32 carry = 0) noexcept {
+    flags.cv_op = op;
+    flags.cv_lhs = lhs;
+    flags.cv_rhs = rhs;
+    flags.cv_carry = carry;
+  }
+
+  inline void SyncNZ() noexcept {
+    if (!flags.nz_pending) {
+      return;
+    }
+    flags.nz_pending = false;
+    CPSR_Register cpsr;
+    cpsr.bits.N = BitUtils::GetBit(flags.nz_result, 31);
+    cpsr.bits.Z = flags.nz_result == 0;
+    CPSR_Register mask;
+    mask.bits.N = 1;
+    mask.bits.Z = 1;
+    registers.CPSR = BitUtils::SetBitsInMask(registers.CPSR, cpsr, mask);
+  }
+
+  inline void SyncCV() noexcept {
+    CPSR_Register cpsr;
+    switch (flags.cv_op) {
+    case FlagOp::NONE:
+      return;
+    case FlagOp::ADD:
+      cpsr.bits.C = BitUtils::UnsignedAddCarry(flags.cv_lhs, flags.cv_rhs);
+      cpsr.bits.V = BitUtils::SignedAddOverflow(flags.cv_lhs, flags.cv_rhs);
       break;
-    case Mode::UNDEFINED:
-      registers = &undefined_registers;
+    case FlagOp::ADC:
+      cpsr.bits.C = BitUtils::UnsignedAddCarry3(flags.cv_lhs, flags.cv_rhs,
+                                                flags.cv_carry);
+      cpsr.bits.V = BitUtils::SignedAddOverflow3(flags.cv_lhs, flags.cv_rhs,
+                                                 flags.cv_carry);
       break;
-    case Mode::SYSTEM:
-      registers = &system_registers;
+    case FlagOp::SUB:
+      cpsr.bits.C = !BitUtils::UnsignedSubBorrow(flags.cv_lhs, flags.cv_rhs);
+      cpsr.bits.V = BitUtils::SignedSubOverflow(flags.cv_lhs, flags.cv_rhs);
       break;
     }
+    flags.cv_op = FlagOp::NONE;
+    CPSR_Register mask;
+    mask.bits.C = 1;
+    mask.bits.V = 1;
+    registers.CPSR = BitUtils::SetBitsInMask(registers.CPSR, cpsr, mask);
+  }
+
+  /// Writes any pending flags back to CPSR. Anything outside the CPU that
+  /// reads CPSR has to call this first.
+  inline void SyncFlags() noexcept {
+    SyncNZ();
+    SyncCV();
+  }
+
+  inline U32 ReadCPSR() noexcept {
+    SyncFlags();
+    return registers.CPSR;
   }
 
+  inline bool CarryFlag() noexcept {
+    SyncCV();
+    return CPSR_Register(registers.CPSR).bits.C;
+  }
+
+  /// Conditions other than AL need the flags written back.
+  bool ConditionPassed(ConditionCode cond) noexcept;
+
   inline void CPSR_SetC(bool C) noexcept {
+    SyncCV();
     CPSR_Register cpsr;
     cpsr.bits.C = C;
     CPSR_Register mask;
     mask.bits.C = 1;
-    registers->CPSR = BitUtils::SetBitsInMask(registers->CPSR, cpsr, mask);
+    registers.CPSR = BitUtils::SetBitsInMask(registers.CPSR, cpsr, mask);
   }
 
   inline void CPSR_SetV(bool V) noexcept {
+    SyncCV();
     CPSR_Register cpsr;
     cpsr.bits.V = V;
     CPSR_Register mask;
     mask.bits.V = 1;
-    registers->CPSR = BitUtils::SetBitsInMask(registers->CPSR, cpsr, mask);
+    registers.CPSR = BitUtils::SetBitsInMask(registers.CPSR, cpsr, mask);
   }
 
   inline void CPSR_SetZ(bool Z) noexcept {
+    SyncNZ();
     CPSR_Register cpsr;
     cpsr.bits.Z = Z;
     CPSR_Register mask;
     mask.bits.Z = 1;
-    registers->CPSR = BitUtils::SetBitsInMask(registers->CPSR, cpsr, mask);
+    registers.CPSR = BitUtils::SetBitsInMask(registers.CPSR, cpsr, mask);
   }
 
   inline void CPSR_SetN(bool N) noexcept {
+    SyncNZ();
     CPSR_Register cpsr;
     cpsr.bits.N = N;
     CPSR_Register mask;
     mask.bits.N = 1;
-    registers->CPSR = BitUtils::SetBitsInMask(registers->CPSR, cpsr, mask);
+    registers.CPSR = BitUtils::SetBitsInMask(registers.CPSR, cpsr, mask);
   }
 
   inline void CPSR_SetI(bool I) noexcept {
@@ -391,7 +557,7 @@ struct CPU {
     cpsr.bits.I = I;
     CPSR_Register mask;
     mask.bits.I = 1;
-    registers->CPSR = BitUtils::SetBitsInMask(registers->CPSR, cpsr, mask);
+    registers.CPSR = BitUtils::SetBitsInMask(registers.CPSR, cpsr, mask);
   }
 
   inline void CPSR_SetT(bool T) noexcept {
@@ -399,7 +565,7 @@ struct CPU {
     cpsr.bits.T = T;
     CPSR_Register mask;
     mask.bits.T = 1;
-    registers->CPSR = BitUtils::SetBitsInMask(registers->CPSR, cpsr, mask);
+    registers.CPSR = BitUtils::SetBitsInMask(registers.CPSR, cpsr, mask);
   }
 
   inline void CPSR_SetM(U8 M) noexcept {
@@ -407,20 +573,20 @@ struct CPU {
     cpsr.bits.M = M;
     CPSR_Register mask;
     mask.bits.M = 0b11111;
-    registers->CPSR = BitUtils::SetBitsInMask(registers->CPSR, cpsr, mask);
+    registers.CPSR = BitUtils::SetBitsInMask(registers.CPSR, cpsr, mask);
   }
 
   inline void AssignRegister(U32 rd, U32 val) noexcept {
     Branched |= rd == PC;
-    registers->r[rd] = val;
+    registers.r[rd] = val;
   }
 
   inline void IncrementThumbPC() noexcept {
-    AssignRegister(PC, registers->r[PC] + 2);
+    AssignRegister(PC, registers.r[PC] + 2);
   }
 
   inline void IncrementPC() noexcept {
-    AssignRegister(PC, registers->r[PC] + 4);
+    AssignRegister(PC, registers.r[PC] + 4);
   }
 };
 
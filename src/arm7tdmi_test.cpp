@@ -0,0 +1,241 @@
+#include <cassert>
+#include <cstring>
+
+#include "arm7tdmi.h"
+#include "hardware_events.h"
+#include "memory.h"
+
+using namespace Emulator;
+
+namespace {
+
+Memory::Memory *NewMemory(const U32 *program, U32 size) {
+  Memory::Memory *memory = new Memory::Memory();
+  memcpy(memory->BIOS, program, size);
+  Memory::Reset(*memory);
+  Events::Reset(*memory, 0);
+  return memory;
+}
+
+/// Runs until a branch or exception to `target` flushed the pipeline.
+void RunUntilBranch(Arm::CPU &cpu, Memory::Memory &memory, U32 target) {
+  auto at_target = [&] {
+    return cpu.pipeline.execute_addr == U32(-1) &&
+           cpu.registers.r[Arm::PC] == target;
+  };
+  for (U32 i = 0; i < 1000 && !at_target(); ++i) {
+    bool ok = cpu.Dispatch(memory);
+    assert(ok);
+  }
+  assert(at_target());
+}
+
+// Sets r8-r14 in User mode, takes an IRQ, then moves on to FIQ and SVC with
+// MSR and sets their banks. SVC transfers the User registers with STM and
+// LDM ^ before going back to User mode.
+constexpr U32 kBankingProgram[] = {
+    0xEA00001C, // 00: b start
+    0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+    0xE3A0DC1D, // 18: mov r13, #0x1D00
+    0xE321F0D1, //     msr cpsr_c, #0xD1
+    0xE3A08B3E, //     mov r8, #0xF800
+    0xE3A09CF9, //     mov r9, #0xF900
+    0xE3A0ACFA, //     mov r10, #0xFA00
+    0xE3A0BCFB, //     mov r11, #0xFB00
+    0xE3A0CB3F, //     mov r12, #0xFC00
+    0xE3A0DCFD, //     mov r13, #0xFD00
+    0xE3A0ECFE, //     mov r14, #0xFE00
+    0xE36FF011, //     msr spsr_fsxc, #0x11
+    0xE321F0D3, //     msr cpsr_c, #0xD3
+    0xE3A0DC5D, //     mov r13, #0x5D00
+    0xE3A0EC5E, //     mov r14, #0x5E00
+    0xE36FF010, //     msr spsr_fsxc, #0x10
+    0xE3A00403, //     mov r0, #0x03000000
+    0xE8C07F00, //     stmia r0, {r8-r14}^
+    0xE5808020, //     str r8, [r0, #0x20]
+    0xE2801040, //     add r1, r0, #0x40
+    0xE3A02C2D, //     mov r2, #0x2D00
+    0xE3A03C2E, //     mov r3, #0x2E00
+    0xE881000C, //     stmia r1, {r2, r3}
+    0xE8D16000, //     ldmia r1, {r13, r14}^
+    0xE321F090, //     msr cpsr_c, #0x90
+    0xEAFFFFFE, // 74: b .
+    0xE321F010, // 78: start: msr cpsr_c, #0x10
+    0xE3A08B02, //     mov r8, #0x800
+    0xE3A09C09, //     mov r9, #0x900
+    0xE3A0AC0A, //     mov r10, #0xA00
+    0xE3A0BC0B, //     mov r11, #0xB00
+    0xE3A0CB03, //     mov r12, #0xC00
+    0xE3A0DC0D, //     mov r13, #0xD00
+    0xE3A0EC0E, //     mov r14, #0xE00
+    0xE3A00301, //     mov r0, #0x04000000
+    0xE2800C02, //     add r0, r0, #0x200
+    0xE3A01001, //     mov r1, #1
+    0xE1C010B0, //     strh r1, [r0]
+    0xEAFFFFFE, // a8: b .
+};
+
+void TestBanking() {
+  Memory::Memory *memory = NewMemory(kBankingProgram, sizeof(kBankingProgram));
+  // VBlank is requested and IME is set, the program enables it in IE.
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::IME, 1);
+  Memory::RequestInterrupt(*memory, Memory::kIrqVBlank);
+  Arm::CPU *cpu = new Arm::CPU();
+  cpu->reset();
+
+  // The IRQ is taken before the b . at 0xA8 runs.
+  RunUntilBranch(*cpu, *memory, 0x18);
+  assert(cpu->registers_mode == Arm::Mode::INTERRUPT);
+  assert(cpu->registers.r[13] == 0);
+  assert(cpu->registers.r[14] == 0xAC);
+  assert(cpu->registers.r[8] == 0x800);
+  assert(cpu->registers.SPRS == 0x10);
+
+  RunUntilBranch(*cpu, *memory, 0x74);
+  assert(cpu->registers_mode == Arm::Mode::USER);
+  assert(cpu->registers.CPSR == 0x90);
+  cpu->PrepareSnapshot(*memory);
+  const Arm::AllRegisters &all = cpu->all_registers;
+
+  // FIQ has its own r8-r14, the other modes share r8-r12 with User.
+  for (U32 i = 8; i <= 12; ++i) {
+    assert(all.r[i] == i << 8);
+  }
+  const U32 *fiq = &all.r8_fiq;
+  for (U32 i = 0; i < 7; ++i) {
+    assert(fiq[i] == (0xF8 + i) << 8);
+  }
+  assert(all.SPRS_fiq == 0x11);
+  assert(all.r13_irq == 0x1D00);
+  assert(all.r14_irq == 0xAC);
+  assert(all.SPRS_irq == 0x10);
+  assert(all.r13_svc == 0x5D00);
+  assert(all.r14_svc == 0x5E00);
+  assert(all.SPRS_svc == 0x10);
+
+  // STM ^ stored the User registers from SVC mode and LDM ^ loaded User r13
+  // and r14 without touching r13_svc and r14_svc.
+  for (U32 i = 0; i < 7; ++i) {
+    assert(Memory::ReadWordFromGBAMemory(*memory, 0x03000000 + 4 * i) ==
+           (8 + i) << 8);
+  }
+  assert(Memory::ReadWordFromGBAMemory(*memory, 0x03000020) == 0x800);
+  assert(all.r[13] == 0x2D00);
+  assert(all.r[14] == 0x2E00);
+
+  delete cpu;
+  delete memory;
+}
+
+// ARM then Thumb: PC relative LDR and ADD, BL, a taken branch and an IRQ in
+// each state. The IRQ handler clears IME, and each state sets it again.
+constexpr U32 kModelArmProgram[] = {
+    0xEA00000A, // 00: b start
+    0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+    0xE3A0C301, // 18: mov r12, #0x04000000
+    0xE28CCC02, //     add r12, r12, #0x200
+    0xE3A0B000, //     mov r11, #0
+    0xE1CCB0B8, //     strh r11, [r12, #8]
+    0xE28AA001, //     add r10, r10, #1
+    0xE25EF004, //     subs pc, lr, #4
+    0xE321F01F, // 30: start: msr cpsr_c, #0x1F
+    0xE59F0034, //     ldr r0, lit
+    0xE28F1008, //     add r1, pc, #8
+    0xEB000009, //     bl func
+    0xE3520003, //     cmp r2, #3
+    0x0A000000, //     beq taken
+    0xE3A030BA, //     mov r3, #0xBA
+    0xE3A04301, // 4c: taken: mov r4, #0x04000000
+    0xE2844C02, //     add r4, r4, #0x200
+    0xE3A05001, //     mov r5, #1
+    0xE1C450B0, //     strh r5, [r4]
+    0xE3A06006, //     mov r6, #6
+    0xE28F000D, //     add r0, pc, #13 (thumb + 1)
+    0xE12FFF10, //     bx r0
+    0xE3A02003, // 68: func: mov r2, #3
+    0xE1A0F00E, //     mov pc, lr
+    0x12345678, // 70: lit
+};
+
+constexpr U16 kModelThumbProgram[] = {
+    0x4807, // 74: thumb: ldr r0, t_lit
+    0xA107, //     add r1, pc, #28
+    0xF000, //     bl tfunc
+    0xF809, //
+    0x2A05, //     cmp r2, #5
+    0xD000, //     beq t_taken
+    0x23BA, //     mov r3, #0xBA
+    0x2501, // 82: t_taken: mov r5, #1
+    0x4C04, //     ldr r4, t_ime
+    0x8025, //     strh r5, [r4]
+    0x2607, //     mov r6, #7
+    0x46C0, // 8a: done: mov r8, r8
+    0xE7FE, //     b .
+    0x2205, // 8e: tfunc: mov r2, #5
+    0x4770, //     bx lr
+    0x46C0, //     mov r8, r8
+    0x4321, // 94: t_lit: .word 0x87654321
+    0x8765, //
+    0x0208, // 98: t_ime: .word 0x04000208
+    0x0400, //
+};
+
+constexpr U32 kModelDone = 0x8A;
+
+Arm::CPU *RunModel(Arm::ExecutionModel model, Memory::Memory *&memory) {
+  memory = NewMemory(kModelArmProgram, sizeof(kModelArmProgram));
+  memcpy(memory->BIOS + sizeof(kModelArmProgram), kModelThumbProgram,
+         sizeof(kModelThumbProgram));
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::IME, 1);
+  Memory::RequestInterrupt(*memory, Memory::kIrqVBlank);
+  Arm::CPU *cpu = new Arm::CPU();
+  cpu->reset();
+  cpu->execution_model = model;
+  for (U32 i = 0; i < 1000 && cpu->pipeline.execute_addr != kModelDone; ++i) {
+    bool ok = cpu->Dispatch(*memory);
+    assert(ok);
+  }
+  assert(cpu->pipeline.execute_addr == kModelDone);
+  cpu->PrepareSnapshot(*memory);
+  return cpu;
+}
+
+void TestExecutionModels() {
+  static_assert(sizeof(kModelArmProgram) == 0x74);
+  Memory::Memory *pipeline_memory;
+  Memory::Memory *pc_offset_memory;
+  Arm::CPU *pipeline = RunModel(Arm::ExecutionModel::PIPELINE, pipeline_memory);
+  Arm::CPU *pc_offset =
+      RunModel(Arm::ExecutionModel::PC_OFFSET, pc_offset_memory);
+
+  const Arm::AllRegisters &expected = pipeline->all_registers;
+  assert(expected.r[0] == 0x87654321);
+  assert(expected.r[1] == 0x94);
+  assert(expected.r[2] == 5);
+  assert(expected.r[3] == 0);
+  assert(expected.r[6] == 7);
+  assert(expected.r[10] == 2);
+
+  // Same state and cycles. r15 is the only difference: with the pipeline it
+  // is the address of the next fetch, two instructions ahead, with the PC
+  // offset model it is the next instruction.
+  Arm::AllRegisters actual = pc_offset->all_registers;
+  assert(expected.r[Arm::PC] == kModelDone + 3 * 2);
+  assert(actual.r[Arm::PC] == kModelDone + 2);
+  actual.r[Arm::PC] = expected.r[Arm::PC];
+  assert(memcmp(&expected, &actual, sizeof(actual)) == 0);
+  assert(pipeline->cycles == pc_offset->cycles);
+
+  delete pipeline;
+  delete pc_offset;
+  delete pipeline_memory;
+  delete pc_offset_memory;
+}
+
+} // namespace
+
+int main() {
+  TestBanking();
+  TestExecutionModels();
+  return 0;
+}
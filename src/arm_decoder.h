@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+
+#include "arm_extended_instructions.h"
+#include "arm_instructions.h"
+#include "datatypes.h"
+#include "logging.h"
+
+namespace Emulator::Arm {
+
+/// Bits of the instruction that index the decode table. Bits 27-20 and 7-4.
+constexpr U32 kArmDecodeIndexMask = 0x0FF000F0;
+
+constexpr U32 kArmDecodeTableSize = 4096;
+
+constexpr U32 ArmDecodeIndex(U32 instr) {
+  return ((instr >> 16) & 0xFF0) | ((instr >> 4) & 0xF);
+}
+
+/// Same decode as ProcessInstruction used to do by hand. Extended encodings are
+/// checked first, then the regular ones. Returns NUM_OPCODES if nothing
+/// matches.
+constexpr Instr ScanArmInstr(U32 instr) {
+  ExtendedInstr extended_opcode = GetExtendedArmOpcode(instr);
+  if (extended_opcode != ExtendedInstr::NONE) {
+    return ExtendedInstrToArmInstr[U32(extended_opcode)];
+  }
+  return ScanArmOpcode(instr);
+}
+
+enum class ArmDecodeMatch { NO, YES, MAYBE };
+
+/// Whether mask/encoding matches every instruction with the given table index.
+/// MAYBE means the answer depends on bits outside the index.
+constexpr ArmDecodeMatch MatchArmDecodeIndex(U32 index_bits, U32 mask,
+                                             U32 encoding) {
+  if ((encoding & ~mask) != 0) {
+    // Can never match.
+    return ArmDecodeMatch::NO;
+  }
+  U32 index_mask = mask & kArmDecodeIndexMask;
+  if ((index_bits & index_mask) != (encoding & index_mask)) {
+    return ArmDecodeMatch::NO;
+  }
+  if ((mask & ~kArmDecodeIndexMask) != 0) {
+    return ArmDecodeMatch::MAYBE;
+  }
+  return ArmDecodeMatch::YES;
+}
+
+/// Replays ScanArmInstr over a table index. NUM_OPCODES marks the indices that
+/// cannot be decoded from the index alone (or not at all) and need the scan.
+constexpr Instr DecodeArmDecodeIndex(U32 index) {
+  U32 index_bits = ((index & 0xFF0) << 16) | ((index & 0xF) << 4);
+
+  for (U32 i = 0; i < U32(ExtendedInstr::NUM_OPCODES); ++i) {
+    switch (MatchArmDecodeIndex(index_bits, ExtendedInstrMasks[i],
+                                ExtendedInstrEncodings[i])) {
+    case ArmDecodeMatch::NO:
+      continue;
+    case ArmDecodeMatch::YES:
+      return ExtendedInstrToArmInstr[i];
+    case ArmDecodeMatch::MAYBE:
+      return Instr::NUM_OPCODES;
+    }
+  }
+
+  for (U32 i = 0; i < U32(Instr::NUM_OPCODES); ++i) {
+    switch (MatchArmDecodeIndex(index_bits, InstrMasks[i], InstrEncodings[i])) {
+    case ArmDecodeMatch::NO:
+      continue;
+    case ArmDecodeMatch::YES:
+      return Instr(i);
+    case ArmDecodeMatch::MAYBE:
+      return Instr::NUM_OPCODES;
+    }
+  }
+  return Instr::NUM_OPCODES;
+}
+
+constexpr std::array<Instr, kArmDecodeTableSize> BuildArmDecodeTable() {
+  std::array<Instr, kArmDecodeTableSize> table{};
+  for (U32 index = 0; index < kArmDecodeTableSize; ++index) {
+    table[index] = DecodeArmDecodeIndex(index);
+  }
+  return table;
+}
+
+constexpr std::array<Instr, kArmDecodeTableSize> ArmDecodeTable =
+    BuildArmDecodeTable();
+
+/// Table driven replacement for ScanArmInstr. Falls back to the scan for the
+/// few indices (MSR/MRS/BX space) that depend on other bits. Returns
+/// NUM_OPCODES if nothing matches.
+inline Instr TryDecodeArmInstr(U32 instr) {
+  Instr opcode = ArmDecodeTable[ArmDecodeIndex(instr)];
+  if (opcode == Instr::NUM_OPCODES) {
+    opcode = ScanArmInstr(instr);
+  }
+  return opcode;
+}
+
+/// Build with VERIFY_DECODER to check every decode against the scan.
+inline Instr DecodeArmInstr(U32 instr) {
+  Instr opcode = TryDecodeArmInstr(instr);
+  if (opcode == Instr::NUM_OPCODES) {
+    ABORT("Could not find arm opcode for 0x%04X", instr);
+  }
+#ifdef VERIFY_DECODER
+  assert(opcode == ScanArmInstr(instr));
+#endif
+  return opcode;
+}
+
+} // namespace Emulator::Arm
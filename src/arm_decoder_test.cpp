@@ -0,0 +1,39 @@
+#include <cassert>
+
+#include "arm_decoder.h"
+
+using namespace Emulator::Arm;
+
+// Bits outside the decode index that some masks look at (rn, rd, rs, rm).
+constexpr U32 kOtherBitPatterns[] = {
+    0x00000000, 0x000FFF0F, 0x000F0000, 0x0000F000, 0x00000F00,
+    0x0000000F, 0x000F000F, 0x00080000, 0x000FF00E, 0x00055505,
+};
+
+int main() {
+  // Fixed encodings.
+  assert(DecodeArmInstr(0xE12FFF1E) == Instr::BX);   // bx lr
+  assert(DecodeArmInstr(0xEA000000) == Instr::B);    // b
+  assert(DecodeArmInstr(0xE3A00001) == Instr::MOV);  // mov r0, #1
+  assert(DecodeArmInstr(0xE0010392) == Instr::MUL);  // mul r1, r2, r3
+  assert(DecodeArmInstr(0xE5901000) == Instr::LDR);  // ldr r1, [r0]
+  assert(DecodeArmInstr(0xE10F0000) == Instr::MRS);  // mrs r0, cpsr
+  assert(DecodeArmInstr(0xE92D4000) == Instr::STM);  // push {lr}
+
+  // Every table entry must agree with the linear scan.
+  for (U32 index = 0; index < kArmDecodeTableSize; ++index) {
+    Instr table_opcode = ArmDecodeTable[index];
+    U32 index_bits = ((index & 0xFF0) << 16) | ((index & 0xF) << 4);
+    for (U32 cond = 0; cond < 15; ++cond) {
+      for (U32 other : kOtherBitPatterns) {
+        U32 instr = (cond << 28) | index_bits | other;
+        assert(ArmDecodeIndex(instr) == index);
+        if (table_opcode != Instr::NUM_OPCODES) {
+          assert(table_opcode == ScanArmInstr(instr));
+        }
+      }
+    }
+  }
+
+  return 0;
+}
@@ -189,7 +189,7 @@ static_assert(sizeof(ExtendedInstrEncodings) /
 static_assert(sizeof(ExtendedInstrMasks) / sizeof(ExtendedInstrMasks[0]) ==
               U32(ExtendedInstr::NUM_OPCODES));
 
-inline ExtendedInstr GetExtendedArmOpcode(U32 instr) {
+constexpr ExtendedInstr GetExtendedArmOpcode(U32 instr) {
   for (U32 i = 0; i < U32(ExtendedInstr::NUM_OPCODES); ++i) {
     if ((instr & ExtendedInstrMasks[i]) == ExtendedInstrEncodings[i]) {
       return ExtendedInstr(i);
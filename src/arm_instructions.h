@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+
 #include "datatypes.h"
 #include "logging.h"
 
@@ -387,6 +389,46 @@ inline const char *toString(ConditionCode cc) {
   }
 }
 
+/// Bit n of ConditionTable[cond] is whether cond passes when the NZCV nibble
+/// (CPSR bits 31-28) is n. NV never passes.
+constexpr std::array<U16, 16> BuildConditionTable() {
+  std::array<U16, 16> table{};
+  for (U32 nzcv = 0; nzcv < 16; ++nzcv) {
+    bool n = (nzcv >> 3) & 1;
+    bool z = (nzcv >> 2) & 1;
+    bool c = (nzcv >> 1) & 1;
+    bool v = nzcv & 1;
+    const bool passes[16] = {
+        z,                 // EQ
+        !z,                // NE
+        c,                 // CS
+        !c,                // CC
+        n,                 // MI
+        !n,                // PL
+        v,                 // VS
+        !v,                // VC
+        c && !z,           // HI
+        !c || z,           // LS
+        n == v,            // GE
+        n != v,            // LT
+        !z && n == v,      // GT
+        z || n != v,       // LE
+        true,              // AL
+        false,             // NV
+    };
+    for (U32 cond = 0; cond < 16; ++cond) {
+      table[cond] |= U16(passes[cond]) << nzcv;
+    }
+  }
+  return table;
+}
+
+constexpr std::array<U16, 16> ConditionTable = BuildConditionTable();
+
+constexpr bool EvaluateCondition(ConditionCode cond, U32 cpsr) {
+  return (ConditionTable[cond & 0xF] >> (cpsr >> 28)) & 1;
+}
+
 namespace InstrMask {
 constexpr U32 ADC = 0b0000'1101'1110'0000'0000'0000'0000'0000;
 constexpr U32 ADD = 0b0000'1101'1110'0000'0000'0000'0000'0000;
@@ -694,13 +736,22 @@ static_assert(sizeof(InstrEncodings) / sizeof(InstrEncodings[0]) ==
 static_assert(sizeof(InstrMasks) / sizeof(InstrMasks[0]) ==
               U32(Instr::NUM_OPCODES));
 
-inline Instr GetArmOpcode(U32 instr) {
+/// Linear scan over InstrMasks. Returns NUM_OPCODES if nothing matches.
+constexpr Instr ScanArmOpcode(U32 instr) {
   for (U32 i = 0; i < U32(Instr::NUM_OPCODES); ++i) {
     if ((instr & InstrMasks[i]) == InstrEncodings[i]) {
       return Instr(i);
     }
   }
-  ABORT("Could not find arm opcode for 0x%04X", instr);
+  return Instr::NUM_OPCODES;
+}
+
+inline Instr GetArmOpcode(U32 instr) {
+  Instr opcode = ScanArmOpcode(instr);
+  if (opcode == Instr::NUM_OPCODES) {
+    ABORT("Could not find arm opcode for 0x%04X", instr);
+  }
+  return opcode;
 }
 
 } // namespace Emulator::Arm
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include "block_cache.h"
+#include "arm_decoder.h"
+#include "thumb_instructions.h"
+
+namespace Emulator::Arm {
+
+namespace {
+
+constexpr U32 kMaxBlockInstrs = 64;
+
+bool EndsArmBlock(Instr opcode) {
+  switch (opcode) {
+  case Instr::B:
+  case Instr::BL:
+  case Instr::BX:
+  case Instr::LDM:
+  case Instr::SWI:
+  case Instr::NUM_OPCODES:
+  case Instr::BAD_CODE:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool EndsThumbBlock(Thumb::ThumbOpcode opcode) {
+  switch (opcode) {
+  case Thumb::B1:
+  case Thumb::B2:
+  case Thumb::BL:
+  case Thumb::BX:
+  case Thumb::POP:
+  case Thumb::SWI:
+  case Thumb::UNDEFINED:
+    return true;
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
+BlockCache::BlockCache() : pages_(kNumPages), page_used_(kNumPages, false) {}
+
+void BlockCache::Clear() {
+  for (U32 page : used_pages_) {
+    pages_[page].reset();
+    page_used_[page] = false;
+  }
+  used_pages_.clear();
+  current_block_ = nullptr;
+  ++generation_;
+}
+
+const DecodedInstr *BlockCache::FetchSlow(const Memory::Memory &memory,
+                                          U32 addr, bool thumb) {
+  current_block_ = Lookup(memory, addr, thumb);
+  return current_block_ != nullptr ? &current_block_->instrs[0] : nullptr;
+}
+
+Block *BlockCache::Lookup(const Memory::Memory &memory, U32 addr,
+                          bool thumb) {
+  U32 page = CodePage(addr);
+  if (page == kNoPage) {
+    return nullptr;
+  }
+
+  std::unique_ptr<PageBlocks> &page_blocks = pages_[page];
+  if (page_blocks == nullptr) {
+    page_blocks = std::make_unique<PageBlocks>();
+    if (!page_used_[page]) {
+      page_used_[page] = true;
+      used_pages_.push_back(page);
+    }
+  }
+  U32 page_offset = addr & (kPageSize - 1);
+  std::unique_ptr<Block> &slot = thumb ? page_blocks->thumb[page_offset / 2]
+                                       : page_blocks->arm[page_offset / 4];
+
+  // A mirror of the same physical page may have decoded this slot from a
+  // different guest address.
+  if (slot == nullptr || slot->start_addr != addr) {
+    if (slot.get() == current_block_) {
+      current_block_ = nullptr;
+    }
+    slot = std::make_unique<Block>(
+        Block{.start_addr = addr, .thumb = thumb, .instrs = {}});
+    Block &block = *slot;
+    U32 page_end = (addr & ~(kPageSize - 1)) + kPageSize;
+    U32 step = thumb ? 2 : 4;
+    for (U32 pc = addr; pc < page_end && block.instrs.size() < kMaxBlockInstrs;
+         pc += step) {
+      if (thumb) {
+        U16 instr = Memory::ReadHalfWordFromGBAMemory(memory, pc);
+        Thumb::ThumbOpcode opcode = Thumb::GetThumbOpcode(instr);
+        block.instrs.push_back({.instr = instr, .opcode = U16(opcode)});
+        if (EndsThumbBlock(opcode)) {
+          break;
+        }
+      } else {
+        U32 instr = Memory::ReadWordFromGBAMemory(memory, pc);
+        Instr opcode = TryDecodeArmInstr(instr);
+        block.instrs.push_back(
+            {.instr = instr,
+             .opcode = opcode == Instr::NUM_OPCODES ? kOpcodeNotDecoded
+                                                    : U16(opcode)});
+        if (EndsArmBlock(opcode)) {
+          break;
+        }
+      }
+    }
+  }
+
+  return slot.get();
+}
+
+void BlockCache::InvalidatePage(U32 page) {
+  pages_[page].reset();
+  current_block_ = nullptr;
+  ++generation_;
+}
+
+} // namespace Emulator::Arm
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "datatypes.h"
+#include "memory.h"
+
+namespace Emulator::Arm {
+
+/// Opcode value for instructions that could not be decoded ahead of time. The
+/// executor decodes them again, which ABORTs exactly like it used to.
+constexpr U16 kOpcodeNotDecoded = 0xFFFF;
+
+struct DecodedInstr {
+  U32 instr;
+  /// Arm::Instr or Thumb::ThumbOpcode depending on the block.
+  U16 opcode;
+};
+
+/// A run of pre-decoded instructions starting at `start_addr` and ending at
+/// the first branch or at the end of the page.
+struct Block {
+  U32 start_addr;
+  bool thumb;
+  std::vector<DecodedInstr> instrs;
+  /// Used by the JIT to find hot blocks.
+  U32 exec_count = 0;
+  void *jit_code = nullptr;
+};
+
+/// Caches decoded blocks keyed by (PC, Thumb bit) for the BIOS, WRAM and the
+/// game pak. Blocks never cross a 256 byte page, so each page keeps a direct
+/// mapped slot per instruction address and a write only drops one page.
+class BlockCache {
+public:
+  static constexpr U32 kPageShift = 8;
+  static constexpr U32 kPageSize = 1 << kPageShift;
+  static constexpr U32 kNoPage = U32(-1);
+
+  BlockCache();
+
+  /// Returns the decoded instruction at `addr`, or nullptr if the address is
+  /// not in a cached region.
+  inline const DecodedInstr *Fetch(const Memory::Memory &memory, U32 addr,
+                                   bool thumb) {
+    if (current_block_ != nullptr && current_block_->thumb == thumb) {
+      U32 step = thumb ? 2 : 4;
+      U32 idx = (addr - current_block_->start_addr) / step;
+      if (addr >= current_block_->start_addr &&
+          idx < current_block_->instrs.size() &&
+          current_block_->start_addr + idx * step == addr) {
+        return &current_block_->instrs[idx];
+      }
+    }
+    return FetchSlow(memory, addr, thumb);
+  }
+
+  /// Returns the block that starts at `addr`, decoding it if needed, or
+  /// nullptr if the address is not in a cached region.
+  Block *Lookup(const Memory::Memory &memory, U32 addr, bool thumb);
+
+  /// Bumped whenever blocks are dropped. Lets callers holding on to decoded
+  /// instructions check that they are still valid.
+  inline U32 generation() const { return generation_; }
+
+  /// Drops the blocks decoded from the pages written by a `size` byte store
+  /// to `addr`. Must be called for every write to guest memory.
+  inline void InvalidateWrite(U32 addr, U32 size) {
+    U32 first_page = CodePage(addr);
+    if (first_page != kNoPage && pages_[first_page] != nullptr) {
+      InvalidatePage(first_page);
+    }
+    U32 last_page = CodePage(addr + size - 1);
+    if (last_page != first_page && last_page != kNoPage &&
+        pages_[last_page] != nullptr) {
+      InvalidatePage(last_page);
+    }
+  }
+
+  /// InvalidateWrite for a store of any size, e.g. a DMA transfer. The range
+  /// must not wrap around a mirror.
+  inline void InvalidateRange(U32 addr, U32 size) {
+    U32 first_page = CodePage(addr);
+    if (first_page == kNoPage) {
+      return;
+    }
+    U32 last_page = CodePage(addr + size - 1);
+    for (U32 page = first_page; page <= last_page; ++page) {
+      if (pages_[page] != nullptr) {
+        InvalidatePage(page);
+      }
+    }
+  }
+
+  void Clear();
+
+  /// Page index of `addr` with mirrors folded, or kNoPage if the region is not
+  /// cached.
+  static inline U32 CodePage(U32 addr) {
+    switch (addr >> 24) {
+    case 0x00:
+      return addr < 0x00004000 ? (addr >> kPageShift) + kBiosPage : kNoPage;
+    case 0x02:
+      return addr < 0x02040000 ? ((addr & 0x3FFFF) >> kPageShift) + kEwramPage
+                               : kNoPage;
+    case 0x03:
+      return ((addr & 0x7FFF) >> kPageShift) + kIwramPage;
+    case 0x08:
+    case 0x09:
+    case 0x0A:
+    case 0x0B:
+    case 0x0C:
+    case 0x0D:
+      return ((addr - 0x08000000) >> kPageShift) + kGamePakPage;
+    default:
+      return kNoPage;
+    }
+  }
+
+private:
+  static constexpr U32 kBiosPage = 0;
+  static constexpr U32 kEwramPage = kBiosPage + (0x4000 >> kPageShift);
+  static constexpr U32 kIwramPage = kEwramPage + (0x40000 >> kPageShift);
+  static constexpr U32 kGamePakPage = kIwramPage + (0x8000 >> kPageShift);
+  static constexpr U32 kNumPages = kGamePakPage + (0x06000000 >> kPageShift);
+
+  /// Blocks decoded from one page. Slots are indexed by the offset of the
+  /// block's first instruction within the page.
+  struct PageBlocks {
+    std::array<std::unique_ptr<Block>, kPageSize / 4> arm;
+    std::array<std::unique_ptr<Block>, kPageSize / 2> thumb;
+  };
+
+  const DecodedInstr *FetchSlow(const Memory::Memory &memory, U32 addr,
+                                bool thumb);
+  void InvalidatePage(U32 page);
+
+  std::vector<std::unique_ptr<PageBlocks>> pages_;
+  /// Pages that have been decoded from since the last Clear.
+  std::vector<U32> used_pages_;
+  std::vector<bool> page_used_;
+  Block *current_block_ = nullptr;
+  U32 generation_ = 0;
+};
+
+} // namespace Emulator::Arm
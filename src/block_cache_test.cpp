@@ -0,0 +1,63 @@
+#include <cassert>
+
+#include "arm_instructions.h"
+#include "block_cache.h"
+#include "memory.h"
+#include "thumb_instructions.h"
+
+using namespace Emulator;
+using namespace Emulator::Arm;
+
+int main() {
+  Memory::Memory *memory = new Memory::Memory();
+  BlockCache cache;
+
+  // mov r0, #1; mov r1, #2; b .
+  Memory::WriteWordToGBAMemory(*memory, 0x03000000, 0xE3A00001);
+  Memory::WriteWordToGBAMemory(*memory, 0x03000004, 0xE3A01002);
+  Memory::WriteWordToGBAMemory(*memory, 0x03000008, 0xEAFFFFFE);
+
+  const DecodedInstr *decoded = cache.Fetch(*memory, 0x03000000, false);
+  assert(decoded->instr == 0xE3A00001);
+  assert(decoded->opcode == U16(Instr::MOV));
+  decoded = cache.Fetch(*memory, 0x03000008, false);
+  assert(decoded->opcode == U16(Instr::B));
+
+  // Overwriting the code drops the block.
+  Memory::WriteWordToGBAMemory(*memory, 0x03000004, 0xE2811001);
+  cache.InvalidateWrite(0x03000004, 4);
+  decoded = cache.Fetch(*memory, 0x03000004, false);
+  assert(decoded->instr == 0xE2811001);
+  assert(decoded->opcode == U16(Instr::ADD));
+
+  // Mirrors share the physical page but keep their own guest addresses.
+  decoded = cache.Fetch(*memory, 0x03008004, false);
+  assert(decoded->instr == 0xE2811001);
+  Memory::WriteWordToGBAMemory(*memory, 0x03008004, 0xE3A01002);
+  cache.InvalidateWrite(0x03008004, 4);
+  decoded = cache.Fetch(*memory, 0x03000004, false);
+  assert(decoded->opcode == U16(Instr::MOV));
+
+  // Large stores drop every page they cover.
+  Memory::WriteWordToGBAMemory(*memory, 0x03000204, 0xE3A01002);
+  cache.Fetch(*memory, 0x03000204, false);
+  Memory::WriteWordToGBAMemory(*memory, 0x03000004, 0xE2811001);
+  Memory::WriteWordToGBAMemory(*memory, 0x03000204, 0xE2811001);
+  cache.InvalidateRange(0x03000000, 0x208);
+  decoded = cache.Fetch(*memory, 0x03000004, false);
+  assert(decoded->opcode == U16(Instr::ADD));
+  decoded = cache.Fetch(*memory, 0x03000204, false);
+  assert(decoded->opcode == U16(Instr::ADD));
+
+  // Thumb blocks are cached separately from arm blocks at the same address.
+  decoded = cache.Fetch(*memory, 0x03000000, true);
+  assert(decoded->instr == 0x0001);
+  assert(decoded->opcode == U16(Thumb::LSL1));
+
+  // Uncached regions.
+  assert(cache.Fetch(*memory, 0x06000000, false) == nullptr);
+  assert(BlockCache::CodePage(0x04000000) == BlockCache::kNoPage);
+
+  delete memory;
+  return 0;
+}
@@ -0,0 +1,104 @@
+#include <cassert>
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+
+#include "arm_instructions.h"
+#include "datatypes.h"
+
+using namespace Emulator::Arm;
+
+namespace {
+
+constexpr U32 kNumInputs = 1 << 16;
+constexpr U32 kNumRounds = 2000;
+
+/// The switch EvaluateCondition used before the table, kept as the baseline.
+[[gnu::noinline]] bool EvaluateConditionSwitch(ConditionCode cond, U32 cpsr) {
+  bool n = (cpsr >> 31) & 1;
+  bool z = (cpsr >> 30) & 1;
+  bool c = (cpsr >> 29) & 1;
+  bool v = (cpsr >> 28) & 1;
+  switch (cond) {
+  case ConditionCode::EQ:
+    return z;
+  case ConditionCode::NE:
+    return !z;
+  case ConditionCode::CS:
+    return c;
+  case ConditionCode::CC:
+    return !c;
+  case ConditionCode::MI:
+    return n;
+  case ConditionCode::PL:
+    return !n;
+  case ConditionCode::VS:
+    return v;
+  case ConditionCode::VC:
+    return !v;
+  case ConditionCode::HI:
+    return c && !z;
+  case ConditionCode::LS:
+    return !c || z;
+  case ConditionCode::GE:
+    return n == v;
+  case ConditionCode::LT:
+    return n != v;
+  case ConditionCode::GT:
+    return !z && n == v;
+  case ConditionCode::LE:
+    return z || n != v;
+  case ConditionCode::AL:
+    return true;
+  }
+  return false;
+}
+
+[[gnu::noinline]] bool EvaluateConditionTable(ConditionCode cond, U32 cpsr) {
+  return EvaluateCondition(cond, cpsr);
+}
+
+template <typename Fn>
+double Run(const char *name, Fn fn, const std::vector<U32> &instrs,
+           const std::vector<U32> &cpsrs) {
+  U32 passed = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (U32 round = 0; round < kNumRounds; ++round) {
+    for (U32 i = 0; i < kNumInputs; ++i) {
+      passed += fn(ConditionCode(instrs[i] >> 28), cpsrs[i]);
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  double ns = std::chrono::duration<double, std::nano>(end - start).count() /
+              (double(kNumRounds) * kNumInputs);
+  printf("%-8s %6.3f ns/eval (passed %u)\n", name, ns, passed);
+  return ns;
+}
+
+} // namespace
+
+/// Compares the condition table against the switch. Conditions are mostly
+/// AL, like real ARM code, with the rest spread over EQ-LE.
+int main() {
+  for (U32 cond = 0; cond < 15; ++cond) {
+    for (U32 nzcv = 0; nzcv < 16; ++nzcv) {
+      assert(EvaluateCondition(ConditionCode(cond), nzcv << 28) ==
+             EvaluateConditionSwitch(ConditionCode(cond), nzcv << 28));
+    }
+  }
+
+  std::vector<U32> instrs(kNumInputs);
+  std::vector<U32> cpsrs(kNumInputs);
+  U32 seed = 0x12345678;
+  for (U32 i = 0; i < kNumInputs; ++i) {
+    seed = seed * 1664525 + 1013904223;
+    U32 cond = (seed >> 8) % 4 == 0 ? (seed >> 12) % 15 : U32(ConditionCode::AL);
+    instrs[i] = cond << 28;
+    cpsrs[i] = (seed & 0xF0000000) | 0x1F;
+  }
+
+  double switch_ns = Run("switch", EvaluateConditionSwitch, instrs, cpsrs);
+  double table_ns = Run("table", EvaluateConditionTable, instrs, cpsrs);
+  printf("speedup  %.2fx\n", switch_ns / table_ns);
+  return 0;
+}
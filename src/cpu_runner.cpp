@@ -1,14 +1,21 @@
 #include "include/cpu_runner.h"
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <memory>
 #include <stdio.h>
 #include <stdlib.h>
-#include <thread>
+#include <string.h>
 
 #include "arm7tdmi.h"
+#include "game_pak.h"
+#include "hardware_events.h"
+#include "input_script.h"
 #include "logging.h"
 #include "memory.h"
+#include "memory_allocator.h"
+#include "snapshot.h"
 
 namespace CpuRunner {
 
@@ -45,19 +52,59 @@ using namespace Emulator;
 
 bool CpuRunner::Init(int argc, char *argv[]) {
   LOG("Initializing CpuRunner");
-  if (argc != 3) {
-    std::cerr << "Usage: " << argv[0] << " <name>" << std::endl;
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0]
+              << " <bios> <game> [--interpreter] [--no-idle-skip]"
+              << " [--pc-offset] [--frames <n>] [--cycles <n>]"
+              << " [--input <script>] [--dump <dir/>] [--display-hash]"
+              << std::endl;
     return false;
   }
   char *bios_name = argv[1];
   char *game_name = argv[2];
 
   Arm::CPU *cpu = new Arm::CPU();
-  Memory::Memory *memory = new Memory::Memory();
-
+  Memory::Memory *memory = Memory::AllocateMemory();
   Cpu_ = (void *)cpu;
   Memory_ = (void *)memory;
 
+  for (int i = 3; i < argc; ++i) {
+    if (strcmp(argv[i], "--interpreter") == 0) {
+#ifdef ENABLE_JIT
+      // Lets the JIT build be compared against the interpreter on the same
+      // ROM.
+      cpu->jit_enabled = false;
+#endif
+    } else if (strcmp(argv[i], "--no-idle-skip") == 0) {
+      cpu->idle_loops.config.enabled = false;
+    } else if (strcmp(argv[i], "--pc-offset") == 0) {
+      cpu->execution_model = Arm::ExecutionModel::PC_OFFSET;
+    } else if (strcmp(argv[i], "--display-hash") == 0) {
+      options.display_hash = true;
+    } else if (i + 1 < argc && strcmp(argv[i], "--frames") == 0) {
+      options.max_frames = strtoull(argv[++i], nullptr, 0);
+    } else if (i + 1 < argc && strcmp(argv[i], "--cycles") == 0) {
+      options.max_cycles = strtoull(argv[++i], nullptr, 0);
+    } else if (i + 1 < argc && strcmp(argv[i], "--input") == 0) {
+      options.input_script = argv[++i];
+    } else if (i + 1 < argc && strcmp(argv[i], "--dump") == 0) {
+      options.dump_dir = argv[++i];
+    } else {
+      std::cerr << "Unknown option " << argv[i] << std::endl;
+      return false;
+    }
+  }
+#ifdef ENABLE_JIT
+  if (cpu->jit_enabled) {
+    // Compiled blocks run under the PC offset model.
+    cpu->execution_model = Arm::ExecutionModel::PC_OFFSET;
+  }
+#endif
+#ifdef THREADED_DISPATCH
+  // The threaded core runs under the PC offset model.
+  cpu->execution_model = Arm::ExecutionModel::PC_OFFSET;
+#endif
+
   // Load BIOS
   if (!load_file(bios_name, (char *)memory->BIOS)) {
     LOG_VERBOSE("Could not load bios!");
@@ -65,34 +112,122 @@ bool CpuRunner::Init(int argc, char *argv[]) {
   }
 
   // Load Game Cartridge
-  if (!load_file(game_name, (char *)memory->GamePak_WS0)) {
+  if (!Memory::LoadGamePak(*memory, game_name)) {
     LOG_VERBOSE("Could not load game!");
     return false;
   }
 
+  if (options.input_script != nullptr) {
+    InputScript *input = new InputScript();
+    Input_ = (void *)input;
+    if (!input->Load(options.input_script)) {
+      return false;
+    }
+  }
+
   cpu->reset();
   Reset(*memory);
+  Events::Reset(*memory, cpu->cycles);
+  memory->Cycles = &cpu->cycles;
+  // No keys are held until the input says so.
+  Memory::SetPressedKeys(*memory, 0);
 
   initialized = true;
   return true;
 };
 
-void CpuRunner::Run() {
+CpuRunner::~CpuRunner() {
+  delete (Arm::CPU *)Cpu_;
+  delete (InputScript *)Input_;
+  if (Memory_ != nullptr) {
+    Memory::FreeMemory((Memory::Memory *)Memory_);
+  }
+}
+
+bool CpuRunner::RunUntil(U64 end) {
+  Arm::CPU &cpu = *(Arm::CPU *)Cpu_;
+  Memory::Memory &memory = *(Memory::Memory *)Memory_;
+  Events::Scheduler &events = memory.Events;
+  while (cpu.cycles < end) {
+    if (!cpu.Dispatch(memory)) {
+      return false;
+    }
+    if (cpu.idle) {
+      // Nothing changes until the next event, skip ahead to it.
+      cpu.cycles = std::max(cpu.cycles, std::min(events.next_timestamp(), end));
+    }
+    if (cpu.cycles >= events.next_timestamp()) {
+      Events::RunDueEvents(memory, cpu.cycles);
+    }
+  }
+  return true;
+}
+
+bool CpuRunner::RunCycles(uint64_t cycles) {
+  if (!initialized) {
+    LOG("CpuRunner was not initialized!");
+    return false;
+  }
+  return RunUntil(((Arm::CPU *)Cpu_)->cycles + cycles);
+}
+
+bool CpuRunner::RunFrame() {
+  if (!initialized) {
+    LOG("CpuRunner was not initialized!");
+    return false;
+  }
+  return RunUntil(Events::NextVBlank(*(Memory::Memory *)Memory_));
+}
+
+bool CpuRunner::Run() {
   LOG("Running CpuRunner");
-  Arm::CPU *cpu = (Arm::CPU *)Cpu_;
-  Memory::Memory *memory = (Memory::Memory *)Memory_;
   if (!initialized) {
     LOG("CpuRunner was not initialized!");
-  } else {
-    while (cpu->Dispatch(*memory)) {
-      // Clock time of GBA is 16.57 MHz.
-      // std::this_thread::sleep_for(std::chrono::nanoseconds(59));
+    return false;
+  }
+  Arm::CPU *cpu = (Arm::CPU *)Cpu_;
+  Memory::Memory *memory = (Memory::Memory *)Memory_;
+  const InputScript *input = (const InputScript *)Input_;
+  auto start = std::chrono::steady_clock::now();
+  U64 frames = 0;
+  bool running = true;
+  while (running && (options.max_frames == 0 || frames < options.max_frames)) {
+    if (input != nullptr) {
+      Memory::SetPressedKeys(*memory, input->PressedKeys(frames));
     }
+    U64 vblank = Events::NextVBlank(*memory);
+    bool cycle_limit = options.max_cycles != 0 && options.max_cycles < vblank;
+    running = RunUntil(cycle_limit ? options.max_cycles : vblank);
+    if (cpu->cycles >= vblank) {
+      ++frames;
+    }
+    if (cycle_limit && cpu->cycles >= options.max_cycles) {
+      break;
+    }
+  }
+  if (!running) {
     LOG("CpuRunner stopped running!");
   }
-  free(cpu);
-  free(memory);
-  return;
+  double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+  LOG("Ran %llu cycles in %.2f s, %.2f emulated MHz",
+      (unsigned long long)cpu->cycles, seconds, cpu->cycles / seconds / 1e6);
+  printf("frames=%llu cycles=%llu seconds=%.3f fps=%.1f\n",
+         (unsigned long long)frames, (unsigned long long)cpu->cycles, seconds,
+         frames / seconds);
+  cpu->idle_loops.Report();
+
+  if (options.dump_dir != nullptr) {
+    cpu->PrepareSnapshot(*memory);
+    Arm::Debug::debug_snapshot(cpu->all_registers, *memory, cpu->pipeline,
+                               options.dump_dir);
+  }
+  if (options.display_hash) {
+    printf("display_hash=%016llx\n",
+           (unsigned long long)Arm::Debug::display_hash(*memory));
+  }
+  return running;
 };
 
-} // namespace CpuRunner
\ No newline at end of file
+} // namespace CpuRunner
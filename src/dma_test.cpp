@@ -0,0 +1,92 @@
+#include <cassert>
+
+#include "arm7tdmi.h"
+#include "hardware_events.h"
+#include "memory.h"
+
+using namespace Emulator;
+
+namespace {
+
+constexpr U32 kSrc = 0x02000000;
+constexpr U32 kDst = 0x03000000;
+
+U32 ReadWord(Memory::Memory &memory, U32 address) {
+  return Memory::ReadWordFromGBAMemory(memory, address);
+}
+
+void SetUpChannel(Memory::Memory &memory, U32 n, U32 sad, U32 dad, U16 count,
+                  U16 control) {
+  U32 base = Memory::DMA0CNT_H - 10 + 12 * n;
+  Memory::WriteWordToGBAMemory(memory, base, sad);
+  Memory::WriteWordToGBAMemory(memory, base + 4, dad);
+  Memory::WriteHalfWordToGBAMemory(memory, base + 8, count);
+  Memory::WriteHalfWordToGBAMemory(memory, base + 10, control);
+}
+
+void HBlank(Arm::CPU &cpu, Memory::Memory &memory) {
+  Memory::TriggerDma(memory, Memory::DmaTiming::HBLANK);
+  cpu.DMATransfer(memory);
+}
+
+} // namespace
+
+int main() {
+  Memory::Memory *memory = new Memory::Memory();
+  Memory::Reset(*memory);
+  Events::Reset(*memory, 0);
+  Arm::CPU *cpu = new Arm::CPU();
+  cpu->reset();
+  for (U32 i = 0; i < 16; ++i) {
+    Memory::WriteWordToGBAMemory(*memory, kSrc + 4 * i, 0x1000 + i);
+  }
+
+  // Enabled, HBlank, 32 bit, repeat, destination increment/reload. Each
+  // HBlank continues from the source where the last one stopped and writes
+  // to the start of the destination again.
+  SetUpChannel(*memory, 0, kSrc, kDst, 2, 0xA660);
+  HBlank(*cpu, *memory);
+  assert(ReadWord(*memory, kDst) == 0x1000);
+  assert(ReadWord(*memory, kDst + 4) == 0x1001);
+  HBlank(*cpu, *memory);
+  assert(ReadWord(*memory, kDst) == 0x1002);
+  assert(ReadWord(*memory, kDst + 4) == 0x1003);
+  assert(ReadWord(*memory, kDst + 8) == 0);
+  assert(memory->Io.DMA[0].CNT_H == 0xA660);
+
+  // Writing SAD does not move a running channel.
+  Memory::WriteWordToGBAMemory(*memory, Memory::DMA0CNT_H - 10, kSrc);
+  HBlank(*cpu, *memory);
+  assert(ReadWord(*memory, kDst) == 0x1004);
+  assert(ReadWord(*memory, kDst + 4) == 0x1005);
+
+  // Enabling the channel again latches the registers again.
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::DMA0CNT_H, 0x0000);
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::DMA0CNT_H, 0xA660);
+  HBlank(*cpu, *memory);
+  assert(ReadWord(*memory, kDst) == 0x1000);
+
+  // Decrementing source and incrementing destination go unit by unit and
+  // both carry on across repeats.
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::DMA0CNT_H, 0x0000);
+  SetUpChannel(*memory, 1, kSrc + 4 * 15, kDst + 0x100, 2, 0xA680);
+  HBlank(*cpu, *memory);
+  HBlank(*cpu, *memory);
+  assert(ReadWord(*memory, kDst + 0x100) == 0x100F);
+  assert(ReadWord(*memory, kDst + 0x104) == 0x100E);
+  assert(ReadWord(*memory, kDst + 0x108) == 0x100D);
+  assert(ReadWord(*memory, kDst + 0x10C) == 0x100C);
+
+  // Without repeat the channel turns itself off after one transfer.
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::DMA0CNT_H + 12, 0x0000);
+  SetUpChannel(*memory, 2, kSrc, kDst + 0x200, 1, 0xA400);
+  HBlank(*cpu, *memory);
+  assert(ReadWord(*memory, kDst + 0x200) == 0x1000);
+  assert(!(memory->Io.DMA[2].CNT_H & 0x8000));
+  HBlank(*cpu, *memory);
+  assert(ReadWord(*memory, kDst + 0x204) == 0);
+
+  delete cpu;
+  delete memory;
+  return 0;
+}
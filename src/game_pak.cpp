@@ -0,0 +1,84 @@
+#include "game_pak.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logging.h"
+#include "memory_allocator.h"
+
+namespace Emulator::Memory {
+
+namespace {
+
+/// Readable bytes after the ROM, so a word read at the end of a ROM whose
+/// size is a multiple of the host page does not fault.
+constexpr U32 kGuardSize = 4;
+
+U64 MappingSize(U32 rom_size) {
+  U64 page = sysconf(_SC_PAGESIZE);
+  return (U64(rom_size) + kGuardSize + page - 1) / page * page;
+}
+
+} // namespace
+
+bool LoadGamePak(Memory &mem, const char *path) {
+  UnloadGamePak(mem);
+
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    perror("Error opening file");
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    perror("Error reading file");
+    close(fd);
+    return false;
+  }
+  U32 rom_size = st.st_size > kGamePakMaxSize ? kGamePakMaxSize : st.st_size;
+  if (rom_size == 0) {
+    close(fd);
+    return true;
+  }
+
+  // Reserve zeroed pages for the ROM and the guard, then map the file over
+  // the start of them. The reservation is huge page aligned so the ROM can be
+  // backed by huge pages where the kernel supports it for files.
+  U64 mapping_size = MappingSize(rom_size);
+  void *reserved = MapHugePageAligned(mapping_size, PROT_READ);
+  if (reserved == nullptr) {
+    perror("Error mapping file");
+    close(fd);
+    return false;
+  }
+  void *rom = mmap(reserved, rom_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd,
+                   0);
+  close(fd);
+  if (rom == MAP_FAILED) {
+    perror("Error mapping file");
+    UnmapHugePageAligned(reserved, mapping_size);
+    return false;
+  }
+#ifdef MADV_HUGEPAGE
+  madvise(rom, rom_size, MADV_HUGEPAGE);
+#endif
+
+  LOG("Mapped game pak of %u bytes", rom_size);
+  mem.GamePak = static_cast<const U8 *>(rom);
+  mem.GamePak_Size = rom_size;
+  return true;
+}
+
+void UnloadGamePak(Memory &mem) {
+  if (mem.GamePak != nullptr) {
+    UnmapHugePageAligned(const_cast<U8 *>(mem.GamePak),
+                         MappingSize(mem.GamePak_Size));
+  }
+  mem.GamePak = nullptr;
+  mem.GamePak_Size = 0;
+}
+
+} // namespace Emulator::Memory
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "memory.h"
+
+namespace Emulator::Memory {
+
+/// Maps the ROM at `path` read only into mem.GamePak. The mapping is
+/// MAP_PRIVATE, so every instance running the same ROM shares its page cache.
+/// ROMs over 32 MB are truncated. Returns false if the file cannot be mapped.
+[[nodiscard]] bool LoadGamePak(Memory &mem, const char *path);
+
+/// Unmaps the ROM loaded by LoadGamePak, if any.
+void UnloadGamePak(Memory &mem);
+
+} // namespace Emulator::Memory
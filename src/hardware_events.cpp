@@ -0,0 +1,168 @@
+#include "hardware_events.h"
+
+namespace Emulator::Events {
+
+namespace {
+
+// DISPSTAT bits.
+constexpr U16 kVBlankFlag = 1 << 0;
+constexpr U16 kHBlankFlag = 1 << 1;
+constexpr U16 kVCountFlag = 1 << 2;
+constexpr U16 kVBlankIrqEnable = 1 << 3;
+constexpr U16 kHBlankIrqEnable = 1 << 4;
+constexpr U16 kVCountIrqEnable = 1 << 5;
+
+// TMxCNT_H bits.
+constexpr U16 kTimerCountUp = 1 << 2;
+constexpr U16 kTimerIrqEnable = 1 << 6;
+constexpr U16 kTimerStart = 1 << 7;
+
+/// Cycles per tick for each TMxCNT_H prescaler setting.
+constexpr U32 kTimerPrescale[4] = {1, 64, 256, 1024};
+
+EventType TimerOverflowEvent(U32 n) {
+  return EventType(U32(EventType::TIMER0_OVERFLOW) + n);
+}
+
+/// Count-up timers tick when the previous timer overflows instead of on a
+/// clock. Timer 0 has no previous timer.
+bool IsCountUp(const Memory::Memory &memory, U32 n) {
+  return n != 0 && (memory.Io.TM[n].CNT_H & kTimerCountUp);
+}
+
+/// Loads the counter of timer `n` from its reload value at `timestamp`. A
+/// clocked timer latches its prescaler and schedules its next overflow.
+void LoadTimer(Memory::Memory &memory, U32 n, U64 timestamp) {
+  Memory::Timer &timer = memory.Io.TM[n];
+  timer.CNT_L = memory.Timer_Reload[n];
+  if (IsCountUp(memory, n)) {
+    memory.Timer_Prescale[n] = 0;
+    return;
+  }
+  U32 prescale = kTimerPrescale[timer.CNT_H & 0b11];
+  memory.Timer_Prescale[n] = prescale;
+  memory.Timer_Start[n] = timestamp - U64(timer.CNT_L) * prescale;
+  memory.Events.Schedule(TimerOverflowEvent(n),
+                         timestamp + U64(0x10000 - timer.CNT_L) * prescale);
+}
+
+void HDraw(Memory::Memory &memory, U64 timestamp) {
+  Memory::IoRegisters &io = memory.Io;
+  io.VCOUNT = (io.VCOUNT + 1) % kScanlines;
+  U16 dispstat = io.DISPSTAT & ~kHBlankFlag;
+  U16 irqs = 0;
+  if (io.VCOUNT == kVisibleLines) {
+    dispstat |= kVBlankFlag;
+    irqs |= dispstat & kVBlankIrqEnable ? Memory::kIrqVBlank : 0;
+    Memory::TriggerDma(memory, Memory::DmaTiming::VBLANK);
+  } else if (io.VCOUNT == kScanlines - 1) {
+    // The flag is cleared on the last line, not on line 0.
+    dispstat &= ~kVBlankFlag;
+  }
+  if (io.VCOUNT == dispstat >> 8) {
+    dispstat |= kVCountFlag;
+    irqs |= dispstat & kVCountIrqEnable ? Memory::kIrqVCount : 0;
+  } else {
+    dispstat &= ~kVCountFlag;
+  }
+  io.DISPSTAT = dispstat;
+  if (irqs != 0) {
+    Memory::RequestInterrupt(memory, irqs);
+  }
+  memory.Events.Schedule(EventType::HBLANK, timestamp + kHDrawCycles);
+  memory.Events.Schedule(EventType::HDRAW, timestamp + kScanlineCycles);
+}
+
+void HBlank(Memory::Memory &memory) {
+  memory.Io.DISPSTAT |= kHBlankFlag;
+  if (memory.Io.DISPSTAT & kHBlankIrqEnable) {
+    Memory::RequestInterrupt(memory, Memory::kIrqHBlank);
+  }
+  // HBlank DMA does not run during VBlank.
+  if (memory.Io.VCOUNT < kVisibleLines) {
+    Memory::TriggerDma(memory, Memory::DmaTiming::HBLANK);
+  }
+}
+
+/// Starts the timers whose start bit was set and stops the ones whose bit
+/// was cleared. Prescaler and count-up changes of a running timer take
+/// effect on its next overflow.
+void TimerControl(Memory::Memory &memory, U64 now) {
+  for (U32 n = 0; n < 4; ++n) {
+    Memory::Timer &timer = memory.Io.TM[n];
+    bool start = timer.CNT_H & kTimerStart;
+    bool running = memory.Timers_Running & (1 << n);
+    if (start && !running) {
+      memory.Timers_Running |= 1 << n;
+      LoadTimer(memory, n, now);
+    } else if (!start && running) {
+      // The counter stops where it is.
+      timer.CNT_L = Memory::TimerCounter(memory, n, now);
+      memory.Timers_Running &= ~(1 << n);
+      memory.Events.Cancel(TimerOverflowEvent(n));
+    }
+  }
+}
+
+void TimerOverflow(Memory::Memory &memory, U32 n, U64 timestamp) {
+  LoadTimer(memory, n, timestamp);
+  if (memory.Io.TM[n].CNT_H & kTimerIrqEnable) {
+    Memory::RequestInterrupt(memory, Memory::kIrqTimer0 << n);
+  }
+  if (n < 3 && (memory.Timers_Running & (1 << (n + 1))) &&
+      IsCountUp(memory, n + 1)) {
+    Memory::Timer &next = memory.Io.TM[n + 1];
+    next.CNT_L = U16(next.CNT_L + 1);
+    if (next.CNT_L == 0) {
+      TimerOverflow(memory, n + 1, timestamp);
+    }
+  }
+}
+
+} // namespace
+
+void Reset(Memory::Memory &memory, U64 now) noexcept {
+  memory.Events.Clear();
+  memory.Timers_Running = 0;
+  memory.Dma_Pending = 0;
+  memory.Io.VCOUNT = 0;
+  memory.Io.DISPSTAT &= ~(kVBlankFlag | kHBlankFlag | kVCountFlag);
+  memory.Events.Schedule(EventType::HBLANK, now + kHDrawCycles);
+  memory.Events.Schedule(EventType::HDRAW, now + kScanlineCycles);
+}
+
+U64 NextVBlank(const Memory::Memory &memory) noexcept {
+  // The next HDraw starts line VCOUNT + 1.
+  U32 lines = (kVisibleLines + kScanlines - memory.Io.VCOUNT - 1) % kScanlines;
+  return memory.Events.deadline(EventType::HDRAW) +
+         U64(lines) * kScanlineCycles;
+}
+
+void RunDueEvents(Memory::Memory &memory, U64 now) noexcept {
+  EventType type;
+  U64 timestamp;
+  while (memory.Events.PopDue(now, type, timestamp)) {
+    switch (type) {
+    case EventType::HDRAW:
+      HDraw(memory, timestamp);
+      break;
+    case EventType::HBLANK:
+      HBlank(memory);
+      break;
+    case EventType::TIMER_CONTROL:
+      TimerControl(memory, now);
+      break;
+    case EventType::TIMER0_OVERFLOW:
+    case EventType::TIMER1_OVERFLOW:
+    case EventType::TIMER2_OVERFLOW:
+    case EventType::TIMER3_OVERFLOW:
+      TimerOverflow(memory, U32(type) - U32(EventType::TIMER0_OVERFLOW),
+                    timestamp);
+      break;
+    case EventType::NUM_EVENT_TYPES:
+      break;
+    }
+  }
+}
+
+} // namespace Emulator::Events
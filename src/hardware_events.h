@@ -0,0 +1,30 @@
+#pragma once
+
+#include "datatypes.h"
+#include "memory.h"
+
+namespace Emulator::Events {
+
+/// A scanline is HDraw followed by HBlank. Lines from kVisibleLines on are
+/// VBlank.
+constexpr U32 kHDrawCycles = 960;
+constexpr U32 kHBlankCycles = 272;
+constexpr U32 kScanlineCycles = kHDrawCycles + kHBlankCycles;
+constexpr U32 kVisibleLines = 160;
+constexpr U32 kScanlines = 228;
+constexpr U32 kFrameCycles = kScanlineCycles * kScanlines;
+
+/// Clears all events and starts scanline 0 at `now`. Call after
+/// Memory::Reset.
+void Reset(Memory::Memory &memory, U64 now) noexcept;
+
+/// Cycle the next VBlank starts at, when the HDraw event of line
+/// kVisibleLines is due.
+U64 NextVBlank(const Memory::Memory &memory) noexcept;
+
+/// Fires every event due at or before `now`, earliest first. Events
+/// reschedule themselves from the cycle they were due at, not from `now`, so
+/// running late does not drift.
+void RunDueEvents(Memory::Memory &memory, U64 now) noexcept;
+
+} // namespace Emulator::Events
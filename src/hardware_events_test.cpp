@@ -0,0 +1,152 @@
+#include <cassert>
+
+#include "hardware_events.h"
+#include "memory.h"
+
+using namespace Emulator;
+using Events::EventType;
+
+int main() {
+  // Events come out earliest first, same cycle in type order, and moving an
+  // event replaces it.
+  Events::Scheduler scheduler;
+  assert(scheduler.next_timestamp() == Events::kNever);
+  scheduler.Schedule(EventType::TIMER1_OVERFLOW, 50);
+  scheduler.Schedule(EventType::HBLANK, 20);
+  scheduler.Schedule(EventType::HDRAW, 50);
+  scheduler.Schedule(EventType::HBLANK, 30);
+  assert(scheduler.next_timestamp() == 30);
+  EventType type;
+  U64 timestamp;
+  assert(!scheduler.PopDue(29, type, timestamp));
+  assert(scheduler.PopDue(100, type, timestamp));
+  assert(type == EventType::HBLANK && timestamp == 30);
+  assert(scheduler.PopDue(100, type, timestamp));
+  assert(type == EventType::HDRAW && timestamp == 50);
+  scheduler.Cancel(EventType::TIMER1_OVERFLOW);
+  assert(!scheduler.PopDue(100, type, timestamp));
+
+  Memory::Memory *memory = new Memory::Memory();
+  Memory::Reset(*memory);
+  Events::Reset(*memory, 0);
+
+  // HBlank starts after HDraw and VCOUNT moves on every scanline.
+  Events::RunDueEvents(*memory, Events::kHDrawCycles - 1);
+  assert(!(memory->Io.DISPSTAT & 0b010));
+  Events::RunDueEvents(*memory, Events::kHDrawCycles);
+  assert(memory->Io.DISPSTAT & 0b010);
+  Events::RunDueEvents(*memory, Events::kScanlineCycles);
+  assert(memory->Io.VCOUNT == 1);
+  assert(!(memory->Io.DISPSTAT & 0b010));
+
+  // VBlank sets its flag on line 160 and raises an IRQ if DISPSTAT asks for
+  // one. The flags can not be written.
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::DISPSTAT, 0xFFFF);
+  assert(memory->Io.DISPSTAT == 0xFFF8);
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::DISPSTAT, 0x0008);
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::IE, Memory::kIrqVBlank);
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::IME, 1);
+  Events::RunDueEvents(*memory,
+                       Events::kVisibleLines * Events::kScanlineCycles - 1);
+  assert(memory->Io.VCOUNT == Events::kVisibleLines - 1);
+  assert(!memory->Irq_Pending);
+  Events::RunDueEvents(*memory,
+                       Events::kVisibleLines * Events::kScanlineCycles);
+  assert(memory->Io.VCOUNT == Events::kVisibleLines);
+  assert(memory->Io.DISPSTAT & 0b001);
+  assert(memory->Io.IF == Memory::kIrqVBlank);
+  assert(memory->Irq_Pending);
+
+  // A whole frame later VCOUNT is back where it was.
+  U64 now = Events::kVisibleLines * Events::kScanlineCycles;
+  Events::RunDueEvents(*memory, now + Events::kFrameCycles);
+  assert(memory->Io.VCOUNT == Events::kVisibleLines);
+  now += Events::kFrameCycles;
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::IF, Memory::kIrqVBlank);
+  assert(!memory->Irq_Pending);
+
+  // Timer 0 counts from its reload value and overflows into count-up
+  // timer 1.
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::TM0CNT_L, 0xFFF0);
+  assert(memory->Io.TM[0].CNT_L == 0);
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::TM0CNT_L + 4, 0xFFFF);
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::TM0CNT_L + 6, 0x00C4);
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::TM0CNT_L + 2, 0x0080);
+  assert(memory->Events.next_timestamp() == 0);
+  Events::RunDueEvents(*memory, now);
+  assert(memory->Io.TM[0].CNT_L == 0xFFF0);
+  assert(memory->Timers_Running == 0b11);
+  assert(memory->Events.deadline(EventType::TIMER0_OVERFLOW) == now + 16);
+  assert(memory->Events.deadline(EventType::TIMER1_OVERFLOW) ==
+         Events::kNever);
+  Events::RunDueEvents(*memory, now + 16);
+  assert(memory->Io.TM[0].CNT_L == 0xFFF0);
+  assert(memory->Io.TM[1].CNT_L == 0xFFFF);
+  assert(memory->Io.IF == Memory::kIrqTimer0 << 1);
+  assert(memory->Events.deadline(EventType::TIMER0_OVERFLOW) == now + 32);
+
+  // Stopping a timer cancels its overflow.
+  Memory::WriteByteToGBAMemory(*memory, Memory::TM0CNT_L + 2, 0x00);
+  Events::RunDueEvents(*memory, now + 17);
+  assert(memory->Timers_Running == 0b10);
+  assert(memory->Events.deadline(EventType::TIMER0_OVERFLOW) ==
+         Events::kNever);
+
+  // A guest read sees the counter tick between overflows, at the prescaler
+  // it was started with. Stopping the timer freezes it.
+  U64 cycles = now + 100;
+  memory->Cycles = &cycles;
+  assert(Memory::ReadHalfWordFromGBAMemory(*memory, Memory::TM0CNT_L + 8) ==
+         0);
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::TM0CNT_L + 8, 0xFF00);
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::TM0CNT_L + 10, 0x0081);
+  Events::RunDueEvents(*memory, cycles);
+  assert(Memory::ReadHalfWordFromGBAMemory(*memory, Memory::TM0CNT_L + 8) ==
+         0xFF00);
+  cycles += 64 * 5 + 63;
+  assert(Memory::ReadHalfWordFromGBAMemory(*memory, Memory::TM0CNT_L + 8) ==
+         0xFF05);
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::TM0CNT_L + 10, 0x0083);
+  cycles += 64;
+  assert(Memory::ReadWordFromGBAMemory(*memory, Memory::TM0CNT_L + 8) ==
+         0x0083FF06);
+  // After the overflow it counts up from the reload value again, now with
+  // the new prescaler.
+  U64 overflow = memory->Events.deadline(EventType::TIMER2_OVERFLOW);
+  assert(overflow == now + 100 + 64 * 0x100);
+  cycles = overflow + 1024 * 3;
+  Events::RunDueEvents(*memory, cycles);
+  assert(Memory::ReadHalfWordFromGBAMemory(*memory, Memory::TM0CNT_L + 8) ==
+         0xFF03);
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::TM0CNT_L + 10, 0x0003);
+  cycles += 1024;
+  Events::RunDueEvents(*memory, cycles);
+  cycles += 1024 * 10;
+  assert(Memory::ReadHalfWordFromGBAMemory(*memory, Memory::TM0CNT_L + 8) ==
+         0xFF04);
+  memory->Cycles = nullptr;
+
+  // Enabling an immediate channel queues it, blank channels wait for their
+  // event and disabling a channel drops it.
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::DMA0CNT_H + 36, 0x8000);
+  assert(memory->Dma_Pending == 0b1000);
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::DMA0CNT_H + 36, 0x0000);
+  assert(memory->Dma_Pending == 0);
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::DMA0CNT_H, 0xA000);
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::DMA0CNT_H + 12, 0x9000);
+  assert(memory->Dma_Pending == 0);
+
+  // No HBlank DMA during VBlank.
+  Events::RunDueEvents(*memory, now + Events::kHDrawCycles);
+  assert(memory->Dma_Pending == 0);
+  U64 line_0 = now + (Events::kScanlines - Events::kVisibleLines) *
+                         Events::kScanlineCycles;
+  Events::RunDueEvents(*memory, line_0 + Events::kHDrawCycles);
+  assert(memory->Io.VCOUNT == 0);
+  assert(memory->Dma_Pending == 0b0001);
+  Events::RunDueEvents(*memory, now + Events::kFrameCycles);
+  assert(memory->Dma_Pending == 0b0011);
+
+  delete memory;
+  return 0;
+}
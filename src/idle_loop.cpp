@@ -0,0 +1,403 @@
+#include "idle_loop.h"
+
+#include <stdio.h>
+
+#include "arm_decoder.h"
+#include "arm_instructions.h"
+#include "thumb_instructions.h"
+
+namespace Emulator::Arm {
+
+namespace {
+
+// Registers are bits 0-15, flags 16-19.
+constexpr U32 kFlagN = 1 << 16;
+constexpr U32 kFlagZ = 1 << 17;
+constexpr U32 kFlagC = 1 << 18;
+constexpr U32 kFlagV = 1 << 19;
+constexpr U32 kFlagsNZ = kFlagN | kFlagZ;
+constexpr U32 kFlagsNZCV = kFlagN | kFlagZ | kFlagC | kFlagV;
+
+constexpr U32 Reg(U32 r) { return 1 << r; }
+
+/// Flags read by each condition code.
+constexpr std::array<U32, 16> kConditionReads = {
+    kFlagZ,                   // EQ
+    kFlagZ,                   // NE
+    kFlagC,                   // CS
+    kFlagC,                   // CC
+    kFlagN,                   // MI
+    kFlagN,                   // PL
+    kFlagV,                   // VS
+    kFlagV,                   // VC
+    kFlagC | kFlagZ,          // HI
+    kFlagC | kFlagZ,          // LS
+    kFlagN | kFlagV,          // GE
+    kFlagN | kFlagV,          // LT
+    kFlagN | kFlagZ | kFlagV, // GT
+    kFlagN | kFlagZ | kFlagV, // LE
+    0,                        // AL
+    0,                        // NV
+};
+
+struct InstrEffects {
+  bool allowed = false;
+  /// Writes only happen if the condition passes.
+  bool conditional = false;
+  U32 reads = 0;
+  U32 writes = 0;
+};
+
+InstrEffects AnalyseArmDataProcessing(U32 instr, Instr opcode) {
+  InstrEffects effects;
+  U32 rn = (instr >> 16) & 0xF;
+  U32 rd = (instr >> 12) & 0xF;
+  bool s = (instr >> 20) & 1;
+  bool logical = opcode == Instr::AND || opcode == Instr::EOR ||
+                 opcode == Instr::TST || opcode == Instr::TEQ ||
+                 opcode == Instr::ORR || opcode == Instr::MOV ||
+                 opcode == Instr::BIC || opcode == Instr::MVN;
+  bool compare = opcode == Instr::TST || opcode == Instr::TEQ ||
+                 opcode == Instr::CMP || opcode == Instr::CMN;
+
+  if (opcode != Instr::MOV && opcode != Instr::MVN) {
+    effects.reads |= Reg(rn);
+  }
+  if (!compare) {
+    if (rd == 15) {
+      return effects;
+    }
+    effects.writes |= Reg(rd);
+  }
+  if (opcode == Instr::ADC || opcode == Instr::SBC || opcode == Instr::RSC) {
+    effects.reads |= kFlagC;
+  }
+
+  // Whether the shifter carry out replaces C or passes the old C through.
+  bool new_carry;
+  if ((instr >> 25) & 1) {
+    new_carry = ((instr >> 8) & 0xF) != 0;
+  } else {
+    effects.reads |= Reg(instr & 0xF);
+    U32 shift = (instr >> 5) & 0b11;
+    U32 shift_imm = (instr >> 7) & 0x1F;
+    if ((instr >> 4) & 1) {
+      // Shift by register, a zero shift passes C through.
+      effects.reads |= Reg((instr >> 8) & 0xF) | kFlagC;
+      new_carry = true;
+    } else if (shift == 0b00 && shift_imm == 0) {
+      new_carry = false;
+    } else if (shift == 0b11 && shift_imm == 0) {
+      // RRX
+      effects.reads |= kFlagC;
+      new_carry = true;
+    } else {
+      new_carry = true;
+    }
+  }
+
+  if (s) {
+    if (logical) {
+      effects.writes |= kFlagsNZ | (new_carry ? kFlagC : 0);
+    } else {
+      effects.writes |= kFlagsNZCV;
+    }
+  }
+  effects.allowed = true;
+  return effects;
+}
+
+InstrEffects AnalyseArm(U32 instr, Instr opcode) {
+  InstrEffects effects;
+  switch (opcode) {
+  case Instr::AND:
+  case Instr::EOR:
+  case Instr::SUB:
+  case Instr::RSB:
+  case Instr::ADD:
+  case Instr::ADC:
+  case Instr::SBC:
+  case Instr::RSC:
+  case Instr::TST:
+  case Instr::TEQ:
+  case Instr::CMP:
+  case Instr::CMN:
+  case Instr::ORR:
+  case Instr::MOV:
+  case Instr::BIC:
+  case Instr::MVN:
+    effects = AnalyseArmDataProcessing(instr, opcode);
+    break;
+  case Instr::LDR:
+  case Instr::LDRB:
+  case Instr::LDRH:
+  case Instr::LDRSB:
+  case Instr::LDRSH: {
+    bool p = (instr >> 24) & 1;
+    bool w = (instr >> 21) & 1;
+    U32 rd = (instr >> 12) & 0xF;
+    // Writeback changes the base every iteration.
+    if (!p || w || rd == 15) {
+      return effects;
+    }
+    effects.reads |= Reg((instr >> 16) & 0xF);
+    bool register_offset = opcode == Instr::LDR || opcode == Instr::LDRB
+                               ? (instr >> 25) & 1
+                               : !((instr >> 22) & 1);
+    if (register_offset) {
+      effects.reads |= Reg(instr & 0xF);
+      if ((opcode == Instr::LDR || opcode == Instr::LDRB) &&
+          ((instr >> 5) & 0b11) == 0b11 && ((instr >> 7) & 0x1F) == 0) {
+        // RRX
+        effects.reads |= kFlagC;
+      }
+    }
+    effects.writes |= Reg(rd);
+    effects.allowed = true;
+    break;
+  }
+  default:
+    return effects;
+  }
+  effects.reads |= kConditionReads[instr >> 28];
+  effects.conditional = (instr >> 28) != ConditionCode::AL;
+  return effects;
+}
+
+InstrEffects AnalyseThumb(U16 instr, Thumb::ThumbOpcode opcode) {
+  InstrEffects effects;
+  U32 lo0 = instr & 0b111;
+  U32 lo3 = (instr >> 3) & 0b111;
+  U32 lo6 = (instr >> 6) & 0b111;
+  U32 lo8 = (instr >> 8) & 0b111;
+  U32 hi_rd = ((instr >> 4) & 0b1000) | lo0;
+  U32 hi_rm = ((instr >> 3) & 0b1111);
+
+  switch (opcode) {
+  case Thumb::MOV1:
+    effects.writes = Reg(lo8) | kFlagsNZ;
+    break;
+  case Thumb::MOV2:
+    effects.reads = Reg(lo3);
+    effects.writes = Reg(lo0) | kFlagsNZCV;
+    break;
+  case Thumb::MOV3:
+    if (hi_rd == 15) {
+      return effects;
+    }
+    effects.reads = Reg(hi_rm);
+    effects.writes = Reg(hi_rd);
+    break;
+  case Thumb::CMP1:
+    effects.reads = Reg(lo8);
+    effects.writes = kFlagsNZCV;
+    break;
+  case Thumb::CMP2:
+  case Thumb::CMN:
+    effects.reads = Reg(lo0) | Reg(lo3);
+    effects.writes = kFlagsNZCV;
+    break;
+  case Thumb::CMP3:
+    effects.reads = Reg(hi_rd) | Reg(hi_rm);
+    effects.writes = kFlagsNZCV;
+    break;
+  case Thumb::TST:
+    effects.reads = Reg(lo0) | Reg(lo3);
+    effects.writes = kFlagsNZ;
+    break;
+  case Thumb::AND:
+  case Thumb::ORR:
+  case Thumb::EOR:
+  case Thumb::BIC:
+    effects.reads = Reg(lo0) | Reg(lo3);
+    effects.writes = Reg(lo0) | kFlagsNZ;
+    break;
+  case Thumb::MVN:
+    effects.reads = Reg(lo3);
+    effects.writes = Reg(lo0) | kFlagsNZ;
+    break;
+  case Thumb::NEG:
+  case Thumb::ADD1:
+  case Thumb::SUB1:
+    effects.reads = Reg(lo3);
+    effects.writes = Reg(lo0) | kFlagsNZCV;
+    break;
+  case Thumb::ADD3:
+  case Thumb::SUB3:
+    effects.reads = Reg(lo3) | Reg(lo6);
+    effects.writes = Reg(lo0) | kFlagsNZCV;
+    break;
+  case Thumb::ADD5:
+    effects.reads = Reg(15);
+    effects.writes = Reg(lo8);
+    break;
+  case Thumb::ADD6:
+    effects.reads = Reg(13);
+    effects.writes = Reg(lo8);
+    break;
+  case Thumb::LSL1:
+    effects.reads = Reg(lo3);
+    effects.writes = Reg(lo0) | kFlagsNZ | (((instr >> 6) & 0x1F) ? kFlagC : 0);
+    break;
+  case Thumb::LSR1:
+  case Thumb::ASR1:
+    // The carry out is taken from rd.
+    effects.reads = Reg(lo0) | Reg(lo3);
+    effects.writes = Reg(lo0) | kFlagsNZ | kFlagC;
+    break;
+  case Thumb::LDR1:
+  case Thumb::LDRB1:
+  case Thumb::LDRH1:
+    effects.reads = Reg(lo3);
+    effects.writes = Reg(lo0);
+    break;
+  case Thumb::LDR2:
+  case Thumb::LDRB2:
+  case Thumb::LDRH2:
+  case Thumb::LDRSB:
+  case Thumb::LDRSH:
+    effects.reads = Reg(lo3) | Reg(lo6);
+    effects.writes = Reg(lo0);
+    break;
+  case Thumb::LDR3:
+    effects.reads = Reg(15);
+    effects.writes = Reg(lo8);
+    break;
+  case Thumb::LDR4:
+    effects.reads = Reg(13);
+    effects.writes = Reg(lo8);
+    break;
+  default:
+    return effects;
+  }
+  effects.allowed = true;
+  return effects;
+}
+
+/// The branch back to the start of the loop. Only reads the flags of its
+/// condition.
+InstrEffects AnalyseBranch(const Memory::Memory &memory, U32 addr,
+                           bool thumb) {
+  InstrEffects effects;
+  if (thumb) {
+    U16 instr = Memory::ReadHalfWordFromGBAMemory(memory, addr);
+    Thumb::ThumbOpcode opcode = Thumb::GetThumbOpcode(instr);
+    if (opcode == Thumb::B1) {
+      effects.reads = kConditionReads[(instr >> 8) & 0xF];
+      effects.allowed = true;
+    } else if (opcode == Thumb::B2) {
+      effects.allowed = true;
+    }
+  } else {
+    U32 instr = Memory::ReadWordFromGBAMemory(memory, addr);
+    if (TryDecodeArmInstr(instr) == Instr::B) {
+      effects.reads = kConditionReads[instr >> 28];
+      effects.allowed = true;
+    }
+  }
+  return effects;
+}
+
+} // namespace
+
+bool IdleLoopDetector::IsIdleLoop(const Memory::Memory &memory, U32 start_addr,
+                                  U32 branch_addr, bool thumb) const noexcept {
+  U32 step = thumb ? 2 : 4;
+  if (start_addr > branch_addr ||
+      branch_addr - start_addr >= config.max_instrs * step) {
+    return false;
+  }
+
+  std::vector<InstrEffects> body;
+  for (U32 addr = start_addr; addr < branch_addr; addr += step) {
+    InstrEffects effects;
+    if (thumb) {
+      U16 instr = Memory::ReadHalfWordFromGBAMemory(memory, addr);
+      effects = AnalyseThumb(instr, Thumb::GetThumbOpcode(instr));
+    } else {
+      U32 instr = Memory::ReadWordFromGBAMemory(memory, addr);
+      effects = AnalyseArm(instr, TryDecodeArmInstr(instr));
+    }
+    if (!effects.allowed) {
+      return false;
+    }
+    body.push_back(effects);
+  }
+  InstrEffects branch = AnalyseBranch(memory, branch_addr, thumb);
+  if (!branch.allowed) {
+    return false;
+  }
+  body.push_back(branch);
+
+  U32 written = 0;
+  for (const InstrEffects &effects : body) {
+    written |= effects.writes;
+  }
+  // Anything read before this iteration wrote it must stay the same across
+  // iterations.
+  U32 defined = 0;
+  for (const InstrEffects &effects : body) {
+    if (effects.reads & written & ~defined) {
+      return false;
+    }
+    if (!effects.conditional) {
+      defined |= effects.writes;
+    }
+  }
+  return true;
+}
+
+bool IdleLoopDetector::OnBranch(const Memory::Memory &memory, U32 branch_addr,
+                                U32 target, bool thumb,
+                                U32 generation) noexcept {
+  if (!config.enabled || target > branch_addr ||
+      branch_addr - target >= config.max_instrs * (thumb ? 2 : 4)) {
+    return false;
+  }
+
+  Entry &entry = entries_[(branch_addr >> 1) % kNumEntries];
+  if (entry.branch_addr != branch_addr || entry.target != target ||
+      entry.thumb != thumb || entry.generation != generation) {
+    entry.branch_addr = branch_addr;
+    entry.target = target;
+    entry.thumb = thumb;
+    entry.generation = generation;
+    entry.loop = IsIdleLoop(memory, target, branch_addr, thumb)
+                     ? AddIdleLoop(target, branch_addr, thumb)
+                     : -1;
+  }
+  if (entry.loop < 0) {
+    return false;
+  }
+  ++idle_loops_[entry.loop].hits;
+  return true;
+}
+
+I32 IdleLoopDetector::AddIdleLoop(U32 start_addr, U32 branch_addr,
+                                  bool thumb) {
+  for (U32 i = 0; i < idle_loops_.size(); ++i) {
+    const IdleLoop &loop = idle_loops_[i];
+    if (loop.start_addr == start_addr && loop.branch_addr == branch_addr &&
+        loop.thumb == thumb) {
+      return I32(i);
+    }
+  }
+  idle_loops_.push_back(
+      {.start_addr = start_addr, .branch_addr = branch_addr, .thumb = thumb});
+  return I32(idle_loops_.size() - 1);
+}
+
+void IdleLoopDetector::Report() const {
+  printf("Idle loops: %zu\n", idle_loops_.size());
+  for (const IdleLoop &loop : idle_loops_) {
+    printf("  0x%08X-0x%08X %s hits=%llu\n", loop.start_addr, loop.branch_addr,
+           loop.thumb ? "thumb" : "arm", (unsigned long long)loop.hits);
+  }
+}
+
+void IdleLoopDetector::Clear() {
+  entries_ = {};
+  idle_loops_.clear();
+}
+
+} // namespace Emulator::Arm
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "datatypes.h"
+#include "memory.h"
+
+namespace Emulator::Arm {
+
+struct IdleLoopConfig {
+  /// Detect idle loops at all. When off, OnBranch always returns false.
+  bool enabled = true;
+  /// Longest loop body, including the branch, that is analysed.
+  U32 max_instrs = 8;
+};
+
+/// A loop that was found to be idle, kept for the report.
+struct IdleLoop {
+  U32 start_addr;
+  U32 branch_addr;
+  bool thumb;
+  /// Number of times the back edge was taken.
+  U64 hits = 0;
+};
+
+/// Finds short loops that only read memory and compare, like polling VCOUNT
+/// or IF, or `b .` waiting for an interrupt. Such a loop runs the same way
+/// every iteration until something outside the CPU writes memory, so the
+/// runner can skip ahead to the next hardware event instead of executing it.
+///
+/// A loop is idle if it is a single block ending in the branch back to its
+/// start, every instruction is a data processing op or a load without
+/// writeback, and nothing it reads (registers or flags) is written by the
+/// loop before being read in the same iteration.
+class IdleLoopDetector {
+public:
+  static constexpr U32 kNumEntries = 256;
+
+  IdleLoopConfig config;
+
+  /// Called after the instruction at `branch_addr` branched to `target`.
+  /// Returns true if that was the back edge of an idle loop. `generation` is
+  /// the block cache generation, so rewritten code is analysed again.
+  bool OnBranch(const Memory::Memory &memory, U32 branch_addr, U32 target,
+                bool thumb, U32 generation) noexcept;
+
+  /// Loops treated as idle so far, so they can be audited.
+  const std::vector<IdleLoop> &idle_loops() const { return idle_loops_; }
+
+  /// Prints idle_loops().
+  void Report() const;
+
+  void Clear();
+
+  /// Analyses [start_addr, branch_addr] without caching.
+  bool IsIdleLoop(const Memory::Memory &memory, U32 start_addr,
+                  U32 branch_addr, bool thumb) const noexcept;
+
+private:
+  struct Entry {
+    U32 branch_addr = U32(-1);
+    U32 target = 0;
+    U32 generation = 0;
+    /// Index into idle_loops_, or -1 if the loop is not idle.
+    I32 loop = -1;
+    bool thumb = false;
+  };
+
+  I32 AddIdleLoop(U32 start_addr, U32 branch_addr, bool thumb);
+
+  std::array<Entry, kNumEntries> entries_{};
+  std::vector<IdleLoop> idle_loops_;
+};
+
+} // namespace Emulator::Arm
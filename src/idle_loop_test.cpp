@@ -0,0 +1,73 @@
+#include <cassert>
+
+#include "idle_loop.h"
+#include "memory.h"
+
+using namespace Emulator;
+using namespace Emulator::Arm;
+
+int main() {
+  Memory::Memory *memory = new Memory::Memory();
+  IdleLoopDetector detector;
+
+  // b .
+  Memory::WriteWordToGBAMemory(*memory, 0x03000000, 0xEAFFFFFE);
+  assert(detector.IsIdleLoop(*memory, 0x03000000, 0x03000000, false));
+
+  // loop: ldrh r0, [r1]; cmp r0, #160; bne loop
+  Memory::WriteWordToGBAMemory(*memory, 0x03000010, 0xE1D100B0);
+  Memory::WriteWordToGBAMemory(*memory, 0x03000014, 0xE35000A0);
+  Memory::WriteWordToGBAMemory(*memory, 0x03000018, 0x1AFFFFFC);
+  assert(detector.IsIdleLoop(*memory, 0x03000010, 0x03000018, false));
+
+  // loop: subs r0, r0, #1; bne loop makes progress every iteration.
+  Memory::WriteWordToGBAMemory(*memory, 0x03000020, 0xE2500001);
+  Memory::WriteWordToGBAMemory(*memory, 0x03000024, 0x1AFFFFFD);
+  assert(!detector.IsIdleLoop(*memory, 0x03000020, 0x03000024, false));
+
+  // loop: ldr r0, [r1], #4; cmp r0, #0; beq loop walks memory.
+  Memory::WriteWordToGBAMemory(*memory, 0x03000030, 0xE4910004);
+  Memory::WriteWordToGBAMemory(*memory, 0x03000034, 0xE3500000);
+  Memory::WriteWordToGBAMemory(*memory, 0x03000038, 0x0AFFFFFC);
+  assert(!detector.IsIdleLoop(*memory, 0x03000030, 0x03000038, false));
+
+  // loop: str r0, [r1]; b loop has a side effect.
+  Memory::WriteWordToGBAMemory(*memory, 0x03000040, 0xE5810000);
+  Memory::WriteWordToGBAMemory(*memory, 0x03000044, 0xEAFFFFFD);
+  assert(!detector.IsIdleLoop(*memory, 0x03000040, 0x03000044, false));
+
+  // Thumb loop: ldr r0, [r1]; tst r0, r2; beq loop
+  Memory::WriteHalfWordToGBAMemory(*memory, 0x03000100, 0x6808);
+  Memory::WriteHalfWordToGBAMemory(*memory, 0x03000102, 0x4210);
+  Memory::WriteHalfWordToGBAMemory(*memory, 0x03000104, 0xD0FC);
+  assert(detector.IsIdleLoop(*memory, 0x03000100, 0x03000104, true));
+
+  // Thumb loop: add r1, #1; cmp r1, r0; bne loop counts.
+  Memory::WriteHalfWordToGBAMemory(*memory, 0x03000110, 0x3101);
+  Memory::WriteHalfWordToGBAMemory(*memory, 0x03000112, 0x4281);
+  Memory::WriteHalfWordToGBAMemory(*memory, 0x03000114, 0xD1FC);
+  assert(!detector.IsIdleLoop(*memory, 0x03000110, 0x03000114, true));
+
+  // Back edges are cached and counted for the report.
+  assert(detector.OnBranch(*memory, 0x03000018, 0x03000010, false, 0));
+  assert(detector.OnBranch(*memory, 0x03000018, 0x03000010, false, 0));
+  assert(!detector.OnBranch(*memory, 0x03000024, 0x03000020, false, 0));
+  assert(detector.idle_loops().size() == 1);
+  assert(detector.idle_loops()[0].start_addr == 0x03000010);
+  assert(detector.idle_loops()[0].hits == 2);
+
+  // Forward branches and long loops are not looked at.
+  assert(!detector.OnBranch(*memory, 0x03000010, 0x03000018, false, 0));
+  assert(!detector.OnBranch(*memory, 0x03000100, 0x03000000, false, 0));
+
+  // Rewritten code is analysed again under a new generation.
+  Memory::WriteWordToGBAMemory(*memory, 0x03000010, 0xE5810000);
+  assert(detector.OnBranch(*memory, 0x03000018, 0x03000010, false, 0));
+  assert(!detector.OnBranch(*memory, 0x03000018, 0x03000010, false, 1));
+
+  detector.config.enabled = false;
+  assert(!detector.OnBranch(*memory, 0x03000000, 0x03000000, false, 1));
+
+  delete memory;
+  return 0;
+}
@@ -0,0 +1,83 @@
+#include "input_script.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logging.h"
+
+namespace Emulator {
+
+namespace {
+
+/// In KEYINPUT bit order.
+constexpr const char *kKeyNames[] = {"A",    "B",  "SELECT", "START", "RIGHT",
+                                     "LEFT", "UP", "DOWN",   "R",     "L"};
+
+/// Parses `A+START`. Returns false on an unknown name.
+bool ParseKeys(char *names, U16 &keys) {
+  keys = 0;
+  if (strcmp(names, "-") == 0) {
+    return true;
+  }
+  for (char *name = strtok(names, "+"); name != nullptr;
+       name = strtok(nullptr, "+")) {
+    U32 i = 0;
+    while (i < std::size(kKeyNames) && strcmp(name, kKeyNames[i]) != 0) {
+      ++i;
+    }
+    if (i == std::size(kKeyNames)) {
+      return false;
+    }
+    keys |= 1 << i;
+  }
+  return true;
+}
+
+} // namespace
+
+bool InputScript::Load(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (file == nullptr) {
+    perror("Error opening input script");
+    return false;
+  }
+  entries_.clear();
+  char line[256];
+  U32 line_num = 0;
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    ++line_num;
+    if (char *comment = strchr(line, '#')) {
+      *comment = '\0';
+    }
+    unsigned long long frame;
+    char names[128];
+    int fields = sscanf(line, "%llu %127s", &frame, names);
+    if (fields == EOF) {
+      continue;
+    }
+    Entry entry{.frame = frame, .keys = 0};
+    if (fields != 2 || !ParseKeys(names, entry.keys)) {
+      LOG("Bad input script line %s:%u", path, line_num);
+      fclose(file);
+      return false;
+    }
+    entries_.push_back(entry);
+  }
+  fclose(file);
+  std::stable_sort(
+      entries_.begin(), entries_.end(),
+      [](const Entry &a, const Entry &b) { return a.frame < b.frame; });
+  return true;
+}
+
+U16 InputScript::PressedKeys(U64 frame) const noexcept {
+  auto next = std::upper_bound(
+      entries_.begin(), entries_.end(), frame,
+      [](U64 frame, const Entry &entry) { return frame < entry.frame; });
+  return next == entries_.begin() ? 0 : std::prev(next)->keys;
+}
+
+} // namespace Emulator
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+#include "datatypes.h"
+
+namespace Emulator {
+
+/// Keys to hold during headless runs, by frame. Each line is
+/// `<frame> <keys>`, where keys are names joined by `+` (A, B, SELECT, START,
+/// RIGHT, LEFT, UP, DOWN, R, L) or `-` for none. The keys stay held from that
+/// frame until the next line. `#` starts a comment.
+///
+///   # Press start on frame 120 for 5 frames.
+///   120 START
+///   125 -
+class InputScript {
+public:
+  /// Returns false and logs the line if the script can not be read.
+  [[nodiscard]] bool Load(const char *path);
+
+  /// Keys held during `frame`, in KEYINPUT bit order.
+  U16 PressedKeys(U64 frame) const noexcept;
+
+private:
+  struct Entry {
+    U64 frame;
+    U16 keys;
+  };
+
+  /// Sorted by frame.
+  std::vector<Entry> entries_;
+};
+
+} // namespace Emulator
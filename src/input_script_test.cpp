@@ -0,0 +1,43 @@
+#include <cassert>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "input_script.h"
+
+using namespace Emulator;
+
+int main() {
+  char path[] = "/tmp/input_script_test_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd != -1);
+  FILE *file = fdopen(fd, "w");
+  fputs("# Boot, then start.\n"
+        "\n"
+        "120 START\n"
+        "125 -   # Let go.\n"
+        "60 A+UP\n",
+        file);
+  fclose(file);
+
+  // Keys hold until the next line, lines may be out of order.
+  InputScript script;
+  assert(script.Load(path));
+  assert(script.PressedKeys(0) == 0);
+  assert(script.PressedKeys(59) == 0);
+  assert(script.PressedKeys(60) == 0b0001000001);
+  assert(script.PressedKeys(119) == 0b0001000001);
+  assert(script.PressedKeys(120) == 0b0000001000);
+  assert(script.PressedKeys(124) == 0b0000001000);
+  assert(script.PressedKeys(125) == 0);
+  assert(script.PressedKeys(100000) == 0);
+
+  file = fopen(path, "w");
+  fputs("10 A+JUMP\n", file);
+  fclose(file);
+  assert(!script.Load(path));
+
+  remove(path);
+  assert(!script.Load(path));
+  return 0;
+}
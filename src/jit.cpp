@@ -0,0 +1,1445 @@
+#include "jit.h"
+
+#ifdef ENABLE_JIT
+
+#include <algorithm>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "arm7tdmi.h"
+#include "logging.h"
+#include "thumb_instructions.h"
+
+namespace Emulator::Arm {
+
+using namespace BitUtils;
+
+namespace {
+
+/// Guest register operand that is not used. Reads as 0.
+constexpr U32 kNoReg = 16;
+constexpr U32 kCondAL = U32(ConditionCode::AL);
+
+// x86-64 registers.
+constexpr U32 RAX = 0;
+constexpr U32 RCX = 1;
+constexpr U32 RDX = 2;
+constexpr U32 RBX = 3;
+constexpr U32 RSP = 4;
+constexpr U32 RBP = 5;
+constexpr U32 RSI = 6;
+constexpr U32 RDI = 7;
+constexpr U32 R8 = 8;
+constexpr U32 R12 = 12;
+constexpr U32 R13 = 13;
+constexpr U32 R14 = 14;
+constexpr U32 R15 = 15;
+
+/// Callee saved host registers that hold guest registers within a block. rbx
+/// holds the CPU and r12 the Memory.
+constexpr U32 kCacheRegs[] = {RBP, R13, R14, R15};
+constexpr U32 kNoHostReg = 0xFF;
+
+// Opcodes of the `op r/m32, r32` forms and the /digit of the `op r/m32, imm32`
+// forms.
+constexpr U8 kOpAdd = 0x01;
+constexpr U8 kOpOr = 0x09;
+constexpr U8 kOpAnd = 0x21;
+constexpr U8 kOpSub = 0x29;
+constexpr U8 kOpXor = 0x31;
+constexpr U8 kOpMov = 0x89;
+constexpr U32 kDigitAdd = 0;
+constexpr U32 kDigitAnd = 4;
+constexpr U32 kDigitCmp = 7;
+
+// Shift /digits.
+constexpr U32 kShiftRor = 1;
+constexpr U32 kShiftShl = 4;
+constexpr U32 kShiftShr = 5;
+constexpr U32 kShiftSar = 7;
+
+// Condition codes of jcc and cmovcc.
+constexpr U8 kCondAE = 0x3;
+constexpr U8 kCondE = 0x4;
+constexpr U8 kCondNE = 0x5;
+
+/// Encodes x86-64 instructions into a growing buffer. Register arguments are
+/// host register numbers, all memory operands are [base + disp32].
+class Assembler {
+public:
+  void Byte(U8 byte) { code_.push_back(byte); }
+
+  void Imm16(U16 value) {
+    Byte(value);
+    Byte(value >> 8);
+  }
+
+  void Imm32(U32 value) {
+    for (U32 i = 0; i < 4; ++i) {
+      Byte(value >> (8 * i));
+    }
+  }
+
+  void Imm64(U64 value) {
+    Imm32(U32(value));
+    Imm32(U32(value >> 32));
+  }
+
+  /// `op r/m32, r32`, e.g. kOpAdd adds src to dst.
+  void Op(U8 opcode, U32 dst, U32 src) {
+    Rex(false, src, dst);
+    Byte(opcode);
+    ModRmReg(src, dst);
+  }
+
+  /// `op r/m32, imm32` with the /digit of op.
+  void OpImm(U32 digit, U32 dst, U32 imm) {
+    Rex(false, 0, dst);
+    Byte(0x81);
+    ModRmReg(digit, dst);
+    Imm32(imm);
+  }
+
+  void Mov(U32 dst, U32 src) { Op(kOpMov, dst, src); }
+
+  void Mov64(U32 dst, U32 src) {
+    Rex(true, src, dst);
+    Byte(kOpMov);
+    ModRmReg(src, dst);
+  }
+
+  void MovImm(U32 dst, U32 imm) {
+    Rex(false, 0, dst);
+    Byte(0xB8 + (dst & 7));
+    Imm32(imm);
+  }
+
+  void MovImm64(U32 dst, U64 imm) {
+    Rex(true, 0, dst);
+    Byte(0xB8 + (dst & 7));
+    Imm64(imm);
+  }
+
+  void Load32(U32 dst, U32 base, I32 disp) {
+    Rex(false, dst, base);
+    Byte(0x8B);
+    ModRmMem(dst, base, disp);
+  }
+
+  void Load64(U32 dst, U32 base, I32 disp) {
+    Rex(true, dst, base);
+    Byte(0x8B);
+    ModRmMem(dst, base, disp);
+  }
+
+  /// movzx r32, byte [base + disp]
+  void LoadU8(U32 dst, U32 base, I32 disp) {
+    Rex(false, dst, base);
+    Byte(0x0F);
+    Byte(0xB6);
+    ModRmMem(dst, base, disp);
+  }
+
+  void Store32(U32 base, I32 disp, U32 src) {
+    Rex(false, src, base);
+    Byte(kOpMov);
+    ModRmMem(src, base, disp);
+  }
+
+  void Store64(U32 base, I32 disp, U32 src) {
+    Rex(true, src, base);
+    Byte(kOpMov);
+    ModRmMem(src, base, disp);
+  }
+
+  void Store32Imm(U32 base, I32 disp, U32 imm) {
+    Rex(false, 0, base);
+    Byte(0xC7);
+    ModRmMem(0, base, disp);
+    Imm32(imm);
+  }
+
+  void Store16Imm(U32 base, I32 disp, U16 imm) {
+    Byte(0x66);
+    Rex(false, 0, base);
+    Byte(0xC7);
+    ModRmMem(0, base, disp);
+    Imm16(imm);
+  }
+
+  void Store8Imm(U32 base, I32 disp, U8 imm) {
+    Rex(false, 0, base);
+    Byte(0xC6);
+    ModRmMem(0, base, disp);
+    Byte(imm);
+  }
+
+  /// add qword [base + disp], src
+  void Add64ToMem(U32 base, I32 disp, U32 src) {
+    Rex(true, src, base);
+    Byte(kOpAdd);
+    ModRmMem(src, base, disp);
+  }
+
+  /// add dword [base + disp], imm8
+  void AddToMem32(U32 base, I32 disp, U8 imm) {
+    Rex(false, 0, base);
+    Byte(0x83);
+    ModRmMem(kDigitAdd, base, disp);
+    Byte(imm);
+  }
+
+  /// cmp dword [base + disp], imm32
+  void CmpMem32Imm(U32 base, I32 disp, U32 imm) {
+    Rex(false, 0, base);
+    Byte(0x81);
+    ModRmMem(kDigitCmp, base, disp);
+    Imm32(imm);
+  }
+
+  /// cmp r64, qword [base + disp]
+  void Cmp64Mem(U32 reg, U32 base, I32 disp) {
+    Rex(true, reg, base);
+    Byte(0x3B);
+    ModRmMem(reg, base, disp);
+  }
+
+  void Test(U32 a, U32 b) {
+    Rex(false, b, a);
+    Byte(0x85);
+    ModRmReg(b, a);
+  }
+
+  void Cmov(U8 cond, U32 dst, U32 src) {
+    Rex(false, dst, src);
+    Byte(0x0F);
+    Byte(0x40 | cond);
+    ModRmReg(dst, src);
+  }
+
+  void Shift(U32 digit, U32 reg, U8 amount) {
+    Rex(false, 0, reg);
+    Byte(0xC1);
+    ModRmReg(digit, reg);
+    Byte(amount);
+  }
+
+  void Not(U32 reg) {
+    Rex(false, 0, reg);
+    Byte(0xF7);
+    ModRmReg(2, reg);
+  }
+
+  void Push(U32 reg) {
+    if (reg >= 8) {
+      Byte(0x41);
+    }
+    Byte(0x50 + (reg & 7));
+  }
+
+  void Pop(U32 reg) {
+    if (reg >= 8) {
+      Byte(0x41);
+    }
+    Byte(0x58 + (reg & 7));
+  }
+
+  /// Calls `fn` through rax.
+  void Call(const void *fn) {
+    MovImm64(RAX, reinterpret_cast<U64>(fn));
+    Byte(0xFF);
+    Byte(0xD0);
+  }
+
+  void Ret() { Byte(0xC3); }
+
+  /// Emits a jcc with a placeholder target and returns it for Bind.
+  U32 Jcc(U8 cond) {
+    Byte(0x0F);
+    Byte(0x80 | cond);
+    Imm32(0);
+    return size() - 4;
+  }
+
+  U32 Jmp() {
+    Byte(0xE9);
+    Imm32(0);
+    return size() - 4;
+  }
+
+  /// Points the jump emitted at `fixup` to `target`.
+  void Bind(U32 fixup, U32 target) {
+    I32 rel = I32(target) - I32(fixup + 4);
+    memcpy(&code_[fixup], &rel, sizeof(rel));
+  }
+
+  void BindHere(U32 fixup) { Bind(fixup, size()); }
+
+  U32 size() const { return code_.size(); }
+  const std::vector<U8> &code() const { return code_; }
+
+private:
+  void Rex(bool w, U32 reg, U32 rm) {
+    U8 rex = 0x40 | (U8(w) << 3) | ((reg >> 3) << 2) | (rm >> 3);
+    if (rex != 0x40) {
+      Byte(rex);
+    }
+  }
+
+  void ModRmReg(U32 reg, U32 rm) { Byte(0xC0 | ((reg & 7) << 3) | (rm & 7)); }
+
+  void ModRmMem(U32 reg, U32 base, I32 disp) {
+    Byte(0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == RSP) {
+      Byte(0x24);
+    }
+    Imm32(disp);
+  }
+
+  std::vector<U8> code_;
+};
+
+enum class OpKind : U8 { INTERPRET, ALU, LOAD, STORE, BRANCH };
+
+enum class AluOp : U8 {
+  MOV,
+  MVN,
+  NEG,
+  AND,
+  EOR,
+  ORR,
+  BIC,
+  ADD,
+  SUB,
+  RSB,
+  TST,
+  TEQ,
+  CMP,
+  CMN
+};
+
+enum class ShiftOp : U8 { LSL, LSR, ASR, ROR };
+
+/// Where the C and V operands of an instruction come from. The interpreter
+/// reads rn and rm after writing rd, so when they are the same register the
+/// operand is the result.
+enum class CvSource : U8 { RN, OPERAND, RESULT, ZERO };
+
+enum class CarrySource : U8 {
+  /// C is not written.
+  KEEP,
+  /// C is carry_bit.
+  CONST,
+  /// C is bit carry_bit of rm before the shift.
+  RM_BIT,
+};
+
+/// One instruction of a block as the compiler sees it.
+struct Op {
+  OpKind kind = OpKind::INTERPRET;
+  U32 cond = kCondAL;
+  U32 rd = kNoReg;
+  U32 rn = kNoReg;
+
+  // ALU: the second operand is `imm` or rm shifted by `shift_amount`, where
+  // an amount of 32 is the LSR/ASR #32 encoded as #0.
+  AluOp alu = AluOp::MOV;
+  bool operand_imm = true;
+  U32 imm = 0;
+  U32 rm = kNoReg;
+  ShiftOp shift = ShiftOp::LSL;
+  U32 shift_amount = 0;
+  bool set_nz = false;
+  FlagOp cv_op = FlagOp::NONE;
+  CvSource cv_lhs = CvSource::RN;
+  CvSource cv_rhs = CvSource::OPERAND;
+  CarrySource carry = CarrySource::KEEP;
+  U32 carry_bit = 0;
+
+  // LOAD, STORE: the address is rn + rm or rn + offset, before the offset is
+  // applied if !pre_index.
+  U32 size = 4;
+  /// Thumb word accesses ABORT on misaligned addresses instead of rotating.
+  bool aligned = false;
+  I32 offset = 0;
+  bool pre_index = true;
+  bool writeback = false;
+
+  // BRANCH: the target is rn + target (rn may be kNoReg). LR is set to link
+  // unless it is kNoReg.
+  U32 target = 0;
+  U32 link = kNoReg;
+};
+
+/// The data processing operations the compiler handles. ADC, SBC, RSC and MVN
+/// stay in the interpreter.
+bool ArmAluOp(Instr opcode, AluOp &alu) {
+  switch (opcode) {
+  case Instr::AND:
+    alu = AluOp::AND;
+    return true;
+  case Instr::EOR:
+    alu = AluOp::EOR;
+    return true;
+  case Instr::SUB:
+    alu = AluOp::SUB;
+    return true;
+  case Instr::RSB:
+    alu = AluOp::RSB;
+    return true;
+  case Instr::ADD:
+    alu = AluOp::ADD;
+    return true;
+  case Instr::ORR:
+    alu = AluOp::ORR;
+    return true;
+  case Instr::MOV:
+    alu = AluOp::MOV;
+    return true;
+  case Instr::BIC:
+    alu = AluOp::BIC;
+    return true;
+  case Instr::TST:
+    alu = AluOp::TST;
+    return true;
+  case Instr::TEQ:
+    alu = AluOp::TEQ;
+    return true;
+  case Instr::CMP:
+    alu = AluOp::CMP;
+    return true;
+  case Instr::CMN:
+    alu = AluOp::CMN;
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool WritesRd(AluOp alu) {
+  return alu != AluOp::TST && alu != AluOp::TEQ && alu != AluOp::CMP &&
+         alu != AluOp::CMN;
+}
+
+Op TranslateArmDataProcessing(U32 raw, AluOp alu) {
+  const DataProcessingInstr instr(raw);
+  Op op;
+  if (!instr.fields.i && GetBit(raw, 4)) {
+    // Shift by register.
+    return op;
+  }
+  if (WritesRd(alu) && instr.fields.rd == PC) {
+    return op;
+  }
+  op.alu = alu;
+  op.cond = instr.fields.cond;
+  op.rd = WritesRd(alu) ? U32(instr.fields.rd) : kNoReg;
+  op.rn = alu == AluOp::MOV ? kNoReg : U32(instr.fields.rn);
+
+  CarrySource carry = CarrySource::KEEP;
+  U32 carry_bit = 0;
+  if (instr.fields.i) {
+    const DataProcessingInstrImmediate operand_2(instr.fields.operand_2);
+    op.imm = operand_2.fields.rotate_imm == 0
+                 ? U32(operand_2.fields.immed_8)
+                 : RotateRight(operand_2.fields.immed_8,
+                               operand_2.fields.rotate_imm * 2);
+    if (operand_2.fields.rotate_imm != 0) {
+      carry = CarrySource::CONST;
+      carry_bit = GetBit(op.imm, 31);
+    }
+  } else {
+    const DataProcessingInstrShiftByImm operand_2(instr.fields.operand_2);
+    U32 amount = operand_2.fields.shift_imm;
+    op.operand_imm = false;
+    op.rm = operand_2.fields.rm;
+    op.shift = ShiftOp(GetBitsInRange(raw, 5, 7));
+    switch (op.shift) {
+    case ShiftOp::LSL:
+      if (amount != 0) {
+        carry = CarrySource::RM_BIT;
+        carry_bit = 32 - amount;
+      }
+      break;
+    case ShiftOp::LSR:
+    case ShiftOp::ASR:
+      amount = amount == 0 ? 32 : amount;
+      carry = CarrySource::RM_BIT;
+      carry_bit = amount - 1;
+      break;
+    case ShiftOp::ROR:
+      if (amount == 0) {
+        // RRX.
+        return Op{};
+      }
+      carry = CarrySource::RM_BIT;
+      carry_bit = amount - 1;
+      break;
+    }
+    op.shift_amount = amount;
+  }
+
+  op.kind = OpKind::ALU;
+  // Like the interpreter, compares set the flags even without the S bit.
+  if (!instr.fields.s && WritesRd(alu)) {
+    return op;
+  }
+  op.set_nz = true;
+  CvSource rn_after = op.rn == op.rd ? CvSource::RESULT : CvSource::RN;
+  switch (alu) {
+  case AluOp::ADD:
+  case AluOp::SUB:
+    op.cv_op = alu == AluOp::ADD ? FlagOp::ADD : FlagOp::SUB;
+    op.cv_lhs = rn_after;
+    op.cv_rhs = CvSource::OPERAND;
+    break;
+  case AluOp::RSB:
+    op.cv_op = FlagOp::SUB;
+    op.cv_lhs = CvSource::OPERAND;
+    op.cv_rhs = rn_after;
+    break;
+  case AluOp::CMP:
+  case AluOp::CMN:
+    op.cv_op = alu == AluOp::CMN ? FlagOp::ADD : FlagOp::SUB;
+    break;
+  default:
+    op.carry = carry;
+    op.carry_bit = carry_bit;
+    break;
+  }
+  return op;
+}
+
+Op TranslateArmSingleTransfer(U32 raw, OpKind kind, U32 size) {
+  const SingleDataTransferInstr instr(raw);
+  Op op;
+  bool writeback = instr.fields.p == 0 || instr.fields.w == 1;
+  if (instr.fields.i || instr.fields.rd == PC ||
+      (writeback && instr.fields.rn == PC)) {
+    return op;
+  }
+  const LoadAndStoreWordOrByteImm encoding(instr.fields.offset);
+  op.kind = kind;
+  op.cond = instr.fields.cond;
+  op.rd = instr.fields.rd;
+  op.rn = instr.fields.rn;
+  op.size = size;
+  op.offset = instr.fields.u ? I32(encoding.fields.offset)
+                             : -I32(encoding.fields.offset);
+  op.pre_index = instr.fields.p == 1;
+  op.writeback = writeback;
+  return op;
+}
+
+Op TranslateArm(U32 addr, const DecodedInstr &decoded) {
+  if (decoded.opcode == kOpcodeNotDecoded || (decoded.instr >> 28) == 0xF) {
+    return Op{};
+  }
+  Instr opcode = Instr(decoded.opcode);
+  AluOp alu;
+  if (ArmAluOp(opcode, alu)) {
+    return TranslateArmDataProcessing(decoded.instr, alu);
+  }
+  switch (opcode) {
+  case Instr::LDR:
+    return TranslateArmSingleTransfer(decoded.instr, OpKind::LOAD, 4);
+  case Instr::LDRB:
+    return TranslateArmSingleTransfer(decoded.instr, OpKind::LOAD, 1);
+  case Instr::STR:
+    return TranslateArmSingleTransfer(decoded.instr, OpKind::STORE, 4);
+  case Instr::STRB:
+    return TranslateArmSingleTransfer(decoded.instr, OpKind::STORE, 1);
+  case Instr::B:
+  case Instr::BL: {
+    const BranchInstr instr(decoded.instr);
+    Op op;
+    op.kind = OpKind::BRANCH;
+    op.cond = instr.fields.cond;
+    op.target =
+        addr + 8 + SignExtend(ConcatBits(instr.fields.offset, 0b00, 2), 26);
+    if (opcode == Instr::BL) {
+      op.link = addr + 4;
+    }
+    return op;
+  }
+  default:
+    return Op{};
+  }
+}
+
+Op ThumbAlu(AluOp alu, U32 rd, U32 rn, U32 rm, bool set_nz) {
+  Op op;
+  op.kind = OpKind::ALU;
+  op.alu = alu;
+  op.rd = WritesRd(alu) ? rd : kNoReg;
+  op.rn = rn;
+  op.operand_imm = false;
+  op.rm = rm;
+  op.set_nz = set_nz;
+  return op;
+}
+
+Op ThumbAluImm(AluOp alu, U32 rd, U32 rn, U32 imm, bool set_nz) {
+  Op op = ThumbAlu(alu, rd, rn, kNoReg, set_nz);
+  op.operand_imm = true;
+  op.imm = imm;
+  return op;
+}
+
+/// Adds C and V from lhs op rhs.
+Op WithCv(Op op, FlagOp cv_op, CvSource lhs, CvSource rhs) {
+  op.cv_op = cv_op;
+  op.cv_lhs = lhs;
+  op.cv_rhs = rhs;
+  return op;
+}
+
+Op ThumbTransfer(OpKind kind, U32 size, U32 rd, U32 rn, U32 rm, I32 offset) {
+  Op op;
+  op.kind = kind;
+  op.size = size;
+  op.aligned = size == 4;
+  op.rd = rd;
+  op.rn = rn;
+  op.rm = rm;
+  op.offset = offset;
+  return op;
+}
+
+Op TranslateThumb(U32 addr, const DecodedInstr &decoded) {
+  if (decoded.opcode == kOpcodeNotDecoded) {
+    return Op{};
+  }
+  U16 instr = decoded.instr;
+  U32 pc = addr + 4;
+  U32 lo0 = GetBitsInRange(instr, 0, 3);
+  U32 lo3 = GetBitsInRange(instr, 3, 6);
+  U32 lo6 = GetBitsInRange(instr, 6, 9);
+  U32 hi8 = GetBitsInRange(instr, 8, 11);
+  U32 imm3 = GetBitsInRange(instr, 6, 9);
+  U32 imm5 = GetBitsInRange(instr, 6, 11);
+  U32 imm7 = GetBitsInRange(instr, 0, 7);
+  U32 imm8 = GetBitsInRange(instr, 0, 8);
+  U32 hi_rd = ConcatBits(GetBit(instr, 7), lo0, 3);
+  U32 hi_rm = ConcatBits(GetBit(instr, 6), lo3, 3);
+  auto rn_after = [](U32 rn, U32 rd) {
+    return rn == rd ? CvSource::RESULT : CvSource::RN;
+  };
+  auto rm_after = [](U32 rm, U32 rd) {
+    return rm == rd ? CvSource::RESULT : CvSource::OPERAND;
+  };
+
+  switch (Thumb::ThumbOpcode(decoded.opcode)) {
+  case Thumb::MOV1:
+    return ThumbAluImm(AluOp::MOV, hi8, kNoReg, imm8, true);
+  case Thumb::MOV3:
+    if (hi_rd == PC) {
+      return Op{};
+    }
+    return ThumbAlu(AluOp::MOV, hi_rd, kNoReg, hi_rm, false);
+  case Thumb::MVN:
+    return ThumbAlu(AluOp::MVN, lo0, kNoReg, lo3, true);
+  case Thumb::AND:
+    return ThumbAlu(AluOp::AND, lo0, lo0, lo3, true);
+  case Thumb::EOR:
+    return ThumbAlu(AluOp::EOR, lo0, lo0, lo3, true);
+  case Thumb::ORR:
+    return ThumbAlu(AluOp::ORR, lo0, lo0, lo3, true);
+  case Thumb::BIC:
+    return ThumbAlu(AluOp::BIC, lo0, lo0, lo3, true);
+  case Thumb::TST:
+    return ThumbAlu(AluOp::TST, kNoReg, lo0, lo3, true);
+  case Thumb::CMP1:
+    return WithCv(ThumbAluImm(AluOp::CMP, kNoReg, hi8, imm8, true),
+                  FlagOp::SUB, CvSource::RN, CvSource::OPERAND);
+  case Thumb::CMP2:
+    return WithCv(ThumbAlu(AluOp::CMP, kNoReg, lo0, lo3, true), FlagOp::SUB,
+                  CvSource::RN, CvSource::OPERAND);
+  case Thumb::CMP3:
+    return WithCv(ThumbAlu(AluOp::CMP, kNoReg, hi_rd, hi_rm, true),
+                  FlagOp::SUB, CvSource::RN, CvSource::OPERAND);
+  case Thumb::CMN:
+    return WithCv(ThumbAlu(AluOp::CMN, kNoReg, lo0, lo3, true), FlagOp::ADD,
+                  CvSource::RN, CvSource::OPERAND);
+  case Thumb::NEG:
+    return WithCv(ThumbAlu(AluOp::NEG, lo0, kNoReg, lo3, true), FlagOp::SUB,
+                  CvSource::ZERO, rm_after(lo3, lo0));
+  case Thumb::ADD1:
+    return WithCv(ThumbAluImm(AluOp::ADD, lo0, lo3, imm3, true), FlagOp::ADD,
+                  rn_after(lo3, lo0), CvSource::OPERAND);
+  case Thumb::SUB1:
+    return WithCv(ThumbAluImm(AluOp::SUB, lo0, lo3, imm3, true), FlagOp::SUB,
+                  rn_after(lo3, lo0), CvSource::OPERAND);
+  case Thumb::ADD2:
+    return WithCv(ThumbAluImm(AluOp::ADD, hi8, hi8, imm8, true), FlagOp::ADD,
+                  CvSource::RN, CvSource::OPERAND);
+  case Thumb::SUB2:
+    return WithCv(ThumbAluImm(AluOp::SUB, hi8, hi8, imm8, true), FlagOp::SUB,
+                  CvSource::RN, CvSource::OPERAND);
+  case Thumb::ADD3:
+    return WithCv(ThumbAlu(AluOp::ADD, lo0, lo3, lo6, true), FlagOp::ADD,
+                  rn_after(lo3, lo0), rm_after(lo6, lo0));
+  case Thumb::SUB3:
+    return WithCv(ThumbAlu(AluOp::SUB, lo0, lo3, lo6, true), FlagOp::SUB,
+                  rn_after(lo3, lo0), rm_after(lo6, lo0));
+  case Thumb::ADD5:
+    return ThumbAluImm(AluOp::MOV, hi8, kNoReg, (pc & ~3u) + (imm8 << 2),
+                       false);
+  case Thumb::ADD6:
+    return ThumbAluImm(AluOp::ADD, hi8, SP, imm8 << 2, false);
+  case Thumb::ADD7:
+    return ThumbAluImm(AluOp::ADD, SP, SP, imm7 << 2, false);
+  case Thumb::SUB4:
+    return ThumbAluImm(AluOp::SUB, SP, SP, imm7 << 2, false);
+  case Thumb::LDR1:
+    return ThumbTransfer(OpKind::LOAD, 4, lo0, lo3, kNoReg, imm5 * 4);
+  case Thumb::LDR2:
+    return ThumbTransfer(OpKind::LOAD, 4, lo0, lo3, lo6, 0);
+  case Thumb::LDR3:
+    return ThumbTransfer(OpKind::LOAD, 4, hi8, kNoReg, kNoReg,
+                         (pc & ~3u) + imm8 * 4);
+  case Thumb::LDR4:
+    return ThumbTransfer(OpKind::LOAD, 4, hi8, SP, kNoReg, imm8 * 4);
+  case Thumb::LDRB1:
+    return ThumbTransfer(OpKind::LOAD, 1, lo0, lo3, kNoReg, imm5);
+  case Thumb::STR1:
+    return ThumbTransfer(OpKind::STORE, 4, lo0, lo3, kNoReg, imm5 * 4);
+  case Thumb::STR2:
+    return ThumbTransfer(OpKind::STORE, 4, lo0, lo3, lo6, 0);
+  case Thumb::STR3:
+    return ThumbTransfer(OpKind::STORE, 4, hi8, SP, kNoReg, imm8 * 4);
+  case Thumb::STRB1:
+    return ThumbTransfer(OpKind::STORE, 1, lo0, lo3, kNoReg, imm5);
+  case Thumb::B1: {
+    Op op;
+    op.kind = OpKind::BRANCH;
+    op.cond = GetBitsInRange(instr, 8, 12);
+    op.target = pc + (SignExtend(imm8, 8) << 1);
+    return op;
+  }
+  case Thumb::B2: {
+    Op op;
+    op.kind = OpKind::BRANCH;
+    op.target = pc + (SignExtend(GetBitsInRange(instr, 0, 11), 11) << 1);
+    return op;
+  }
+  case Thumb::BL: {
+    U32 h = GetBitsInRange(instr, 11, 13);
+    U32 offset_11 = GetBitsInRange(instr, 0, 11);
+    if (h == 0b10) {
+      return ThumbAluImm(AluOp::MOV, LR, kNoReg,
+                         pc + (SignExtend(offset_11, 11) << 12), false);
+    } else if (h == 0b11) {
+      Op op;
+      op.kind = OpKind::BRANCH;
+      op.rn = LR;
+      op.target = offset_11 << 1;
+      op.link = (addr + 2) | 0b1;
+      return op;
+    }
+    return Op{};
+  }
+  default:
+    return Op{};
+  }
+}
+
+/// Functions called from compiled code. Jit fills them in since they are its
+/// private members.
+struct Helpers {
+  U32 (*interpret)(CPU *, Memory::Memory *, U32, U32, U32);
+  U32 (*branch)(CPU *, Memory::Memory *, U32, U32, U32);
+  U32 (*condition_passed)(CPU *, U32);
+  void (*set_carry)(CPU *, U32);
+  U32 (*load_word)(CPU *, Memory::Memory *, U32);
+  U32 (*load_aligned_word)(CPU *, Memory::Memory *, U32);
+  U32 (*load_byte)(CPU *, Memory::Memory *, U32);
+  U32 (*store_word)(CPU *, Memory::Memory *, U32, U32);
+  U32 (*store_aligned_word)(CPU *, Memory::Memory *, U32, U32);
+  U32 (*store_byte)(CPU *, Memory::Memory *, U32, U32);
+};
+
+/// Byte offset of a member of `object`.
+template <typename T, typename M> I32 OffsetOf(const T &object, const M &member) {
+  return I32(reinterpret_cast<const U8 *>(&member) -
+             reinterpret_cast<const U8 *>(&object));
+}
+
+/// Emits the native code of one block.
+///
+/// Compiled code runs with rbx = CPU *, r12 = Memory * and the cycle limit at
+/// [rsp]. The guest registers in host_reg_ live in kCacheRegs between
+/// instructions and are written back before anything that can read
+/// CPU::registers.
+class BlockCompiler {
+public:
+  BlockCompiler(const Block &block, const CPU &cpu,
+                const Memory::Memory &memory, const Helpers &helpers)
+      : block_(block), helpers_(helpers) {
+    regs_ = OffsetOf(cpu, cpu.registers.r);
+    cycles_ = OffsetOf(cpu, cpu.cycles);
+    next_access_addr_ = OffsetOf(cpu, cpu.next_access_addr);
+    dispatch_num_ = OffsetOf(cpu, cpu.dispatch_num);
+    idle_ = OffsetOf(cpu, cpu.idle);
+    nz_pending_ = OffsetOf(cpu, cpu.flags.nz_pending);
+    nz_result_ = OffsetOf(cpu, cpu.flags.nz_result);
+    cv_op_ = OffsetOf(cpu, cpu.flags.cv_op);
+    cv_lhs_ = OffsetOf(cpu, cpu.flags.cv_lhs);
+    cv_rhs_ = OffsetOf(cpu, cpu.flags.cv_rhs);
+    cv_carry_ = OffsetOf(cpu, cpu.flags.cv_carry);
+    execute_ = OffsetOf(cpu, cpu.pipeline.execute);
+    execute_addr_ = OffsetOf(cpu, cpu.pipeline.execute_addr);
+    decode_ = OffsetOf(cpu, cpu.pipeline.decode);
+    decode_addr_ = OffsetOf(cpu, cpu.pipeline.decode_addr);
+    fetch_ = OffsetOf(cpu, cpu.pipeline.fetch);
+    fetch_addr_ = OffsetOf(cpu, cpu.pipeline.fetch_addr);
+    execute_opcode_ = OffsetOf(cpu, cpu.pipeline_opcodes.execute);
+    wait_states_ = block.thumb ? OffsetOf(memory, memory.Wait_States.cycles16)
+                               : OffsetOf(memory, memory.Wait_States.cycles32);
+    size_ = block.thumb ? 2 : 4;
+
+    ops_.reserve(block.instrs.size());
+    for (U32 i = 0; i < block.instrs.size(); ++i) {
+      U32 addr = block.start_addr + i * size_;
+      ops_.push_back(block.thumb ? TranslateThumb(addr, block.instrs[i])
+                                 : TranslateArm(addr, block.instrs[i]));
+      internal_cycles_.push_back(cpu.InternalCycles(
+          block.instrs[i].instr, block.instrs[i].opcode, block.thumb));
+    }
+    AllocateRegisters();
+  }
+
+  const std::vector<U8> &Compile() {
+    EmitPrologue();
+    exit_fixups_.resize(ops_.size());
+    for (U32 i = 0; i < ops_.size(); ++i) {
+      bool last = i + 1 == ops_.size();
+      if (ops_[i].kind == OpKind::INTERPRET) {
+        EmitInterpret(i);
+        if (last) {
+          asm_.MovImm(RAX, Jit::kExitEntry);
+          epilogue_fixups_.push_back(asm_.Jmp());
+        }
+        continue;
+      }
+      EmitNative(i);
+      if (last) {
+        exit_fixups_[i].push_back(asm_.Jmp());
+      } else {
+        // Leave for the next event.
+        asm_.Load64(RAX, RBX, cycles_);
+        asm_.Cmp64Mem(RAX, RSP, 0);
+        exit_fixups_[i].push_back(asm_.Jcc(kCondAE));
+      }
+    }
+    for (U32 i = 0; i < ops_.size(); ++i) {
+      if (!exit_fixups_[i].empty()) {
+        for (U32 fixup : exit_fixups_[i]) {
+          asm_.BindHere(fixup);
+        }
+        EmitExit(i);
+      }
+    }
+    for (U32 fixup : epilogue_fixups_) {
+      asm_.BindHere(fixup);
+    }
+    EmitEpilogue();
+    return asm_.code();
+  }
+
+private:
+  U32 Addr(U32 i) const { return block_.start_addr + i * size_; }
+  I32 Reg(U32 guest) const { return regs_ + I32(guest * 4); }
+
+  /// Keeps the most used guest registers of the native instructions in host
+  /// registers.
+  void AllocateRegisters() {
+    std::array<U32, 16> uses{};
+    for (const Op &op : ops_) {
+      if (op.kind == OpKind::INTERPRET) {
+        continue;
+      }
+      for (U32 reg : {op.rd, op.rn, op.rm}) {
+        if (reg < PC) {
+          ++uses[reg];
+        }
+      }
+      if (op.link != kNoReg) {
+        ++uses[LR];
+      }
+    }
+    host_reg_.fill(kNoHostReg);
+    for (U32 host : kCacheRegs) {
+      U32 best = PC;
+      for (U32 guest = 0; guest < PC; ++guest) {
+        if (host_reg_[guest] == kNoHostReg && uses[guest] >= 2 &&
+            (best == PC || uses[guest] > uses[best])) {
+          best = guest;
+        }
+      }
+      if (best == PC) {
+        break;
+      }
+      host_reg_[best] = host;
+      cached_.push_back(best);
+    }
+  }
+
+  void LoadCached() {
+    for (U32 guest : cached_) {
+      asm_.Load32(host_reg_[guest], RBX, Reg(guest));
+    }
+  }
+
+  void SpillCached() {
+    for (U32 guest : cached_) {
+      asm_.Store32(RBX, Reg(guest), host_reg_[guest]);
+    }
+  }
+
+  /// Reads guest register `guest` of instruction `i` into `dst`.
+  void ReadGuest(U32 dst, U32 guest, U32 i) {
+    if (guest == kNoReg) {
+      asm_.MovImm(dst, 0);
+    } else if (guest == PC) {
+      asm_.MovImm(dst, Addr(i) + 2 * size_);
+    } else if (host_reg_[guest] != kNoHostReg) {
+      asm_.Mov(dst, host_reg_[guest]);
+    } else {
+      asm_.Load32(dst, RBX, Reg(guest));
+    }
+  }
+
+  void WriteGuest(U32 guest, U32 src) {
+    if (host_reg_[guest] != kNoHostReg) {
+      asm_.Mov(host_reg_[guest], src);
+    } else {
+      asm_.Store32(RBX, Reg(guest), src);
+    }
+  }
+
+  void WriteGuestImm(U32 guest, U32 imm) {
+    if (host_reg_[guest] != kNoHostReg) {
+      asm_.MovImm(host_reg_[guest], imm);
+    } else {
+      asm_.Store32Imm(RBX, Reg(guest), imm);
+    }
+  }
+
+  void EmitPrologue() {
+    for (U32 reg : {RBX, RBP, R12, R13, R14, R15}) {
+      asm_.Push(reg);
+    }
+    // sub rsp, 8 keeps calls 16 byte aligned and holds the cycle limit.
+    asm_.Byte(0x48);
+    asm_.Byte(0x83);
+    asm_.Byte(0xEC);
+    asm_.Byte(0x08);
+    asm_.Store64(RSP, 0, RDX);
+    asm_.Mov64(RBX, RDI);
+    asm_.Mov64(R12, RSI);
+    asm_.Store8Imm(RBX, idle_, 0);
+    LoadCached();
+  }
+
+  void EmitEpilogue() {
+    // add rsp, 8
+    asm_.Byte(0x48);
+    asm_.Byte(0x83);
+    asm_.Byte(0xC4);
+    asm_.Byte(0x08);
+    for (U32 reg : {R15, R14, R13, R12, RBP, RBX}) {
+      asm_.Pop(reg);
+    }
+    asm_.Ret();
+  }
+
+  /// Leaves the block after instruction `i` completed without branching,
+  /// with the state StepPcOffset would leave.
+  void EmitExit(U32 i) {
+    U32 addr = Addr(i);
+    asm_.Store32Imm(RBX, Reg(PC), addr + size_);
+    asm_.Store32Imm(RBX, execute_, block_.instrs[i].instr);
+    asm_.Store32Imm(RBX, execute_addr_, addr);
+    asm_.Store32Imm(RBX, decode_, U32(-1));
+    asm_.Store32Imm(RBX, decode_addr_, addr + size_);
+    asm_.Store32Imm(RBX, fetch_, U32(-1));
+    asm_.Store32Imm(RBX, fetch_addr_, addr + 2 * size_);
+    asm_.Store16Imm(RBX, execute_opcode_, block_.instrs[i].opcode);
+    SpillCached();
+    asm_.MovImm(RAX, i + 1 == ops_.size() ? Jit::kExitEntry
+                                          : Jit::kExitMidBlock);
+    epilogue_fixups_.push_back(asm_.Jmp());
+  }
+
+  /// Runs instruction `i` in the interpreter and leaves if it asks to.
+  void EmitInterpret(U32 i) {
+    SpillCached();
+    asm_.Mov64(RDI, RBX);
+    asm_.Mov64(RSI, R12);
+    asm_.MovImm(RDX, Addr(i));
+    asm_.MovImm(RCX, block_.instrs[i].instr);
+    asm_.MovImm(R8, U32(block_.instrs[i].opcode) | (U32(block_.thumb) << 16));
+    asm_.Call(reinterpret_cast<const void *>(helpers_.interpret));
+    asm_.Test(RAX, RAX);
+    epilogue_fixups_.push_back(asm_.Jcc(kCondNE));
+    LoadCached();
+  }
+
+  void EmitNative(U32 i) {
+    const Op &op = ops_[i];
+    U32 addr = Addr(i);
+
+    // The fetch, what CountAccess does plus the I cycles.
+    U32 region = (addr >> 24) & 0xF;
+    asm_.LoadU8(RAX, R12, wait_states_ + region);
+    asm_.LoadU8(RCX, R12, wait_states_ + 16 + region);
+    asm_.CmpMem32Imm(RBX, next_access_addr_, addr);
+    asm_.Cmov(kCondE, RAX, RCX);
+    if (internal_cycles_[i] != 0) {
+      asm_.OpImm(kDigitAdd, RAX, internal_cycles_[i]);
+    }
+    asm_.Add64ToMem(RBX, cycles_, RAX);
+    asm_.Store32Imm(RBX, next_access_addr_, addr + size_);
+    if (op.kind != OpKind::BRANCH) {
+      asm_.AddToMem32(RBX, dispatch_num_, 1);
+    }
+
+    U32 skip = kNoFixup;
+    if (op.cond != kCondAL) {
+      asm_.Mov64(RDI, RBX);
+      asm_.MovImm(RSI, op.cond);
+      asm_.Call(reinterpret_cast<const void *>(helpers_.condition_passed));
+      asm_.Test(RAX, RAX);
+      skip = asm_.Jcc(kCondE);
+    }
+
+    switch (op.kind) {
+    case OpKind::ALU:
+      EmitAlu(op, i);
+      break;
+    case OpKind::LOAD:
+    case OpKind::STORE:
+      EmitTransfer(op, i);
+      break;
+    case OpKind::BRANCH:
+      EmitBranch(op, i);
+      break;
+    case OpKind::INTERPRET:
+      ABORT("Interpreted instruction in EmitNative");
+    }
+
+    if (skip != kNoFixup) {
+      asm_.BindHere(skip);
+    }
+    if (op.kind == OpKind::BRANCH) {
+      // Not taken.
+      asm_.AddToMem32(RBX, dispatch_num_, 1);
+    }
+  }
+
+  /// eax = result, ecx = second operand, edx = rn, esi = carry out.
+  void EmitAlu(const Op &op, U32 i) {
+    if (op.operand_imm) {
+      asm_.MovImm(RCX, op.imm);
+    } else {
+      ReadGuest(RCX, op.rm, i);
+      if (op.carry == CarrySource::RM_BIT) {
+        asm_.Mov(RSI, RCX);
+        if (op.carry_bit != 0) {
+          asm_.Shift(kShiftShr, RSI, op.carry_bit);
+        }
+        asm_.OpImm(kDigitAnd, RSI, 1);
+      }
+      EmitShift(op);
+    }
+    bool reads_rn = op.alu != AluOp::MOV && op.alu != AluOp::MVN &&
+                    op.alu != AluOp::NEG;
+    if (reads_rn) {
+      ReadGuest(RDX, op.rn, i);
+    }
+
+    switch (op.alu) {
+    case AluOp::MOV:
+      asm_.Mov(RAX, RCX);
+      break;
+    case AluOp::MVN:
+      asm_.Mov(RAX, RCX);
+      asm_.Not(RAX);
+      break;
+    case AluOp::NEG:
+      asm_.Op(kOpXor, RAX, RAX);
+      asm_.Op(kOpSub, RAX, RCX);
+      break;
+    case AluOp::AND:
+    case AluOp::TST:
+      asm_.Mov(RAX, RDX);
+      asm_.Op(kOpAnd, RAX, RCX);
+      break;
+    case AluOp::EOR:
+    case AluOp::TEQ:
+      asm_.Mov(RAX, RDX);
+      asm_.Op(kOpXor, RAX, RCX);
+      break;
+    case AluOp::ORR:
+      asm_.Mov(RAX, RDX);
+      asm_.Op(kOpOr, RAX, RCX);
+      break;
+    case AluOp::BIC:
+      asm_.Mov(RAX, RCX);
+      asm_.Not(RAX);
+      asm_.Op(kOpAnd, RAX, RDX);
+      break;
+    case AluOp::ADD:
+    case AluOp::CMN:
+      asm_.Mov(RAX, RDX);
+      asm_.Op(kOpAdd, RAX, RCX);
+      break;
+    case AluOp::SUB:
+    case AluOp::CMP:
+      asm_.Mov(RAX, RDX);
+      asm_.Op(kOpSub, RAX, RCX);
+      break;
+    case AluOp::RSB:
+      asm_.Mov(RAX, RCX);
+      asm_.Op(kOpSub, RAX, RDX);
+      break;
+    }
+
+    if (op.rd != kNoReg) {
+      WriteGuest(op.rd, RAX);
+    }
+    if (op.set_nz) {
+      asm_.Store8Imm(RBX, nz_pending_, 1);
+      asm_.Store32(RBX, nz_result_, RAX);
+    }
+    if (op.cv_op != FlagOp::NONE) {
+      asm_.Store8Imm(RBX, cv_op_, U8(op.cv_op));
+      StoreCvSource(cv_lhs_, op.cv_lhs);
+      StoreCvSource(cv_rhs_, op.cv_rhs);
+      asm_.Store32Imm(RBX, cv_carry_, 0);
+    }
+    if (op.carry != CarrySource::KEEP) {
+      if (op.carry == CarrySource::CONST) {
+        asm_.MovImm(RSI, op.carry_bit);
+      }
+      asm_.Mov64(RDI, RBX);
+      asm_.Call(reinterpret_cast<const void *>(helpers_.set_carry));
+    }
+  }
+
+  void EmitShift(const Op &op) {
+    switch (op.shift) {
+    case ShiftOp::LSL:
+      if (op.shift_amount != 0) {
+        asm_.Shift(kShiftShl, RCX, op.shift_amount);
+      }
+      break;
+    case ShiftOp::LSR:
+      if (op.shift_amount == 32) {
+        asm_.Op(kOpXor, RCX, RCX);
+      } else {
+        asm_.Shift(kShiftShr, RCX, op.shift_amount);
+      }
+      break;
+    case ShiftOp::ASR:
+      asm_.Shift(kShiftSar, RCX, std::min<U32>(op.shift_amount, 31));
+      break;
+    case ShiftOp::ROR:
+      asm_.Shift(kShiftRor, RCX, op.shift_amount);
+      break;
+    }
+  }
+
+  void StoreCvSource(I32 disp, CvSource source) {
+    switch (source) {
+    case CvSource::RN:
+      asm_.Store32(RBX, disp, RDX);
+      break;
+    case CvSource::OPERAND:
+      asm_.Store32(RBX, disp, RCX);
+      break;
+    case CvSource::RESULT:
+      asm_.Store32(RBX, disp, RAX);
+      break;
+    case CvSource::ZERO:
+      asm_.Store32Imm(RBX, disp, 0);
+      break;
+    }
+  }
+
+  /// edx = address, ecx = value to store.
+  void EmitTransfer(const Op &op, U32 i) {
+    ReadGuest(RDX, op.rn, i);
+    asm_.Mov(RAX, RDX);
+    if (op.rm != kNoReg) {
+      ReadGuest(RCX, op.rm, i);
+      asm_.Op(kOpAdd, RAX, RCX);
+    } else if (op.offset != 0) {
+      asm_.OpImm(kDigitAdd, RAX, U32(op.offset));
+    }
+    if (op.pre_index) {
+      asm_.Mov(RDX, RAX);
+    }
+    if (op.writeback) {
+      WriteGuest(op.rn, RAX);
+    }
+
+    asm_.Mov64(RDI, RBX);
+    asm_.Mov64(RSI, R12);
+    if (op.kind == OpKind::LOAD) {
+      asm_.Call(reinterpret_cast<const void *>(
+          op.size == 1 ? helpers_.load_byte
+          : op.aligned ? helpers_.load_aligned_word
+                       : helpers_.load_word));
+      WriteGuest(op.rd, RAX);
+      return;
+    }
+    ReadGuest(RCX, op.rd, i);
+    asm_.Call(reinterpret_cast<const void *>(
+        op.size == 1 ? helpers_.store_byte
+        : op.aligned ? helpers_.store_aligned_word
+                     : helpers_.store_word));
+    asm_.Test(RAX, RAX);
+    exit_fixups_[i].push_back(asm_.Jcc(kCondNE));
+  }
+
+  void EmitBranch(const Op &op, U32 i) {
+    if (op.rn == kNoReg) {
+      asm_.MovImm(RCX, op.target);
+    } else {
+      ReadGuest(RCX, op.rn, i);
+      asm_.OpImm(kDigitAdd, RCX, op.target);
+    }
+    if (op.link != kNoReg) {
+      WriteGuestImm(LR, op.link);
+    }
+    SpillCached();
+    asm_.Mov64(RDI, RBX);
+    asm_.Mov64(RSI, R12);
+    asm_.MovImm(RDX, Addr(i));
+    asm_.MovImm(R8, block_.instrs[i].opcode);
+    asm_.Call(reinterpret_cast<const void *>(helpers_.branch));
+    epilogue_fixups_.push_back(asm_.Jmp());
+  }
+
+private:
+  static constexpr U32 kNoFixup = U32(-1);
+
+  const Block &block_;
+  const Helpers &helpers_;
+  U32 size_;
+  std::vector<Op> ops_;
+  std::vector<U32> internal_cycles_;
+  std::array<U32, 16> host_reg_;
+  std::vector<U32> cached_;
+  Assembler asm_;
+  /// Jumps to the exit of each instruction and to the epilogue, which expects
+  /// the Exit in eax.
+  std::vector<std::vector<U32>> exit_fixups_;
+  std::vector<U32> epilogue_fixups_;
+
+  I32 regs_, cycles_, next_access_addr_, dispatch_num_, idle_;
+  I32 nz_pending_, nz_result_, cv_op_, cv_lhs_, cv_rhs_, cv_carry_;
+  I32 execute_, execute_addr_, decode_, decode_addr_, fetch_, fetch_addr_;
+  I32 execute_opcode_;
+  I32 wait_states_;
+};
+
+} // namespace
+
+Jit::Jit() = default;
+
+Jit::~Jit() {
+  if (arena_ != nullptr) {
+    munmap(arena_, kArenaSize);
+  }
+}
+
+bool Jit::Dispatch(CPU &cpu, Memory::Memory &memory) noexcept {
+  CPSR_Register cpsr(cpu.registers.CPSR);
+  Block *block = nullptr;
+  if (at_entry_ && cpu.execution_model == ExecutionModel::PC_OFFSET &&
+      memory.Dma_Pending == 0 && !(memory.Irq_Pending && !cpsr.bits.I)) {
+    bool thumb = cpsr.bits.T;
+    U32 addr = thumb ? cpu.registers.r[PC] & ~1 : U32(cpu.registers.r[PC]);
+    block = cpu.block_cache.Lookup(memory, addr, thumb);
+    if (block != nullptr && block->jit_code == nullptr &&
+        ++block->exec_count >= kCompileThreshold) {
+      block->jit_code = Compile(*block, cpu, memory);
+      if (block->jit_code == nullptr) {
+        // Arena is full. Start over, the blocks hold pointers into it.
+        LOG_VERBOSE("JIT arena full, flushing");
+        arena_used_ = 0;
+        cpu.block_cache.Clear();
+        block = nullptr;
+      }
+    }
+  }
+
+  if (block == nullptr || block->jit_code == nullptr) {
+    StepResult result = cpu.Step(memory, nullptr);
+    at_entry_ = result == StepResult::NOT_SEQUENTIAL;
+    return result != StepResult::STOPPED;
+  }
+
+  entry_generation_ = cpu.block_cache.generation();
+  U32 exit = reinterpret_cast<BlockFn>(block->jit_code)(
+      &cpu, &memory, memory.Events.next_timestamp());
+  at_entry_ = exit == kExitEntry;
+  return exit != kExitStopped;
+}
+
+void *Jit::Compile(const Block &block, const CPU &cpu,
+                   const Memory::Memory &memory) noexcept {
+  static constexpr Helpers kHelpers = {
+      .interpret = &Jit::Interpret,
+      .branch = &Jit::Branch,
+      .condition_passed = &Jit::ConditionPassed,
+      .set_carry = &Jit::SetCarry,
+      .load_word = &Jit::LoadWord,
+      .load_aligned_word = &Jit::LoadAlignedWord,
+      .load_byte = &Jit::LoadByte,
+      .store_word = &Jit::StoreWord,
+      .store_aligned_word = &Jit::StoreAlignedWord,
+      .store_byte = &Jit::StoreByte,
+  };
+  BlockCompiler compiler(block, cpu, memory, kHelpers);
+  return Commit(compiler.Compile());
+}
+
+void *Jit::Commit(const std::vector<U8> &code) noexcept {
+  if (arena_ == nullptr) {
+    // Never writable and executable at the same time. Pages are made
+    // writable only while a block is copied in.
+    void *arena = mmap(nullptr, kArenaSize, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (arena == MAP_FAILED) {
+      ABORT("Could not map JIT arena");
+    }
+    arena_ = static_cast<U8 *>(arena);
+  }
+
+  U32 start = (arena_used_ + 15) & ~15u;
+  if (start + code.size() > kArenaSize) {
+    return nullptr;
+  }
+  U32 page_size = sysconf(_SC_PAGESIZE);
+  U32 first_page = start & ~(page_size - 1);
+  U32 end_page = (start + code.size() + page_size - 1) & ~(page_size - 1);
+  U8 *pages = &arena_[first_page];
+  if (mprotect(pages, end_page - first_page, PROT_READ | PROT_WRITE) != 0) {
+    ABORT("Could not make JIT arena writable");
+  }
+  memcpy(&arena_[start], code.data(), code.size());
+  if (mprotect(pages, end_page - first_page, PROT_READ | PROT_EXEC) != 0) {
+    ABORT("Could not make JIT arena executable");
+  }
+  arena_used_ = start + code.size();
+  return &arena_[start];
+}
+
+bool Jit::MustLeave(const CPU &cpu, const Memory::Memory &memory) noexcept {
+  return cpu.block_cache.generation() != cpu.jit.entry_generation_ ||
+         memory.Dma_Pending != 0 ||
+         (memory.Irq_Pending && !CPSR_Register(cpu.registers.CPSR).bits.I) ||
+         cpu.cycles >= memory.Events.next_timestamp();
+}
+
+U32 Jit::Interpret(CPU *cpu, Memory::Memory *memory, U32 addr, U32 instr,
+                   U32 opcode_and_thumb) noexcept {
+  cpu->registers.r[PC] = addr;
+  const ExpectedFetch expected{
+      .addr = addr,
+      .instr = instr,
+      .opcode = U16(opcode_and_thumb),
+      .thumb = ((opcode_and_thumb >> 16) & 1) != 0,
+      .generation = cpu->jit.entry_generation_,
+  };
+  switch (cpu->StepPcOffset(*memory, &expected)) {
+  case StepResult::STOPPED:
+    return kExitStopped;
+  case StepResult::NOT_SEQUENTIAL:
+    // A branch or exception clears the pipeline, a stale fetch does not.
+    return cpu->pipeline.fetch_addr == U32(-1) ? kExitEntry : kExitMidBlock;
+  case StepResult::SEQUENTIAL:
+    break;
+  }
+  return MustLeave(*cpu, *memory) ? kExitMidBlock : kContinue;
+}
+
+U32 Jit::Branch(CPU *cpu, Memory::Memory *memory, U32 addr, U32 target,
+                U32 opcode) noexcept {
+  // What StepPcOffset does after a branch.
+  bool thumb = CPSR_Register(cpu->registers.CPSR).bits.T;
+  U32 size = thumb ? 2 : 4;
+  cpu->registers.r[PC] = target;
+  cpu->ClearPipeline();
+  cpu->pipeline_opcodes.execute = U16(opcode);
+  if (thumb) {
+    target &= ~1;
+  }
+  cpu->idle = cpu->idle_loops.OnBranch(*memory, addr, target, thumb,
+                                       cpu->block_cache.generation());
+  cpu->CountAccess(*memory, target, size);
+  cpu->CountAccess(*memory, target + size, size);
+  cpu->next_access_addr = target;
+  cpu->dispatch_num++;
+  return kExitEntry;
+}
+
+U32 Jit::ConditionPassed(CPU *cpu, U32 cond) noexcept {
+  return cpu->ConditionPassed(ConditionCode(cond));
+}
+
+void Jit::SetCarry(CPU *cpu, U32 carry) noexcept { cpu->CPSR_SetC(carry); }
+
+U32 Jit::LoadWord(CPU *cpu, Memory::Memory *memory, U32 address) noexcept {
+  cpu->CountAccess(*memory, address, 4);
+  U32 value = Memory::ReadWordFromGBAMemory(*memory, address);
+  U32 rotate = GetBitsInRange(address, 0, 2) * 8;
+  return rotate == 0 ? value : RotateRight(value, rotate);
+}
+
+U32 Jit::LoadAlignedWord(CPU *cpu, Memory::Memory *memory,
+                         U32 address) noexcept {
+  if (GetBitsInRange(address, 0, 2) != 0b00) {
+    ABORT("Bad address: 0x%04X", address);
+  }
+  cpu->CountAccess(*memory, address, 4);
+  return Memory::ReadWordFromGBAMemory(*memory, address);
+}
+
+U32 Jit::LoadByte(CPU *cpu, Memory::Memory *memory, U32 address) noexcept {
+  cpu->CountAccess(*memory, address, 1);
+  return Memory::ReadByteFromGBAMemory(*memory, address);
+}
+
+U32 Jit::StoreWord(CPU *cpu, Memory::Memory *memory, U32 address,
+                   U32 value) noexcept {
+  cpu->CountAccess(*memory, address, 4);
+  Memory::WriteWordToGBAMemory(*memory, address, value);
+  cpu->block_cache.InvalidateWrite(address, 4);
+  return MustLeave(*cpu, *memory) ? kExitMidBlock : kContinue;
+}
+
+U32 Jit::StoreAlignedWord(CPU *cpu, Memory::Memory *memory, U32 address,
+                          U32 value) noexcept {
+  if (GetBitsInRange(address, 0, 2) != 0b00) {
+    ABORT("Bad address: 0x%04X", address);
+  }
+  return StoreWord(cpu, memory, address, value);
+}
+
+U32 Jit::StoreByte(CPU *cpu, Memory::Memory *memory, U32 address,
+                   U32 value) noexcept {
+  cpu->CountAccess(*memory, address, 1);
+  Memory::WriteByteToGBAMemory(*memory, address, U8(value));
+  cpu->block_cache.InvalidateWrite(address, 1);
+  return MustLeave(*cpu, *memory) ? kExitMidBlock : kContinue;
+}
+
+} // namespace Emulator::Arm
+
+#endif
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "block_cache.h"
+#include "datatypes.h"
+#include "memory.h"
+
+#if defined(ENABLE_JIT) && !defined(__x86_64__)
+#error "The JIT backend only supports x86-64 hosts"
+#endif
+
+namespace Emulator::Arm {
+
+struct CPU;
+
+#ifdef ENABLE_JIT
+
+/// x86-64 backend for hot blocks. Data processing with an immediate or an
+/// immediate shifted register operand, word and byte loads and stores with an
+/// immediate offset, and direct branches are translated to native code that
+/// keeps the most used guest registers in host registers for the whole block.
+/// Anything else is run by CPU::StepPcOffset from inside the block.
+///
+/// Compiled blocks only run under ExecutionModel::PC_OFFSET and only from the
+/// first instruction of a block, i.e. after a branch, an exception or the end
+/// of the previous block. They leave at the next scheduled event or once an
+/// IRQ or DMA is pending, and do not write the dispatch log.
+class Jit {
+public:
+  /// Number of entries into a block before it is compiled.
+  static constexpr U32 kCompileThreshold = 32;
+  static constexpr U32 kArenaSize = 16 * 1024 * 1024;
+
+  /// How compiled code leaves its block. The helpers it calls return
+  /// kContinue to stay in the block.
+  enum Exit : U32 {
+    kContinue,
+    /// PC is the first instruction of a block.
+    kExitEntry,
+    /// PC is in the middle of a block.
+    kExitMidBlock,
+    /// An instruction returned false, stop running.
+    kExitStopped,
+  };
+
+  Jit();
+  ~Jit();
+
+  Jit(const Jit &) = delete;
+  Jit &operator=(const Jit &) = delete;
+
+  /// Runs the block at PC if it is compiled, compiling it once it is hot.
+  /// Otherwise runs a single interpreter step.
+  [[nodiscard]] bool Dispatch(CPU &cpu, Memory::Memory &memory) noexcept;
+
+private:
+  /// Returns an Exit other than kContinue.
+  using BlockFn = U32 (*)(CPU *cpu, Memory::Memory *memory, U64 cycle_limit);
+
+  void *Compile(const Block &block, const CPU &cpu,
+                const Memory::Memory &memory) noexcept;
+  /// Copies `code` into the arena and makes it executable. Returns nullptr if
+  /// the arena is full.
+  void *Commit(const std::vector<U8> &code) noexcept;
+
+  /// Something has to run between instructions that compiled code does not
+  /// check for: an event, IRQ, DMA or a write to decoded code.
+  static bool MustLeave(const CPU &cpu, const Memory::Memory &memory) noexcept;
+
+  // Called from compiled code.
+  static U32 Interpret(CPU *cpu, Memory::Memory *memory, U32 addr, U32 instr,
+                       U32 opcode_and_thumb) noexcept;
+  static U32 Branch(CPU *cpu, Memory::Memory *memory, U32 addr, U32 target,
+                    U32 opcode) noexcept;
+  static U32 ConditionPassed(CPU *cpu, U32 cond) noexcept;
+  static void SetCarry(CPU *cpu, U32 carry) noexcept;
+  static U32 LoadWord(CPU *cpu, Memory::Memory *memory, U32 address) noexcept;
+  static U32 LoadAlignedWord(CPU *cpu, Memory::Memory *memory,
+                             U32 address) noexcept;
+  static U32 LoadByte(CPU *cpu, Memory::Memory *memory, U32 address) noexcept;
+  static U32 StoreWord(CPU *cpu, Memory::Memory *memory, U32 address,
+                       U32 value) noexcept;
+  static U32 StoreAlignedWord(CPU *cpu, Memory::Memory *memory, U32 address,
+                              U32 value) noexcept;
+  static U32 StoreByte(CPU *cpu, Memory::Memory *memory, U32 address,
+                       U32 value) noexcept;
+
+  U8 *arena_ = nullptr;
+  U32 arena_used_ = 0;
+  /// Block cache generation when the running block was entered.
+  U32 entry_generation_ = 0;
+  /// PC is the first instruction of a block, so a compiled block may run.
+  bool at_entry_ = true;
+};
+
+#endif
+
+} // namespace Emulator::Arm
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "arm7tdmi.h"
+#include "hardware_events.h"
+#include "memory.h"
+
+using namespace Emulator;
+
+namespace {
+
+// Hot arm and thumb loops with loads, stores, BL and BX between the two
+// states, interrupted by a timer 0 IRQ.
+constexpr U32 kArmProgram[] = {
+    0xEA00000A, // 00: b start
+    0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+    0xE3A0C301, // 18: mov r12, #0x04000000
+    0xE28CCC02, //     add r12, r12, #0x200
+    0xE3A0B008, //     mov r11, #8
+    0xE1CCB0B2, //     strh r11, [r12, #2]
+    0xE28AA001, //     add r10, r10, #1
+    0xE25EF004, //     subs pc, lr, #4
+    0xE3A00301, // 30: start: mov r0, #0x04000000
+    0xE2802C01, //     add r2, r0, #0x100
+    0xE3A01A0F, //     mov r1, #0xF000
+    0xE1C210B0, //     strh r1, [r2]
+    0xE3A010C0, //     mov r1, #0xC0
+    0xE1C210B2, //     strh r1, [r2, #2]
+    0xE2802C02, //     add r2, r0, #0x200
+    0xE3A01008, //     mov r1, #8
+    0xE1C210B0, //     strh r1, [r2]
+    0xE3A01001, //     mov r1, #1
+    0xE1C210B8, //     strh r1, [r2, #8]
+    0xE321F01F, //     msr cpsr_c, #0x1F
+    0xE3A03403, //     mov r3, #0x03000000
+    0xE3A04000, //     mov r4, #0
+    0xE3A05028, // 68: outer: mov r5, #40
+    0xE5936004, // 6c: arm_loop: ldr r6, [r3, #4]
+    0xE0866105, //     add r6, r6, r5, lsl #2
+    0xE0267005, //     eor r7, r6, r5
+    0xE5836004, //     str r6, [r3, #4]
+    0xE7C37005, //     strb r7, [r3, r5]
+    0xEB000003, //     bl sub
+    0xE2555001, //     subs r5, r5, #1
+    0x1AFFFFF7, //     bne arm_loop
+    0xE28F001D, //     add r0, pc, #29 (thumb_code + 1)
+    0xE12FFF10, //     bx r0
+    0xE20680FF, // 94: sub: and r8, r6, #0xFF
+    0xE1899008, //     orr r9, r9, r8
+    0xE1A0F00E, //     mov pc, lr
+    0xE2844001, // a0: arm_back: add r4, r4, #1
+    0xE3540FFA, //     cmp r4, #1000
+    0xBAFFFFEE, //     blt outer
+    0xEAFFFFFE, //     b .
+};
+
+constexpr U16 kThumbProgram[] = {
+    0x2528, // b0: thumb_code: mov r5, #40
+    0x689E, // b2: t_loop: ldr r6, [r3, #8]
+    0x1976, //     add r6, r6, r5
+    0x00F7, //     lsl r7, r6, #3
+    0x609E, //     str r6, [r3, #8]
+    0x2E80, //     cmp r6, #0x80
+    0xD800, //     bhi t_skip
+    0x3701, //     add r7, #1
+    0xF000, // c0: t_skip: bl t_sub
+    0xF804, //
+    0x3D01, //     sub r5, #1
+    0xD1F4, //     bne t_loop
+    0x4801, //     ldr r0, =arm_back
+    0x4700, //     bx r0
+    0x407E, // cc: t_sub: eor r6, r7
+    0x4770, //     bx lr
+    0x00A0, // d0: .word arm_back
+    0x0000,
+};
+
+struct Run {
+  Arm::CPU *cpu;
+  Memory::Memory *memory;
+};
+
+Run RunProgram(bool jit, U64 end) {
+  Memory::Memory *memory = new Memory::Memory();
+  memcpy(memory->BIOS, kArmProgram, sizeof(kArmProgram));
+  memcpy(memory->BIOS + sizeof(kArmProgram), kThumbProgram,
+         sizeof(kThumbProgram));
+  Arm::CPU *cpu = new Arm::CPU();
+  cpu->reset();
+  Memory::Reset(*memory);
+  Events::Reset(*memory, 0);
+  cpu->execution_model = Arm::ExecutionModel::PC_OFFSET;
+  cpu->jit_enabled = jit;
+
+  // Same loop as CpuRunner::RunUntil.
+  while (cpu->cycles < end) {
+    bool ok = cpu->Dispatch(*memory);
+    assert(ok);
+    if (cpu->idle) {
+      cpu->cycles = std::max(
+          cpu->cycles, std::min(memory->Events.next_timestamp(), end));
+    }
+    if (cpu->cycles >= memory->Events.next_timestamp()) {
+      Events::RunDueEvents(*memory, cpu->cycles);
+    }
+  }
+  cpu->PrepareSnapshot(*memory);
+  return Run{cpu, memory};
+}
+
+} // namespace
+
+int main() {
+  static_assert(sizeof(kArmProgram) == 0xB0);
+
+  // Compiled blocks give the same state as the interpreter at every event
+  // boundary, including ones that land inside a block or an IRQ handler.
+  for (U64 lines : {1, 7, 33, 161, 400}) {
+    U64 end = lines * Events::kScanlineCycles;
+    Run interpreter = RunProgram(false, end);
+    Run jit = RunProgram(true, end);
+
+    assert(memcmp(&interpreter.cpu->all_registers, &jit.cpu->all_registers,
+                  sizeof(interpreter.cpu->all_registers)) == 0);
+    assert(interpreter.cpu->cycles == jit.cpu->cycles);
+    assert(interpreter.cpu->dispatch_num == jit.cpu->dispatch_num);
+    assert(memcmp(interpreter.memory->WRAM_OnChip, jit.memory->WRAM_OnChip,
+                  sizeof(jit.memory->WRAM_OnChip)) == 0);
+    assert(memcmp(interpreter.memory->IO_Registers, jit.memory->IO_Registers,
+                  sizeof(jit.memory->IO_Registers)) == 0);
+    if (lines == 400) {
+      // The loops and the IRQ handler both ran.
+      assert(jit.cpu->all_registers.r[4] != 0);
+      assert(jit.cpu->all_registers.r[10] != 0);
+    }
+
+    delete interpreter.cpu;
+    delete jit.cpu;
+    delete interpreter.memory;
+    delete jit.memory;
+  }
+  return 0;
+}
@@ -1,5 +1,6 @@
 // DispatchLogger.cpp
 #include "logger.h"
+#include <cstring>
 #include <fstream>
 
 namespace Emulator::DispatchLogger {
@@ -40,6 +41,12 @@ void LOG_MOV(U32 rd, U32 value) {
   Logger.log_type_end_idx = (Logger.log_type_end_idx + 1) % kMaxLogs;
 }
 
+void Reset() {
+  Logger.log_type_end_idx = 0;
+  memset(Logger.log_type, 0, sizeof(Logger.log_type));
+  memset(Logger.raw_data, 0, sizeof(Logger.raw_data));
+}
+
 void DUMP_LOGS() {
   std::ofstream outFile("/tmp/gba_log_dumper", std::ios::binary);
   if (!outFile)
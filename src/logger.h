@@ -45,5 +45,7 @@ void LOG_STORE(U32 addr, U32 value);
 void LOG_LOAD(U32 addr, U32 value);
 void LOG_MOV(U32 rd, U32 value);
 void DUMP_LOGS();
+/// Empties Logger, like a fresh start.
+void Reset();
 
 } // namespace Emulator::DispatchLogger
\ No newline at end of file
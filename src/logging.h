@@ -3,6 +3,7 @@
 #include <cstdlib>
 #include <stdio.h>
 
+#include "access_histogram.h"
 #include "logger.h"
 
 #define LOG(fmt, ...)                                                          \
@@ -20,4 +21,5 @@
 #define ABORT(fmt, ...)                                                        \
   LOG(fmt, ##__VA_ARGS__);                                                     \
   Emulator::DispatchLogger::DUMP_LOGS();                                       \
+  DUMP_ACCESS_HISTOGRAM();                                                     \
   std::abort();
\ No newline at end of file
@@ -2,7 +2,11 @@
 
 #include "datatypes.h"
 #include "logging.h"
+#include "scheduler.h"
+#include "wait_states.h"
+#include <array>
 #include <assert.h>
+#include <cstddef>
 #include <cstring>
 
 namespace Emulator::Memory
@@ -39,6 +43,28 @@ union DMA_CNT_H {
   operator U32() const { return value; } // Implicit conversion
 };
 
+/// DMA_CNT_H::tm, when an enabled channel starts.
+enum class DmaTiming : U16 { IMMEDIATE, VBLANK, HBLANK, SPECIAL };
+
+/// DMA 0 Control. Channel n is at DMA0CNT_H + 12 * n.
+constexpr U32 DMA0CNT_H = 0x040000BA;
+
+/// General LCD Status (STAT,LYC)
+constexpr U32 DISPSTAT = 0x04000004;
+
+/// Vertical Counter (LY)
+constexpr U32 VCOUNT = 0x04000006;
+
+/// Timer 0 Counter/Reload. Timer n is at TM0CNT_L + 4 * n, its control at
+/// TM0CNT_L + 4 * n + 2.
+constexpr U32 TM0CNT_L = 0x04000100;
+
+/// Key Status. A key's bit is 0 while it is pressed.
+constexpr U32 KEYINPUT = 0x04000130;
+
+/// A, B, Select, Start, Right, Left, Up, Down, R and L, in KEYINPUT order.
+constexpr U16 kAllKeys = 0x3FF;
+
 /// Interrupt Master Enable Register
 constexpr U32 IME = 0x4000208;
 
@@ -48,94 +74,363 @@ constexpr U32 IE = 0x04000200;
 /// Interrupt Request Flags / IRQ Ack Register
 constexpr U32 IF = 0x4000202;
 
+/// IE and IF bits.
+constexpr U16 kIrqVBlank = 1 << 0;
+constexpr U16 kIrqHBlank = 1 << 1;
+constexpr U16 kIrqVCount = 1 << 2;
+/// Timer n is kIrqTimer0 << n.
+constexpr U16 kIrqTimer0 = 1 << 3;
+/// DMA n is kIrqDma0 << n.
+constexpr U16 kIrqDma0 = 1 << 8;
+
+struct DmaChannel {
+  U32 SAD;   // Source Address
+  U32 DAD;   // Destination Address
+  U16 CNT_L; // Word Count, see DMA_CNT_L
+  U16 CNT_H; // Control, see DMA_CNT_H
+};
+
+/// A channel's internal registers. SAD, DAD and CNT_L are copied here when
+/// the channel is enabled, and a repeating channel carries on from where its
+/// last transfer stopped.
+struct DmaInternal {
+  U32 src = 0;
+  U32 dst = 0;
+  U32 count = 0;
+};
+
+struct Timer {
+  U16 CNT_L; // Counter/Reload
+  U16 CNT_H; // Control
+};
+
+/// The I/O page with the registers the emulator uses by name. Overlays
+/// Memory::IO_Registers, so bus accesses and fields see the same bytes.
+struct IoRegisters {
+  U16 DISPCNT;              // 04000000   LCD Control
+  U16 GreenSwap;            // 04000002   Undocumented - Green Swap
+  U16 DISPSTAT;             // 04000004   General LCD Status
+  U16 VCOUNT;               // 04000006   Vertical Counter (LY)
+  U8 Display[0x58];         // 04000008-0400005F   BG, Window and Effects
+  U8 Sound[0x50];           // 04000060-040000AF   Sound
+  DmaChannel DMA[4];        // 040000B0-040000DF   DMA 0-3
+  U8 Unused_0E0[0x20];      // 040000E0-040000FF
+  Timer TM[4];              // 04000100-0400010F   Timer 0-3
+  U8 Serial_110[0x20];      // 04000110-0400012F   Serial
+  U16 KEYINPUT;             // 04000130   Key Status
+  U16 KEYCNT;               // 04000132   Key Interrupt Control
+  U8 Serial_134[0xCC];      // 04000134-040001FF   Serial
+  U16 IE;                   // 04000200   Interrupt Enable
+  U16 IF;                   // 04000202   Interrupt Request Flags
+  U16 WAITCNT;              // 04000204   Game Pak Waitstate Control
+  U16 Unused_206;           // 04000206
+  U16 IME;                  // 04000208   Interrupt Master Enable
+  U8 Unused_20A[0xF6];      // 0400020A-040002FF
+  U8 POSTFLG;               // 04000300   Post Boot Flag
+  U8 HALTCNT;               // 04000301   Power Down Control
+  U8 Unused_302[0xFCFE];    // 04000302-0400FFFF
+};
+
+static_assert(sizeof(IoRegisters) == 0x10000);
+static_assert(offsetof(IoRegisters, VCOUNT) == 0x006);
+static_assert(offsetof(IoRegisters, DMA) == 0x0B0);
+static_assert(sizeof(DmaChannel) == 12);
+static_assert(offsetof(IoRegisters, TM) == 0x100);
+static_assert(offsetof(IoRegisters, KEYINPUT) == 0x130);
+static_assert(offsetof(IoRegisters, IE) == 0x200);
+static_assert(offsetof(IoRegisters, IME) == 0x208);
+static_assert(offsetof(IoRegisters, POSTFLG) == 0x300);
+
+/// One bit per block of memory that was written.
+template <U32 kNumBlocks> struct DirtyBitmap {
+  std::array<U64, (kNumBlocks + 63) / 64> words{};
+
+  void Mark(U32 block) noexcept {
+    // A store at the end of a region can run past it.
+    if (block < kNumBlocks) {
+      words[block / 64] |= U64(1) << (block % 64);
+    }
+  }
+  void MarkRange(U32 first, U32 last) noexcept {
+    for (U32 block = first; block <= last; ++block) {
+      Mark(block);
+    }
+  }
+  bool Test(U32 block) const noexcept {
+    return (words[block / 64] >> (block % 64)) & 1;
+  }
+  bool Any() const noexcept {
+    for (U64 word : words) {
+      if (word != 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+  void MarkAll() noexcept {
+    words.fill(~U64(0));
+    if (kNumBlocks % 64 != 0) {
+      words.back() = (U64(1) << (kNumBlocks % 64)) - 1;
+    }
+  }
+  void Clear() noexcept { words.fill(0); }
+};
+
+/// What a renderer has to decode again. Written by the store path, read and
+/// cleared by the renderer once per frame.
+struct DisplayDirty {
+  static constexpr U32 kVramBlockSize = 0x400;   // 1 KB, 32 4bpp tiles
+  static constexpr U32 kOamEntrySize = 8;        // One OBJ's attributes
+  static constexpr U32 kPaletteEntrySize = 2;    // One colour
+
+  DirtyBitmap<0x18000 / kVramBlockSize> VRAM;
+  DirtyBitmap<0x400 / kOamEntrySize> OAM;
+  DirtyBitmap<0x400 / kPaletteEntrySize> PaletteRAM;
+
+  void MarkAll() noexcept {
+    VRAM.MarkAll();
+    OAM.MarkAll();
+    PaletteRAM.MarkAll();
+  }
+  void Clear() noexcept {
+    VRAM.Clear();
+    OAM.Clear();
+    PaletteRAM.Clear();
+  }
+};
+
 struct Memory {
   // General Internal Memory
   U8 BIOS[0x4000];          // 00000000-00003FFF   BIOS - System ROM (16 KB)
   U8 WRAM_OnBoard[0x40000]; // 02000000-0203FFFF   On-board Work RAM (256 KB)
-  U8 WRAM_OnChip[0x8000];   // 03000000-03007FFF   On-chip Work RAM (32 KB)
-  U8 IO_Registers[0x10000]; // 04000000-040003FE   I/O Registers (read/write
-                            // as 16-bit). Repeats every 64K
+  // IWRAM and the I/O block are the hottest data, keep them cache line
+  // aligned. Both already fall on a 64 byte boundary, so this does not move
+  // anything the snapshot tools rely on.
+  alignas(64) U8 WRAM_OnChip[0x8000]; // 03000000-03007FFF   On-chip Work RAM (32 KB)
+  union alignas(64) {
+    U8 IO_Registers[0x10000]; // 04000000-040003FE   I/O Registers
+                              // (read/write as 16-bit). Repeats every 64K
+    IoRegisters Io;
+  };
   // Internal Display Memory
   U8 PaletteRAM[0x400]; // 05000000-050003FF   BG/OBJ Palette RAM (1 KB)
   U8 VRAM[0x18000];     // 06000000-06017FFF   VRAM (96 KB)
   U8 OAM[0x400];        // 07000000-070003FF   OBJ Attributes (1 KB)
 
   // External Memory (Game Pak)
-  U8 GamePak_WS0[0x2000000]; // 08000000-09FFFFFF   Game Pak ROM/Flash -
-                             // Wait State 0
-  U8 GamePak_WS1[0x2000000]; // 0A000000-0BFFFFFF   Game Pak ROM/Flash -
-                             // Wait State 1
-  U8 GamePak_WS2[0x2000000]; // 0C000000-0DFFFFFF   Game Pak ROM/Flash -
-                             // Wait State 2
-
   U8 GamePak_SRAM[0x10000]; // 0E000000-0E00FFFF   Game Pak SRAM (64 KB)
 
   // List of mystery addresses
   // 0x4000410 -> 0. (https://www.chibialiens.com/arm/gba.php?noui=1)
   U8 Mystery_Addresses[0x1];
+
+  // Game Pak ROM, mapped by LoadGamePak. 08000000-09FFFFFF (Wait State 0),
+  // 0A000000-0BFFFFFF (Wait State 1) and 0C000000-0DFFFFFF (Wait State 2)
+  // are all views of it. Reads past GamePak_Size are open bus.
+  const U8 *GamePak = nullptr;
+  U32 GamePak_Size = 0;
+
+  // Blocks of PaletteRAM, VRAM and OAM written since the renderer last
+  // cleared them.
+  DisplayDirty Display_Dirty;
+
+  // Access timings for the current WAITCNT.
+  WaitStates Wait_States = BuildWaitStates(0);
+
+  // IME is set and IE & IF is not 0. Kept up to date by the IE, IF and IME
+  // write handlers, so the CPU only has to check it and CPSR.I.
+  bool Irq_Pending = false;
+
+  // Values written to TMxCNT_L. TMxCNT_L itself holds the counter, which
+  // is loaded from here when the timer starts or overflows.
+  U16 Timer_Reload[4] = {};
+  // Cycle a running timer's counter was 0 at, counting back from when it
+  // was loaded, and the cycles per tick it was loaded with. 0 cycles per
+  // tick for count-up timers, which only move when the previous timer
+  // overflows.
+  U64 Timer_Start[4] = {};
+  U32 Timer_Prescale[4] = {};
+  // Bit n is set while timer n runs.
+  U8 Timers_Running = 0;
+  // The CPU's cycle count, read by the timer counters. Set by the owner of
+  // the CPU, the counters hold their last loaded value while it is null.
+  const U64 *Cycles = nullptr;
+
+  // Bit n is set when DMA channel n has been triggered and has to run
+  // before the next instruction.
+  U8 Dma_Pending = 0;
+  // Latched by WriteDmaControl, advanced by the transfers.
+  DmaInternal Dma_Internal[4];
+
+  // Display, timer and DMA events, driven by the runner. See
+  // hardware_events.h.
+  Events::Scheduler Events;
 };
 
-inline const U8 *GetPhysicalMemoryReadOnly(const Memory &mem,
-                                           U32 address) noexcept {
-  if (address < 0x00004000) {
-    return &mem.BIOS[address - 0x00000000];
-  } else if (address >= 0x02000000 && address < 0x02040000) {
-    return &mem.WRAM_OnBoard[address - 0x02000000];
-  } else if (address >= 0x03000000 && address < 0x04000000) {
-    return &mem.WRAM_OnChip[address & 0x7FFF];
+static_assert(offsetof(Memory, WRAM_OnChip) == 0x44000);
+static_assert(offsetof(Memory, IO_Registers) == 0x4C000);
+
+/// Largest Game Pak ROM, the size of one wait state region.
+constexpr U32 kGamePakMaxSize = 0x2000000;
+
+/// Game Pak open bus. Reading ROM past its end returns the halfword address
+/// (address / 2), so halfword i of the pattern is i. Has 4 extra bytes so a
+/// word read at the end does not run off.
+constexpr U32 kOpenBusSize = 0x20000;
+
+constexpr std::array<U8, kOpenBusSize + 4> BuildOpenBus() {
+  std::array<U8, kOpenBusSize + 4> bytes{};
+  for (U32 i = 0; i < kOpenBusSize / 2; ++i) {
+    bytes[2 * i] = U8(i);
+    bytes[2 * i + 1] = U8(i >> 8);
+  }
+  return bytes;
+}
+
+inline constexpr std::array<U8, kOpenBusSize + 4> GamePakOpenBus =
+    BuildOpenBus();
+
+/// One 16 MB page of the address space. An address maps to
+/// `offset + (address & mask)`, into Memory if that is below `end`, or into
+/// Memory::GamePak if it is below GamePak_Size for Game Pak pages. Anything
+/// else is I/O, open bus or unmapped and goes through the slow path.
+struct MemoryPage {
+  U32 offset = 0;
+  U32 mask = 0;
+  U32 end = 0;
+  bool game_pak = false;
+};
+
+constexpr U32 kPageShift = 24;
+constexpr U32 kNumPages = 1 << (32 - kPageShift);
+
+using PageTable = std::array<MemoryPage, kNumPages>;
+
+constexpr PageTable BuildPageTable(bool write) {
+  PageTable pages{};
+  auto map = [&pages](U32 start, U32 offset, U32 mask, U32 size) {
+    pages[start >> kPageShift] = {offset, mask, offset + size, false};
+  };
+  constexpr U32 kPageMask = (1 << kPageShift) - 1;
+  map(0x00000000, offsetof(Memory, BIOS), kPageMask, sizeof(Memory::BIOS));
+  map(0x02000000, offsetof(Memory, WRAM_OnBoard), kPageMask,
+      sizeof(Memory::WRAM_OnBoard));
+  // Mirrored every 32 KB.
+  map(0x03000000, offsetof(Memory, WRAM_OnChip), 0x7FFF,
+      sizeof(Memory::WRAM_OnChip));
+  map(0x05000000, offsetof(Memory, PaletteRAM), kPageMask,
+      sizeof(Memory::PaletteRAM));
+  map(0x06000000, offsetof(Memory, VRAM), kPageMask, sizeof(Memory::VRAM));
+  // Reads are mirrored every 1 KB, writes are not.
+  map(0x07000000, offsetof(Memory, OAM), write ? kPageMask : 0x3FF,
+      sizeof(Memory::OAM));
+  // Each wait state region spans two pages. ROM is read only, so writes go
+  // to the slow path.
+  if (!write) {
+    for (U32 start = 0x08000000; start < 0x0E000000; start += 1 << kPageShift) {
+      pages[start >> kPageShift] = {start & (kGamePakMaxSize - 1), kPageMask,
+                                    0, true};
+    }
+  }
+  map(0x0E000000, offsetof(Memory, GamePak_SRAM), kPageMask,
+      sizeof(Memory::GamePak_SRAM));
+  return pages;
+}
+
+constexpr PageTable ReadPages = BuildPageTable(false);
+constexpr PageTable WritePages = BuildPageTable(true);
+
+/// I/O registers and addresses outside the page table.
+inline U8 *GetSpecialMemory(const Memory &mem, U32 address) noexcept {
+  if (address >= 0x08000000 && address < 0x0E000000) {
+    // Past the end of the ROM. Writes land in a copy of the pattern, ROM
+    // ignores them.
+    static std::array<U8, 4> ignored;
+    ignored = {GamePakOpenBus[address & (kOpenBusSize - 1)],
+               GamePakOpenBus[(address & (kOpenBusSize - 1)) + 1],
+               GamePakOpenBus[(address & (kOpenBusSize - 1)) + 2],
+               GamePakOpenBus[(address & (kOpenBusSize - 1)) + 3]};
+    return ignored.data();
   } else if (address >= 0x04000000 && address < 0x040003FE) {
-    return &((U8 *)mem.IO_Registers)[address - 0x04000000];
-  } else if (address >= 0x05000000 && address < 0x05000400) {
-    return &((U8 *)mem.PaletteRAM)[address - 0x05000000];
-  } else if (address >= 0x06000000 && address < 0x06018000) {
-    return &((U8 *)mem.VRAM)[address - 0x06000000];
-  } else if (address >= 0x07000000 && address < 0x08000000) {
-    return &((U8 *)mem.OAM)[address & 0x3FF];
-  } else if (address >= 0x08000000 && address < 0x0A000000) {
-    return &mem.GamePak_WS0[address - 0x08000000];
-  } else if (address >= 0x0A000000 && address < 0x0C000000) {
-    return &mem.GamePak_WS1[address - 0x0A000000];
-  } else if (address >= 0x0C000000 && address < 0x0E000000) {
-    return &mem.GamePak_WS2[address - 0x0C000000];
-  } else if (address >= 0x0E000000 && address < 0x0E010000) {
-    return &mem.GamePak_SRAM[address - 0x0E000000];
+    return const_cast<U8 *>(&mem.IO_Registers[address - 0x04000000]);
   } else if (address == 0x04000410) {
-    return &mem.Mystery_Addresses[0];
+    return const_cast<U8 *>(&mem.Mystery_Addresses[0]);
   } else {
     // Out of bounds or unused memory
     ABORT("Invalid memory address: 0x%04X", address);
   }
 }
 
+/// Counter of timer `n` at cycle `now`. A running clocked timer counts up
+/// from where it was loaded. It holds 0xFFFF from its overflow until the
+/// overflow event reloads it, at the end of the instruction that crossed it.
+inline U16 TimerCounter(const Memory &mem, U32 n, U64 now) noexcept {
+  U32 prescale = mem.Timer_Prescale[n];
+  if (!(mem.Timers_Running & (1 << n)) || prescale == 0) {
+    return mem.Io.TM[n].CNT_L;
+  }
+  U64 ticks = (now - mem.Timer_Start[n]) / prescale;
+  return ticks < 0xFFFF ? U16(ticks) : 0xFFFF;
+}
+
+inline const U8 *GetPhysicalMemoryReadOnly(const Memory &mem,
+                                           U32 address) noexcept {
+  const MemoryPage &page = ReadPages[address >> kPageShift];
+  U32 offset = page.offset + (address & page.mask);
+  if (page.game_pak) {
+    if (offset < mem.GamePak_Size) [[likely]] {
+      return mem.GamePak + offset;
+    }
+  } else if (offset < page.end) [[likely]] {
+    return reinterpret_cast<const U8 *>(&mem) + offset;
+  }
+  if (address - TM0CNT_L < 16 && mem.Cycles != nullptr) [[unlikely]] {
+    // The counters are not stored as they tick, bring this one up to date.
+    U32 n = (address - TM0CNT_L) / 4;
+    const_cast<Memory &>(mem).Io.TM[n].CNT_L =
+        TimerCounter(mem, n, *mem.Cycles);
+  }
+  return GetSpecialMemory(mem, address);
+}
+
 inline U8 *GetPhysicalMemoryReadWrite(Memory &mem, U32 address) noexcept {
-  if (address < 0x00004000) {
-    return &mem.BIOS[address - 0x00000000];
-  } else if (address >= 0x02000000 && address < 0x02040000) {
-    return &mem.WRAM_OnBoard[address - 0x02000000];
-  } else if (address >= 0x03000000 && address < 0x04000000) {
-    return &mem.WRAM_OnChip[address & 0x7FFF];
-  } else if (address >= 0x04000000 && address < 0x040003FE) {
-    return &((U8 *)mem.IO_Registers)[address - 0x04000000];
-  } else if (address >= 0x05000000 && address < 0x05000400) {
-    return &((U8 *)mem.PaletteRAM)[address - 0x05000000];
-  } else if (address >= 0x06000000 && address < 0x06018000) {
-    return &((U8 *)mem.VRAM)[address - 0x06000000];
-  } else if (address >= 0x07000000 && address < 0x07000400) {
-    return &((U8 *)mem.OAM)[address - 0x07000000];
-  } else if (address >= 0x08000000 && address < 0x0A000000) {
-    return &mem.GamePak_WS0[address - 0x08000000];
-  } else if (address >= 0x0A000000 && address < 0x0C000000) {
-    return &mem.GamePak_WS1[address - 0x0A000000];
-  } else if (address >= 0x0C000000 && address < 0x0E000000) {
-    return &mem.GamePak_WS2[address - 0x0C000000];
-  } else if (address >= 0x0E000000 && address < 0x0E010000) {
-    return &mem.GamePak_SRAM[address - 0x0E000000];
-  } else if (address == 0x4000410) {
-    return &mem.Mystery_Addresses[0];
-  } else {
-    // Out of bounds or unused memory
-    ABORT("Invalid memory address: 0x%04X", address);
+  const MemoryPage &page = WritePages[address >> kPageShift];
+  U32 offset = page.offset + (address & page.mask);
+  if (offset < page.end) [[likely]] {
+    return reinterpret_cast<U8 *>(&mem) + offset;
+  }
+  return GetSpecialMemory(mem, address);
+}
+
+/// Host memory backing the `size` bytes at `address`, or nullptr if they are
+/// not one contiguous run of RAM or ROM, e.g. I/O, a mirror boundary or past
+/// the end of the ROM.
+inline const U8 *GetPhysicalRangeReadOnly(const Memory &mem, U32 address,
+                                          U32 size) noexcept {
+  const MemoryPage &page = ReadPages[address >> kPageShift];
+  U32 local = address & page.mask;
+  if (size == 0 || size - 1 > page.mask - local) {
+    return nullptr;
   }
+  U64 offset = U64(page.offset) + local;
+  if (page.game_pak) {
+    return offset + size <= mem.GamePak_Size ? mem.GamePak + offset : nullptr;
+  }
+  return offset + size <= page.end
+             ? reinterpret_cast<const U8 *>(&mem) + offset
+             : nullptr;
+}
+
+inline U8 *GetPhysicalRangeReadWrite(Memory &mem, U32 address,
+                                     U32 size) noexcept {
+  const MemoryPage &page = WritePages[address >> kPageShift];
+  U32 local = address & page.mask;
+  if (size == 0 || size - 1 > page.mask - local) {
+    return nullptr;
+  }
+  U64 offset = U64(page.offset) + local;
+  return offset + size <= page.end ? reinterpret_cast<U8 *>(&mem) + offset
+                                   : nullptr;
 }
 
 inline U8 ReadByteFromGBAMemory(const Memory &mem, U32 address) noexcept {
@@ -156,42 +451,251 @@ inline U16 ReadHalfWordFromGBAMemory(const Memory &mem, U32 address) noexcept {
   return value;
 }
 
+/// Start of the I/O page and the number of halfword registers in it,
+/// 04000000-040003FE.
+constexpr U32 kIoBase = 0x04000000;
+constexpr U32 kNumIoHalfWords = 0x400 / 2;
+
+/// Handles a store to the I/O halfword at `address`. `mask` has the bytes
+/// being written, 0x00FF, 0xFF00 or 0xFFFF, and `value` is in place.
+using IoWriteHandler = void (*)(Memory &mem, U32 address, U16 value,
+                                U16 mask) noexcept;
+
+/// Stores the masked bytes as they are.
+inline void WriteIoDefault(Memory &mem, U32 address, U16 value,
+                           U16 mask) noexcept {
+  U32 byte = mask == 0xFF00;
+  U8 *dest = address - kIoBase < 2 * kNumIoHalfWords
+                 ? &mem.IO_Registers[address - kIoBase + byte]
+                 : GetPhysicalMemoryReadWrite(mem, address + byte);
+  if (mask == 0xFFFF) {
+    memcpy(dest, &value, sizeof(value));
+  } else {
+    U8 byte_value = value >> (8 * byte);
+    memcpy(dest, &byte_value, sizeof(byte_value));
+  }
+}
+
+inline void UpdateIrqPending(Memory &mem) noexcept {
+  mem.Irq_Pending = mem.Io.IME && (mem.Io.IE & mem.Io.IF);
+}
+
+/// Setting IF clears it.
+inline void WriteIF(Memory &mem, U32 address, U16 value, U16 mask) noexcept {
+  U16 current = ReadHalfWordFromGBAMemory(mem, address);
+  U16 cleared = current & ~(value & mask);
+  memcpy(GetPhysicalMemoryReadWrite(mem, address), &cleared, sizeof(cleared));
+  UpdateIrqPending(mem);
+}
+
+/// Hardware raising interrupts.
+inline void RequestInterrupt(Memory &mem, U16 irqs) noexcept {
+  mem.Io.IF |= irqs;
+  UpdateIrqPending(mem);
+}
+
+/// IE and IME decide whether IF raises an interrupt.
+inline void WriteIrqEnable(Memory &mem, U32 address, U16 value,
+                           U16 mask) noexcept {
+  WriteIoDefault(mem, address, value, mask);
+  UpdateIrqPending(mem);
+}
+
+/// Game Pak and SRAM timings follow WAITCNT.
+inline void WriteWAITCNT(Memory &mem, U32 address, U16 value,
+                         U16 mask) noexcept {
+  WriteIoDefault(mem, address, value, mask);
+  mem.Wait_States = BuildWaitStates(mem.Io.WAITCNT);
+}
+
+/// The VBlank, HBlank and VCOUNT match flags are read only.
+inline void WriteDISPSTAT(Memory &mem, U32 address, U16 value,
+                          U16 mask) noexcept {
+  constexpr U16 kFlags = 0b111;
+  U16 flags = mem.Io.DISPSTAT & kFlags;
+  WriteIoDefault(mem, address, value, mask);
+  mem.Io.DISPSTAT = (mem.Io.DISPSTAT & ~kFlags) | flags;
+}
+
+/// Sets the reload value, not the counter.
+inline void WriteTimerReload(Memory &mem, U32 address, U16 value,
+                             U16 mask) noexcept {
+  U16 &reload = mem.Timer_Reload[(address - TM0CNT_L) / 4];
+  reload = (reload & ~mask) | (value & mask);
+}
+
+/// Starting and stopping timers is done by the scheduler, at the next event
+/// check.
+inline void WriteTimerControl(Memory &mem, U32 address, U16 value,
+                              U16 mask) noexcept {
+  WriteIoDefault(mem, address, value, mask);
+  mem.Events.Schedule(Events::EventType::TIMER_CONTROL, 0);
+}
+
+/// Queues the enabled DMA channels that start at `timing`.
+inline void TriggerDma(Memory &mem, DmaTiming timing) noexcept {
+  for (U32 n = 0; n < 4; ++n) {
+    DMA_CNT_H cnt_h = mem.Io.DMA[n].CNT_H;
+    if (cnt_h.fields.en && cnt_h.fields.tm == U16(timing)) {
+      mem.Dma_Pending |= 1 << n;
+    }
+  }
+}
+
+/// Setting the enable bit latches the channel's addresses and count and
+/// starts an immediate channel, clearing the bit cancels a transfer that has
+/// not run yet.
+inline void WriteDmaControl(Memory &mem, U32 address, U16 value,
+                            U16 mask) noexcept {
+  U32 n = (address - DMA0CNT_H) / 12;
+  DMA_CNT_H before = mem.Io.DMA[n].CNT_H;
+  WriteIoDefault(mem, address, value, mask);
+  DMA_CNT_H after = mem.Io.DMA[n].CNT_H;
+  if (!after.fields.en) {
+    mem.Dma_Pending &= ~(1 << n);
+    return;
+  }
+  if (!before.fields.en) {
+    const DmaChannel &channel = mem.Io.DMA[n];
+    mem.Dma_Internal[n] = DmaInternal{channel.SAD, channel.DAD, channel.CNT_L};
+    if (after.fields.tm == U16(DmaTiming::IMMEDIATE)) {
+      mem.Dma_Pending |= 1 << n;
+    }
+  }
+}
+
+constexpr std::array<IoWriteHandler, kNumIoHalfWords> BuildIoWriteHandlers() {
+  std::array<IoWriteHandler, kNumIoHalfWords> handlers{};
+  handlers[(DISPSTAT - kIoBase) / 2] = WriteDISPSTAT;
+  for (U32 n = 0; n < 4; ++n) {
+    handlers[(DMA0CNT_H + 12 * n - kIoBase) / 2] = WriteDmaControl;
+  }
+  for (U32 n = 0; n < 4; ++n) {
+    handlers[(TM0CNT_L + 4 * n - kIoBase) / 2] = WriteTimerReload;
+    handlers[(TM0CNT_L + 4 * n + 2 - kIoBase) / 2] = WriteTimerControl;
+  }
+  handlers[(IE - kIoBase) / 2] = WriteIrqEnable;
+  handlers[(IF - kIoBase) / 2] = WriteIF;
+  handlers[(IME - kIoBase) / 2] = WriteIrqEnable;
+  handlers[(WAITCNT - kIoBase) / 2] = WriteWAITCNT;
+  return handlers;
+}
+
+/// Side effects of I/O stores, one entry per halfword register. Registers
+/// without a handler are plain memory.
+inline constexpr std::array<IoWriteHandler, kNumIoHalfWords> IoWriteHandlers =
+    BuildIoWriteHandlers();
+
+inline void WriteIoHalfWord(Memory &mem, U32 address, U16 value,
+                            U16 mask) noexcept {
+  U32 index = (address - kIoBase) / 2;
+  if (index < kNumIoHalfWords && IoWriteHandlers[index] != nullptr) {
+    IoWriteHandlers[index](mem, address, value, mask);
+  } else {
+    WriteIoDefault(mem, address, value, mask);
+  }
+}
+
+inline void WriteIoByte(Memory &mem, U32 address, U8 value) noexcept {
+  U32 shift = 8 * (address & 1);
+  WriteIoHalfWord(mem, address & ~1, U16(value << shift), U16(0xFF << shift));
+}
+
+inline bool IsIoAddress(U32 address) noexcept {
+  return (address >> kPageShift) == (kIoBase >> kPageShift);
+}
+
+/// PaletteRAM, VRAM or OAM.
+inline bool IsDisplayAddress(U32 address) noexcept {
+  return (address >> kPageShift) - 0x05 < 3;
+}
+
+/// Marks the blocks of the display memory store [address, address + size).
+/// Runs after the store, so the address is known to be valid.
+inline void MarkDisplayDirty(Memory &mem, U32 address, U32 size) noexcept {
+  U32 first = address & 0xFFFFFF;
+  U32 last = first + size - 1;
+  DisplayDirty &dirty = mem.Display_Dirty;
+  switch (address >> kPageShift) {
+  case 0x05:
+    dirty.PaletteRAM.MarkRange(first / DisplayDirty::kPaletteEntrySize,
+                               last / DisplayDirty::kPaletteEntrySize);
+    break;
+  case 0x06:
+    dirty.VRAM.MarkRange(first / DisplayDirty::kVramBlockSize,
+                         last / DisplayDirty::kVramBlockSize);
+    break;
+  default:
+    dirty.OAM.MarkRange(first / DisplayDirty::kOamEntrySize,
+                        last / DisplayDirty::kOamEntrySize);
+    break;
+  }
+}
+
 inline void WriteByteToGBAMemory(Memory &mem, U32 address, U8 value) noexcept {
-  // Setting IF clears it.
-  if (address == IF) {
-    U8 current = ReadByteFromGBAMemory(mem, IF);
-    value = current & ~value;
+  if (IsIoAddress(address)) [[unlikely]] {
+    WriteIoByte(mem, address, value);
+    return;
   }
   memcpy(GetPhysicalMemoryReadWrite(mem, address), &value, sizeof(value));
+  if (IsDisplayAddress(address)) [[unlikely]] {
+    MarkDisplayDirty(mem, address, sizeof(value));
+  }
 }
 
 inline void WriteWordToGBAMemory(Memory &mem, U32 address, U32 value) noexcept {
-  // Setting IF clears it.
-  if (address == IF) {
-    U32 current = ReadWordFromGBAMemory(mem, IF);
-    value = current & ~value;
+  if (IsIoAddress(address)) [[unlikely]] {
+    if (address & 1) {
+      for (U32 i = 0; i < 4; ++i) {
+        WriteIoByte(mem, address + i, U8(value >> (8 * i)));
+      }
+    } else {
+      WriteIoHalfWord(mem, address, U16(value), 0xFFFF);
+      WriteIoHalfWord(mem, address + 2, U16(value >> 16), 0xFFFF);
+    }
+    return;
   }
   memcpy(GetPhysicalMemoryReadWrite(mem, address), &value, sizeof(value));
+  if (IsDisplayAddress(address)) [[unlikely]] {
+    MarkDisplayDirty(mem, address, sizeof(value));
+  }
 }
 
 inline void WriteHalfWordToGBAMemory(Memory &mem, U32 address,
                                      U16 value) noexcept {
-  // Setting IF clears it.
-  if (address == IF) {
-    U16 current = ReadHalfWordFromGBAMemory(mem, IF);
-    value = current & ~value;
+  if (IsIoAddress(address)) [[unlikely]] {
+    if (address & 1) {
+      WriteIoByte(mem, address, U8(value));
+      WriteIoByte(mem, address + 1, U8(value >> 8));
+    } else {
+      WriteIoHalfWord(mem, address, value, 0xFFFF);
+    }
+    return;
   }
   memcpy(GetPhysicalMemoryReadWrite(mem, address), &value, sizeof(value));
+  if (IsDisplayAddress(address)) [[unlikely]] {
+    MarkDisplayDirty(mem, address, sizeof(value));
+  }
 }
 
+/// Stores without the I/O side effects, for hardware raising IF.
 inline void WriteHalfWordToGBAMemoryMock(Memory &mem, U32 address,
                                          U16 value) noexcept {
   memcpy(GetPhysicalMemoryReadWrite(mem, address), &value, sizeof(value));
+  UpdateIrqPending(mem);
+}
+
+/// `pressed` has a bit set for each key held down, in KEYINPUT order.
+inline void SetPressedKeys(Memory &mem, U16 pressed) noexcept {
+  mem.Io.KEYINPUT = ~pressed & kAllKeys;
 }
 
 inline void Reset(Memory &mem) {
+  // Nothing has been drawn yet.
+  mem.Display_Dirty.MarkAll();
   // POSTFLG is set to 0 on reset and 1 after bootup.
   WriteWordToGBAMemory(mem, 0x4000300, 0x00);
+  UpdateIrqPending(mem);
 }
 
 } // namespace Emulator::Memory
@@ -0,0 +1,62 @@
+#include "memory_allocator.h"
+
+#include <new>
+#include <sys/mman.h>
+
+#include "game_pak.h"
+#include "logging.h"
+
+namespace Emulator::Memory {
+
+namespace {
+
+U64 RoundUp(U64 size, U64 alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+void *MapHugePageAligned(U64 size, int prot) {
+  size = RoundUp(size, kHugePageSize);
+  // Over-allocate and trim, mmap only aligns to the base page size.
+  U64 padded = size + kHugePageSize;
+  void *mapping =
+      mmap(nullptr, padded, prot, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mapping == MAP_FAILED) {
+    return nullptr;
+  }
+  U8 *start = static_cast<U8 *>(mapping);
+  U8 *aligned = reinterpret_cast<U8 *>(
+      RoundUp(reinterpret_cast<U64>(start), kHugePageSize));
+  if (aligned != start) {
+    munmap(start, aligned - start);
+  }
+  munmap(aligned + size, start + padded - (aligned + size));
+#ifdef MADV_HUGEPAGE
+  // Best effort, fails harmlessly where THP is off.
+  madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+  return aligned;
+}
+
+void UnmapHugePageAligned(void *ptr, U64 size) {
+  munmap(ptr, RoundUp(size, kHugePageSize));
+}
+
+Memory *AllocateMemory() {
+  void *mapping = MapHugePageAligned(sizeof(Memory), PROT_READ | PROT_WRITE);
+  if (mapping == nullptr) {
+    ABORT("Could not allocate guest memory");
+  }
+  // Value initialising writes every byte, which also faults in all of it up
+  // front.
+  return new (mapping) Memory();
+}
+
+void FreeMemory(Memory *mem) {
+  UnloadGamePak(*mem);
+  mem->~Memory();
+  UnmapHugePageAligned(mem, sizeof(Memory));
+}
+
+} // namespace Emulator::Memory
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "datatypes.h"
+#include "memory.h"
+
+namespace Emulator::Memory {
+
+/// Transparent huge page size on x86-64 and arm64.
+constexpr U64 kHugePageSize = 2 * 1024 * 1024;
+
+/// Maps `size` bytes of zeroed anonymous memory aligned to kHugePageSize and
+/// asks for huge pages for it. Returns nullptr if the mapping fails.
+void *MapHugePageAligned(U64 size, int prot);
+
+/// Unmaps memory from MapHugePageAligned.
+void UnmapHugePageAligned(void *ptr, U64 size);
+
+/// Allocates the guest address space on huge pages and touches it, so the
+/// first accesses do not fault. Aborts if it cannot be allocated.
+[[nodiscard]] Memory *AllocateMemory();
+
+/// Frees memory from AllocateMemory, including the mapped Game Pak.
+void FreeMemory(Memory *mem);
+
+} // namespace Emulator::Memory
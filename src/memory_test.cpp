@@ -0,0 +1,175 @@
+#include <cassert>
+#include <stdio.h>
+
+#include "game_pak.h"
+#include "memory.h"
+#include "memory_allocator.h"
+
+using namespace Emulator;
+
+int main() {
+  Memory::Memory *memory = Memory::AllocateMemory();
+  // Guest memory starts on a huge page and comes back zeroed.
+  assert(reinterpret_cast<U64>(memory) % Memory::kHugePageSize == 0);
+  assert(reinterpret_cast<U64>(memory->IO_Registers) % 64 == 0);
+  assert(memory->WRAM_OnChip[0x7FFF] == 0);
+  const U8 *base = reinterpret_cast<const U8 *>(memory);
+
+  // Plain regions map straight into their arrays.
+  assert(Memory::GetPhysicalMemoryReadOnly(*memory, 0x00003FFF) ==
+         &memory->BIOS[0x3FFF]);
+  assert(Memory::GetPhysicalMemoryReadOnly(*memory, 0x0203FFFF) ==
+         &memory->WRAM_OnBoard[0x3FFFF]);
+  assert(Memory::GetPhysicalMemoryReadOnly(*memory, 0x06017FFF) ==
+         &memory->VRAM[0x17FFF]);
+  assert(Memory::GetPhysicalMemoryReadOnly(*memory, 0x0E00FFFF) ==
+         &memory->GamePak_SRAM[0xFFFF]);
+
+  // Without a ROM the Game Pak is open bus.
+  assert(Memory::ReadHalfWordFromGBAMemory(*memory, 0x08000000) == 0x0000);
+  assert(Memory::ReadWordFromGBAMemory(*memory, 0x0A001234) == 0x091B091A);
+
+  // On-chip WRAM mirrors every 32 KB and OAM reads every 1 KB.
+  assert(Memory::GetPhysicalMemoryReadWrite(*memory, 0x03FF8010) ==
+         &memory->WRAM_OnChip[0x10]);
+  assert(Memory::GetPhysicalMemoryReadOnly(*memory, 0x07000404) ==
+         &memory->OAM[0x4]);
+  assert(Memory::GetPhysicalMemoryReadWrite(*memory, 0x070003FC) ==
+         &memory->OAM[0x3FC]);
+
+  // Ranges resolve only when they are one contiguous run of memory.
+  assert(Memory::GetPhysicalRangeReadOnly(*memory, 0x02000000, 0x40000) ==
+         &memory->WRAM_OnBoard[0]);
+  assert(Memory::GetPhysicalRangeReadWrite(*memory, 0x03FF8010, 0x10) ==
+         &memory->WRAM_OnChip[0x10]);
+  assert(Memory::GetPhysicalRangeReadWrite(*memory, 0x03007FF0, 0x20) ==
+         nullptr);
+  assert(Memory::GetPhysicalRangeReadOnly(*memory, 0x06017FF0, 0x20) ==
+         nullptr);
+  assert(Memory::GetPhysicalRangeReadOnly(*memory, 0x08000000, 4) == nullptr);
+  assert(Memory::GetPhysicalRangeReadWrite(*memory, Memory::IE, 2) ==
+         nullptr);
+
+  // I/O goes through the slow path.
+  assert(Memory::GetPhysicalMemoryReadOnly(*memory, Memory::IE) ==
+         &memory->IO_Registers[0x200]);
+  assert(Memory::GetPhysicalMemoryReadWrite(*memory, 0x04000410) ==
+         &memory->Mystery_Addresses[0]);
+
+  // Writing IF acknowledges interrupts, whatever the store size. IE next to
+  // it is plain memory.
+  Memory::WriteHalfWordToGBAMemoryMock(*memory, Memory::IF, 0x3003);
+  Memory::WriteByteToGBAMemory(*memory, Memory::IF, 0x01);
+  assert(Memory::ReadHalfWordFromGBAMemory(*memory, Memory::IF) == 0x3002);
+  Memory::WriteByteToGBAMemory(*memory, Memory::IF + 1, 0x10);
+  assert(Memory::ReadHalfWordFromGBAMemory(*memory, Memory::IF) == 0x2002);
+  Memory::WriteWordToGBAMemory(*memory, Memory::IE, 0x20020005);
+  assert(Memory::ReadHalfWordFromGBAMemory(*memory, Memory::IF) == 0x0000);
+  assert(Memory::ReadHalfWordFromGBAMemory(*memory, Memory::IE) == 0x0005);
+
+  // An IRQ is pending while IME is set and an enabled interrupt is in IF.
+  assert(!memory->Irq_Pending);
+  Memory::WriteHalfWordToGBAMemoryMock(*memory, Memory::IF, 0x0004);
+  assert(!memory->Irq_Pending);
+  Memory::WriteByteToGBAMemory(*memory, Memory::IME, 1);
+  assert(memory->Irq_Pending);
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::IF, 0x0004);
+  assert(!memory->Irq_Pending);
+  Memory::WriteHalfWordToGBAMemoryMock(*memory, Memory::IF, 0x0001);
+  assert(memory->Irq_Pending);
+  Memory::WriteWordToGBAMemory(*memory, Memory::IME, 0);
+  assert(!memory->Irq_Pending);
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::IF, 0x0001);
+
+  Memory::WriteHalfWordToGBAMemory(*memory, 0x04000006, 0xABCD);
+  assert(Memory::ReadHalfWordFromGBAMemory(*memory, 0x04000006) == 0xABCD);
+
+  // Named I/O registers overlay the same bytes as the bus.
+  assert(memory->Io.VCOUNT == 0xABCD);
+  assert(memory->Io.IE == 0x0005);
+  Memory::WriteWordToGBAMemory(*memory, 0x040000D4, 0x02000000);
+  Memory::WriteByteToGBAMemory(*memory, 0x040000DF, 0x84);
+  assert(memory->Io.DMA[3].SAD == 0x02000000);
+  assert(memory->Io.DMA[3].CNT_H == 0x8400);
+  memory->Io.TM[1].CNT_H = 0x00C0;
+  assert(Memory::ReadByteFromGBAMemory(*memory, 0x04000106) == 0xC0);
+
+  // Display memory stores mark what a renderer has to redraw.
+  Memory::DisplayDirty &dirty = memory->Display_Dirty;
+  assert(!dirty.VRAM.Any() && !dirty.OAM.Any() && !dirty.PaletteRAM.Any());
+  Memory::WriteHalfWordToGBAMemory(*memory, 0x06000BFE, 0x1234);
+  Memory::WriteWordToGBAMemory(*memory, 0x050001FE, 0x7FFF7FFF);
+  Memory::WriteByteToGBAMemory(*memory, 0x070003FF, 0x01);
+  Memory::WriteWordToGBAMemory(*memory, 0x03000000, 0x1);
+  assert(dirty.VRAM.Test(2) && !dirty.VRAM.Test(1) && !dirty.VRAM.Test(3));
+  assert(dirty.PaletteRAM.Test(0xFF) && dirty.PaletteRAM.Test(0x100));
+  assert(!dirty.PaletteRAM.Test(0x101));
+  assert(dirty.OAM.Test(127) && !dirty.OAM.Test(0));
+  dirty.Clear();
+  assert(!dirty.VRAM.Any() && !dirty.OAM.Any() && !dirty.PaletteRAM.Any());
+  Memory::WriteWordToGBAMemory(*memory, 0x06017FFE, 0x1);
+  assert(dirty.VRAM.Test(95));
+  Memory::MarkDisplayDirty(*memory, 0x06000400, 0x1000);
+  assert(!dirty.VRAM.Test(0) && dirty.VRAM.Test(1) && dirty.VRAM.Test(4));
+  assert(!dirty.VRAM.Test(5));
+  Memory::Reset(*memory);
+  assert(dirty.VRAM.Test(0) && dirty.OAM.Test(64) && dirty.PaletteRAM.Test(511));
+  assert(dirty.VRAM.words[1] == (U64(1) << 32) - 1);
+  dirty.Clear();
+
+  // Access timings follow WAITCNT. The reset value is 4/2 wait states for
+  // WS0, and a 32 bit ROM access is a non-sequential and a sequential half.
+  const Memory::WaitStates &wait = memory->Wait_States;
+  assert(wait.Cycles(0x03000000, 4, false) == 1);
+  assert(wait.Cycles(0x02000000, 4, true) == 6);
+  assert(wait.Cycles(0x08000000, 2, false) == 5);
+  assert(wait.Cycles(0x08000000, 2, true) == 3);
+  assert(wait.Cycles(0x09000000, 4, false) == 8);
+  assert(wait.Cycles(0x0C000000, 2, true) == 9);
+  // WS0 3/1, WS2 sequential 1, SRAM 8.
+  Memory::WriteHalfWordToGBAMemory(*memory, Memory::WAITCNT, 0x0417);
+  assert(memory->Io.WAITCNT == 0x0417);
+  assert(wait.Cycles(0x08000000, 2, false) == 4);
+  assert(wait.Cycles(0x08000000, 4, true) == 4);
+  assert(wait.Cycles(0x0C000000, 2, true) == 2);
+  assert(wait.Cycles(0x0E000000, 1, false) == 9);
+
+  Memory::WriteWordToGBAMemory(*memory, 0x03007FFC, 0x12345678);
+  assert(Memory::ReadWordFromGBAMemory(*memory, 0x03FFFFFC) == 0x12345678);
+  assert(Memory::GetPhysicalMemoryReadOnly(*memory, 0x03007FFC) -
+             base ==
+         offsetof(Memory::Memory, WRAM_OnChip) + 0x7FFC);
+
+  // The wait state regions are views of one ROM, reads past its end are open
+  // bus and writes are ignored.
+  char path[] = "/tmp/memory_test_rom_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd != -1);
+  FILE *file = fdopen(fd, "wb");
+  for (U32 i = 0; i < 0x1000; ++i) {
+    fputc(U8(i * 7), file);
+  }
+  fclose(file);
+  assert(Memory::LoadGamePak(*memory, path));
+  remove(path);
+  assert(memory->GamePak_Size == 0x1000);
+  assert(reinterpret_cast<U64>(memory->GamePak) % Memory::kHugePageSize == 0);
+  assert(Memory::GetPhysicalMemoryReadOnly(*memory, 0x08000010) ==
+         &memory->GamePak[0x10]);
+  assert(Memory::GetPhysicalMemoryReadOnly(*memory, 0x0A000010) ==
+         &memory->GamePak[0x10]);
+  assert(Memory::GetPhysicalMemoryReadOnly(*memory, 0x0C000FFF) ==
+         &memory->GamePak[0xFFF]);
+  assert(Memory::ReadByteFromGBAMemory(*memory, 0x08000003) == 21);
+  assert(Memory::ReadHalfWordFromGBAMemory(*memory, 0x08001000) == 0x0800);
+  assert(Memory::ReadHalfWordFromGBAMemory(*memory, 0x09000000) == 0x0000);
+  Memory::WriteWordToGBAMemory(*memory, 0x08000000, 0xFFFFFFFF);
+  assert(Memory::ReadByteFromGBAMemory(*memory, 0x08000000) == 0);
+  U32 last = Memory::ReadWordFromGBAMemory(*memory, 0x08000FFE);
+  assert((last & 0xFFFF) == U16(U8(0xFFE * 7) | (U8(0xFFF * 7) << 8)));
+  Memory::UnloadGamePak(*memory);
+  assert(memory->GamePak == nullptr);
+
+  Memory::FreeMemory(memory);
+  return 0;
+}
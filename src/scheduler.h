@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+
+#include "datatypes.h"
+
+namespace Emulator::Events {
+
+/// Timestamp of an event that is not scheduled.
+constexpr U64 kNever = U64(-1);
+
+/// Hardware events, in the order they fire when due at the same cycle.
+enum class EventType : U8 {
+  /// Start of a scanline, VCOUNT moves on.
+  HDRAW,
+  /// End of the visible part of a scanline.
+  HBLANK,
+  /// TMxCNT_H was written, start or stop timers.
+  TIMER_CONTROL,
+  TIMER0_OVERFLOW,
+  TIMER1_OVERFLOW,
+  TIMER2_OVERFLOW,
+  TIMER3_OVERFLOW,
+  NUM_EVENT_TYPES,
+};
+
+constexpr U32 kNumEventTypes = U32(EventType::NUM_EVENT_TYPES);
+
+/// Hardware events keyed on the emulated cycle they are due at. Each type is
+/// pending at most once, scheduling it again moves it.
+///
+/// There are only a handful of types, so this is a table of deadlines with
+/// the earliest one cached rather than a heap. The runner compares its cycle
+/// count against next_timestamp() after every dispatch and the table is only
+/// scanned when an event fires or moves.
+class Scheduler {
+public:
+  void Schedule(EventType type, U64 timestamp) noexcept {
+    deadlines_[U32(type)] = timestamp;
+    if (timestamp < next_timestamp_) {
+      next_timestamp_ = timestamp;
+    } else {
+      UpdateNext();
+    }
+  }
+
+  void Cancel(EventType type) noexcept {
+    deadlines_[U32(type)] = kNever;
+    UpdateNext();
+  }
+
+  /// Cycle the earliest event is due at, kNever if there is none.
+  U64 next_timestamp() const noexcept { return next_timestamp_; }
+
+  U64 deadline(EventType type) const noexcept {
+    return deadlines_[U32(type)];
+  }
+
+  /// Removes the earliest event due at or before `now`. Returns false if
+  /// there is none.
+  bool PopDue(U64 now, EventType &type, U64 &timestamp) noexcept {
+    if (next_timestamp_ > now) {
+      return false;
+    }
+    for (U32 i = 0; i < kNumEventTypes; ++i) {
+      if (deadlines_[i] == next_timestamp_) {
+        type = EventType(i);
+        timestamp = deadlines_[i];
+        deadlines_[i] = kNever;
+        UpdateNext();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void Clear() noexcept {
+    deadlines_.fill(kNever);
+    next_timestamp_ = kNever;
+  }
+
+private:
+  void UpdateNext() noexcept {
+    next_timestamp_ = kNever;
+    for (U64 deadline : deadlines_) {
+      next_timestamp_ = deadline < next_timestamp_ ? deadline : next_timestamp_;
+    }
+  }
+
+  std::array<U64, kNumEventTypes> deadlines_ = [] {
+    std::array<U64, kNumEventTypes> deadlines{};
+    deadlines.fill(kNever);
+    return deadlines;
+  }();
+  U64 next_timestamp_ = kNever;
+};
+
+} // namespace Emulator::Events
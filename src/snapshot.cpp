@@ -79,4 +79,19 @@ void debug_snapshot(const AllRegisters &registers,
   write_pipeline(pipeline, snapshot_path);
 }
 
-} // namespace Emulator::Arm::Debug
\ No newline at end of file
+U64 display_hash(const Emulator::Memory::Memory &mem) {
+  // FNV-1a
+  U64 hash = 0xcbf29ce484222325;
+  auto add = [&hash](const U8 *bytes, U32 size) {
+    for (U32 i = 0; i < size; ++i) {
+      hash = (hash ^ bytes[i]) * 0x100000001b3;
+    }
+  };
+  add(mem.IO_Registers, offsetof(Emulator::Memory::IoRegisters, Sound));
+  add(mem.PaletteRAM, sizeof(mem.PaletteRAM));
+  add(mem.VRAM, sizeof(mem.VRAM));
+  add(mem.OAM, sizeof(mem.OAM));
+  return hash;
+}
+
+} // namespace Emulator::Arm::Debug
@@ -24,4 +24,9 @@ void debug_snapshot(const AllRegisters &registers,
                     const Emulator::Memory::Memory &mem,
                     const Pipeline &pipeline, const char *path);
 
+/// Hash of everything the picture depends on: the display registers,
+/// PaletteRAM, VRAM and OAM. The renderer is in the frontend, so headless
+/// runs compare this instead of a framebuffer.
+U64 display_hash(const Emulator::Memory::Memory &mem);
+
 } // namespace Emulator::Arm::Debug
\ No newline at end of file
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "arm7tdmi.h"
+#include "hardware_events.h"
+#include "logger.h"
+#include "memory.h"
+
+using namespace Emulator;
+
+namespace {
+
+// An arm loop that hands over to thumb every 8 iterations and back, with
+// loads, stores, BL, PUSH and POP, interrupted by a timer 0 IRQ.
+constexpr U32 kArmProgram[] = {
+    0xEA00000A, // 00: b start
+    0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+    0xE3A0C301, // 18: mov r12, #0x04000000
+    0xE28CCC02, //     add r12, r12, #0x200
+    0xE3A0B008, //     mov r11, #8
+    0xE1CCB0B2, //     strh r11, [r12, #2]
+    0xE28AA001, //     add r10, r10, #1
+    0xE25EF004, //     subs pc, lr, #4
+    0xE3A00301, // 30: start: mov r0, #0x04000000
+    0xE2802C01, //     add r2, r0, #0x100
+    0xE3A01A0F, //     mov r1, #0xF000
+    0xE1C210B0, //     strh r1, [r2]
+    0xE3A010C0, //     mov r1, #0xC0
+    0xE1C210B2, //     strh r1, [r2, #2]
+    0xE2802C02, //     add r2, r0, #0x200
+    0xE3A01008, //     mov r1, #8
+    0xE1C210B0, //     strh r1, [r2]
+    0xE3A01001, //     mov r1, #1
+    0xE1C210B8, //     strh r1, [r2, #8]
+    0xE321F01F, //     msr cpsr_c, #0x1F
+    0xE3A03403, //     mov r3, #0x03000000
+    0xE283DC01, //     add sp, r3, #0x100
+    0xE5936000, // 68: arm_loop: ldr r6, [r3]
+    0xE0866084, //     add r6, r6, r4, lsl #1
+    0xE5836000, //     str r6, [r3]
+    0xE7C36004, //     strb r6, [r3, r4]
+    0xE2944001, //     adds r4, r4, #1
+    0xE3140007, //     tst r4, #7
+    0x1AFFFFF8, //     bne arm_loop
+    0xE28F0001, //     add r0, pc, #1 (thumb_code + 1)
+    0xE12FFF10, //     bx r0
+};
+
+constexpr U16 kThumbProgram[] = {
+    0x689D, // 8c: thumb_code: ldr r5, [r3, #8]
+    0x3501, //     add r5, #1
+    0x609D, //     str r5, [r3, #8]
+    0xF000, //     bl t_sub
+    0xF804, //
+    0xB4A0, //     push {r5, r7}
+    0xBCA0, //     pop {r5, r7}
+    0x4802, //     ldr r0, =arm_loop
+    0x4700, //     bx r0
+    0x00AF, // 9e: t_sub: lsl r7, r5, #2
+    0x4077, //     eor r7, r6
+    0x4770, //     bx lr
+    0x0068, // a4: .word arm_loop
+    0x0000,
+};
+
+struct Run {
+  Arm::CPU *cpu;
+  Memory::Memory *memory;
+};
+
+/// Runs the program like CpuRunner::RunUntil, one StepPcOffset at a time
+/// or through the threaded core.
+Run RunProgram(bool threaded, U64 end) {
+  Memory::Memory *memory = new Memory::Memory();
+  memcpy(memory->BIOS, kArmProgram, sizeof(kArmProgram));
+  memcpy(memory->BIOS + sizeof(kArmProgram), kThumbProgram,
+         sizeof(kThumbProgram));
+  Arm::CPU *cpu = new Arm::CPU();
+  cpu->reset();
+  Memory::Reset(*memory);
+  Events::Reset(*memory, 0);
+  cpu->execution_model = Arm::ExecutionModel::PC_OFFSET;
+
+  while (cpu->cycles < end) {
+    if (threaded) {
+      cpu->RunThreaded(*memory);
+    } else {
+      Arm::StepResult result = cpu->StepPcOffset(*memory, nullptr);
+      assert(result != Arm::StepResult::STOPPED);
+    }
+    if (cpu->idle) {
+      cpu->cycles = std::max(
+          cpu->cycles, std::min(memory->Events.next_timestamp(), end));
+    }
+    if (cpu->cycles >= memory->Events.next_timestamp()) {
+      Events::RunDueEvents(*memory, cpu->cycles);
+    }
+  }
+  cpu->PrepareSnapshot(*memory);
+  return Run{cpu, memory};
+}
+
+} // namespace
+
+int main() {
+  static_assert(sizeof(kArmProgram) == 0x8C);
+  DispatchLogger::Logs *expected_logs = new DispatchLogger::Logs();
+
+  // The threaded core stops at the same event boundaries as the step loop,
+  // with the same state and the same dispatch log.
+  for (U64 lines : {1, 7, 33, 161}) {
+    U64 end = lines * Events::kScanlineCycles;
+    DispatchLogger::Reset();
+    Run step = RunProgram(false, end);
+    memcpy(expected_logs, &DispatchLogger::Logger, sizeof(*expected_logs));
+    DispatchLogger::Reset();
+    Run threaded = RunProgram(true, end);
+
+    assert(memcmp(&step.cpu->all_registers, &threaded.cpu->all_registers,
+                  sizeof(step.cpu->all_registers)) == 0);
+    assert(step.cpu->cycles == threaded.cpu->cycles);
+    assert(step.cpu->dispatch_num == threaded.cpu->dispatch_num);
+    assert(memcmp(step.memory->WRAM_OnChip, threaded.memory->WRAM_OnChip,
+                  sizeof(threaded.memory->WRAM_OnChip)) == 0);
+    assert(memcmp(step.memory->IO_Registers, threaded.memory->IO_Registers,
+                  sizeof(threaded.memory->IO_Registers)) == 0);
+    assert(memcmp(expected_logs, &DispatchLogger::Logger,
+                  sizeof(*expected_logs)) == 0);
+    if (lines == 161) {
+      // Both states and the IRQ handler ran.
+      assert(threaded.cpu->all_registers.r[4] > 8);
+      assert(threaded.cpu->all_registers.r[5] != 0);
+      assert(threaded.cpu->all_registers.r[10] != 0);
+    }
+
+    delete step.cpu;
+    delete threaded.cpu;
+    delete step.memory;
+    delete threaded.memory;
+  }
+  delete expected_logs;
+  return 0;
+}
@@ -0,0 +1,23 @@
+#include <cassert>
+
+#include "thumb_instructions.h"
+
+using namespace Emulator::Thumb;
+
+int main() {
+  // Fixed encodings.
+  assert(GetThumbOpcode(0x2001) == MOV1);  // mov r0, #1
+  assert(GetThumbOpcode(0x4770) == BX);    // bx lr
+  assert(GetThumbOpcode(0xB500) == PUSH);  // push {lr}
+  assert(GetThumbOpcode(0xF000) == BL);    // bl prefix
+  assert(GetThumbOpcode(0x6808) == LDR1);  // ldr r0, [r1]
+  assert(GetThumbOpcode(0x4780) == UNDEFINED);
+  assert(GetThumbOpcode(0xE800) == UNDEFINED);
+
+  // Every halfword must agree with the linear scan.
+  for (U32 instr = 0; instr <= 0xFFFF; ++instr) {
+    assert(GetThumbOpcode(U16(instr)) == ScanThumbOpcode(U16(instr)));
+  }
+
+  return 0;
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+
 #include "datatypes.h"
 
 namespace Emulator::Thumb {
@@ -240,10 +242,11 @@ enum ThumbOpcode {
   SUB4,
   SWI,
   TST,
-  NUM_OPCODES, // Must be last enum
+  NUM_OPCODES, // Must be last opcode
+  UNDEFINED,
 };
 
-const char *ToString(const ThumbOpcode opcode) {
+inline const char *ToString(const ThumbOpcode opcode) {
   switch (opcode) {
   case ADC:
     return "ADC";
@@ -371,6 +374,8 @@ const char *ToString(const ThumbOpcode opcode) {
     return "TST";
   case NUM_OPCODES:
     return "NUM_OPCODES";
+  case UNDEFINED:
+    return "UNDEFINED";
   default:
     return "UNKNOWN";
   }
@@ -380,13 +385,50 @@ static_assert(sizeof(ThumbEncodingList) / sizeof(ThumbEncodingList[0]) ==
               NUM_OPCODES);
 static_assert(sizeof(ThumbMaskList) / sizeof(ThumbMaskList[0]) == NUM_OPCODES);
 
-inline ThumbOpcode GetThumbOpcode(U16 instr) {
+/// Linear scan over ThumbMaskList. Returns UNDEFINED if nothing matches.
+constexpr ThumbOpcode ScanThumbOpcode(U16 instr) {
   for (U32 i = 0; i < U32(NUM_OPCODES); ++i) {
     if ((instr & ThumbMaskList[i]) == ThumbEncodingList[i]) {
       return ThumbOpcode(i);
     }
   }
-  ABORT("Could not find thumbcode for 0x%04X", instr);
+  return UNDEFINED;
+}
+
+/// Every thumb mask lies within bits 15-6, so the top 10 bits decide the
+/// opcode and a 1024 entry table covers the whole 16 bit encoding space.
+constexpr U16 kThumbDecodeIndexMask = 0xFFC0;
+
+constexpr U32 kThumbDecodeTableSize = 1024;
+
+constexpr U32 ThumbDecodeIndex(U16 instr) { return instr >> 6; }
+
+constexpr bool ThumbMasksFitDecodeIndex() {
+  for (U32 i = 0; i < U32(NUM_OPCODES); ++i) {
+    if ((ThumbMaskList[i] & ~kThumbDecodeIndexMask) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static_assert(ThumbMasksFitDecodeIndex());
+
+constexpr std::array<ThumbOpcode, kThumbDecodeTableSize>
+BuildThumbDecodeTable() {
+  std::array<ThumbOpcode, kThumbDecodeTableSize> table{};
+  for (U32 index = 0; index < kThumbDecodeTableSize; ++index) {
+    table[index] = ScanThumbOpcode(U16(index << 6));
+  }
+  return table;
+}
+
+constexpr std::array<ThumbOpcode, kThumbDecodeTableSize> ThumbDecodeTable =
+    BuildThumbDecodeTable();
+
+/// Returns UNDEFINED for encodings that do not match any opcode.
+inline ThumbOpcode GetThumbOpcode(U16 instr) {
+  return ThumbDecodeTable[ThumbDecodeIndex(instr)];
 }
 
 } // namespace Emulator::Thumb
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+
+#include "datatypes.h"
+
+namespace Emulator::Memory {
+
+/// Game Pak Waitstate Control
+constexpr U32 WAITCNT = 0x04000204;
+
+/// Cycles one access takes, per 16 MB region, including the wait states. The
+/// Game Pak regions depend on WAITCNT, everything else is fixed.
+struct WaitStates {
+  /// [sequential][region]
+  std::array<std::array<U8, 16>, 2> cycles16{};
+  std::array<std::array<U8, 16>, 2> cycles32{};
+
+  /// Cycles of a `size` byte access to `address`. An access is sequential if
+  /// it is to the address right after the previous one on the bus.
+  U32 Cycles(U32 address, U32 size, bool sequential) const noexcept {
+    U32 region = (address >> 24) & 0xF;
+    return size == 4 ? cycles32[sequential][region]
+                     : cycles16[sequential][region];
+  }
+};
+
+constexpr WaitStates BuildWaitStates(U16 waitcnt) {
+  // Wait states for each WAITCNT setting.
+  constexpr U8 kNonSequential[4] = {4, 3, 2, 8};
+  constexpr U8 kSequentialWS0[2] = {2, 1};
+  constexpr U8 kSequentialWS1[2] = {4, 1};
+  constexpr U8 kSequentialWS2[2] = {8, 1};
+
+  WaitStates wait{};
+  auto set = [&wait](U32 region, U8 n16, U8 s16, U8 n32, U8 s32) {
+    wait.cycles16[0][region] = n16;
+    wait.cycles16[1][region] = s16;
+    wait.cycles32[0][region] = n32;
+    wait.cycles32[1][region] = s32;
+  };
+  for (U32 region = 0; region < 16; ++region) {
+    set(region, 1, 1, 1, 1);
+  }
+  // On-board WRAM, palette and VRAM have 16 bit buses, 32 bit accesses take
+  // two.
+  set(0x2, 3, 3, 6, 6);
+  set(0x5, 1, 1, 2, 2);
+  set(0x6, 1, 1, 2, 2);
+
+  // The Game Pak bus is 16 bit too. The second half of a 32 bit access is
+  // sequential.
+  auto game_pak = [&set](U32 region, U8 n_wait, U8 s_wait) {
+    U8 n = 1 + n_wait;
+    U8 s = 1 + s_wait;
+    set(region, n, s, n + s, 2 * s);
+    set(region + 1, n, s, n + s, 2 * s);
+  };
+  game_pak(0x8, kNonSequential[(waitcnt >> 2) & 3],
+           kSequentialWS0[(waitcnt >> 4) & 1]);
+  game_pak(0xA, kNonSequential[(waitcnt >> 5) & 3],
+           kSequentialWS1[(waitcnt >> 7) & 1]);
+  game_pak(0xC, kNonSequential[(waitcnt >> 8) & 3],
+           kSequentialWS2[(waitcnt >> 10) & 1]);
+
+  U8 sram = 1 + kNonSequential[waitcnt & 3];
+  set(0xE, sram, sram, sram, sram);
+  set(0xF, sram, sram, sram, sram);
+  return wait;
+}
+
+} // namespace Emulator::Memory